@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "../MySQL/NodeRegistry.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    /**
+     * Erzeugt Knoten-IDs in der Form, wie sie die Knoten melden (MAC-Adresse ohne Trennzeichen).
+     */
+    std::vector<std::string> makeNodeIds(size_t count)
+    {
+        std::vector<std::string> ids;
+        ids.reserve(count);
+
+        // Präfix, bis zu 16 Hex-Ziffern eines size_t und die abschließende Null
+        char buffer[24];
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::snprintf(buffer, sizeof(buffer), "A4CF12%06zX", i);
+            ids.emplace_back(buffer);
+        }
+        return ids;
+    }
+}
+
+/**
+ * Laden beim Start wie in fetchAllNodesFromDatabase: jeden Knoten mit load() übernehmen.
+ * Gemessen wird nur der Aufbau der Registry, die Abfragen an die Datenbank sind nicht enthalten.
+ * Die Hashtabellen wachsen dabei schrittweise und bleiben für den Großteil der Knoten im Cache.
+ */
+static void BM_NodeRegistryStartupLoad(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const std::vector<std::string> ids = makeNodeIds(count);
+
+    for (auto _ : state)
+    {
+        auto registry = std::make_unique<NodeRegistry>();
+
+        for (const std::string& id : ids)
+            benchmark::DoNotOptimize(registry->load(id, true, 1697500000));
+
+        // Das Freigeben gehört nicht zum Start
+        state.PauseTiming();
+        registry.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_NodeRegistryStartupLoad)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond)->Complexity();
+
+/**
+ * Suche eines Knotens über die ID wie in findNode, die IDs werden reihum abgefragt.
+ */
+static void BM_NodeRegistryFind(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const std::vector<std::string> ids = makeNodeIds(count);
+
+    NodeRegistry registry;
+    for (const std::string& id : ids)
+        registry.load(id, true, 1697500000);
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(registry.find(ids[i]));
+        if (++i == count)
+            i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NodeRegistryFind)->RangeMultiplier(10)->Range(10000, 1000000);
+
+/**
+ * Suche nach unbekannten IDs, z.B. Meldungen von Knoten, die noch nicht angemeldet sind.
+ */
+static void BM_NodeRegistryFindMiss(benchmark::State& state)
+{
+    const size_t count = static_cast<size_t>(state.range(0));
+    const std::vector<std::string> ids = makeNodeIds(count * 2);
+
+    NodeRegistry registry;
+    for (size_t i = 0; i < count; ++i)
+        registry.load(ids[i], true, 1697500000);
+
+    size_t i = count;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(registry.find(ids[i]));
+        if (++i == ids.size())
+            i = count;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NodeRegistryFindMiss)->RangeMultiplier(10)->Range(10000, 1000000);
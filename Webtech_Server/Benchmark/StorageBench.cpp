@@ -0,0 +1,282 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "../Storage/NodeStorage.hpp"
+#include "../Storage/MemoryBackend.hpp"
+#include "../Storage/DateTimeFormat.hpp"
+#include "../Logging/Logger.hpp"
+
+#include <deque>
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    const NodeData Reading{ 21.5f, 101325, 412.25f, 45, 300, 42, 1697500000 };
+
+    /**
+     * sStorage mit einem MemoryBackend, läuft ohne MySQL und ohne Broker.
+     *
+     * Da NodeStorage ein Singleton ist, wird das Backend einmalig verbunden und von allen Benchmarks
+     * verwendet. nodes() legt fehlende Knoten über addNode() an, erlaubt und offline, und gibt die
+     * Handles der ersten count Knoten zurück. Nach jedem Benchmark setzt reset() alle Knoten offline
+     * und entfernt ihre Timer.
+     *
+     * Die Benchmarks stellen die Uhr der Offline-Timer über now() selbst weiter. Sie läuft über alle
+     * Benchmarks hinweg nur vorwärts, da das TimerWheel nicht zurückgestellt werden kann.
+     */
+    class StorageFixture
+    {
+    public:
+        using Clock = TimerWheel::Clock;
+
+        static StorageFixture& get()
+        {
+            static StorageFixture instance;
+            return instance;
+        }
+
+        /* Handles der ersten count Knoten, fehlende Knoten werden angelegt */
+        const std::vector<NodeHandle>& nodes(size_t count)
+        {
+            // Präfix, bis zu 16 Hex-Ziffern eines size_t und die abschließende Null
+            char buffer[24];
+            for (size_t i = m_handles.size(); i < count; ++i)
+            {
+                std::snprintf(buffer, sizeof(buffer), "A4CF12%06zX", i);
+                m_handles.push_back(sStorage.addNode(buffer));
+                sStorage.setNodeActive(buffer, true);
+            }
+
+            m_view.assign(m_handles.begin(), m_handles.begin() + static_cast<std::ptrdiff_t>(count));
+            return m_view;
+        }
+
+        /* Setzt alle Knoten offline und entfernt ihre Timer, ohne das Backend */
+        void reset()
+        {
+            sStorage.setAllNodesOffline(false);
+
+            // Entfernte Timer bleiben bis zu ihrer Frist im Rad liegen, daher über alle Fristen der
+            // Benchmarks hinaus weiterschalten, damit der nächste Benchmark mit leeren Fächern beginnt
+            now() += std::chrono::hours(25);
+            sStorage.monitorLastSeen(m_now);
+        }
+
+        /* Simulierte Uhr, beginnt nie vor der aktuellen Zeit */
+        Clock::time_point& now()
+        {
+            m_now = std::max(m_now, Clock::now());
+            return m_now;
+        }
+
+    private:
+        StorageFixture()
+        {
+            // Statusmeldungen der Knoten nicht ausgeben, gemessen werden nur die Speicherpfade
+            sLog.setLevel(LogLevel::Warning);
+
+            NodeDataWriterConfig writerConfig;
+            writerConfig.spoolDirectory.clear();
+
+            sStorage.setup(std::make_unique<MemoryBackend>());
+            sStorage.setWriterConfig(writerConfig);
+            sStorage.connect();
+        }
+
+        ~StorageFixture()
+        {
+            sStorage.disconnect();
+        }
+
+        std::vector<NodeHandle> m_handles;
+        std::vector<NodeHandle> m_view;
+        Clock::time_point m_now;
+    };
+}
+
+/**
+ * Formatierung des Zeitstempels über localtime_r + strftime, wie vor formatLocalDateTime() in writeNodeDataBatch.
+ */
+static void BM_TimestampFormatLocaltimeR(benchmark::State& state)
+{
+    time_t timeStamp = 1697500000;
+
+    for (auto _ : state)
+    {
+        std::tm tm_timeStamp;
+        localtime_r(&timeStamp, &tm_timeStamp);
+        char buffer[20];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_timeStamp);
+        benchmark::DoNotOptimize(buffer);
+        ++timeStamp;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampFormatLocaltimeR);
+
+/**
+ * Formatierung über std::localtime, wie vor formatLocalDateTime() in flushLastSeen.
+ */
+static void BM_TimestampFormatLocaltime(benchmark::State& state)
+{
+    time_t timeStamp = 1697500000;
+
+    for (auto _ : state)
+    {
+        std::tm* tm_lastSeen = std::localtime(&timeStamp);
+        char buffer[20];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", tm_lastSeen);
+        benchmark::DoNotOptimize(buffer);
+        ++timeStamp;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampFormatLocaltime);
+
+/**
+ * Formatierung über formatLocalDateTime(), wie in MySQLBackend. Innerhalb einer Stunde kommt sie
+ * ohne localtime_r() aus; je 3600 Aufrufe wird die Stunde einmal neu berechnet.
+ */
+static void BM_TimestampFormatCached(benchmark::State& state)
+{
+    time_t timeStamp = 1697500000;
+
+    for (auto _ : state)
+    {
+        char buffer[DateTimeBufferSize];
+        formatLocalDateTime(timeStamp, buffer);
+        benchmark::DoNotOptimize(buffer);
+        ++timeStamp;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampFormatCached)->ThreadRange(1, 8);
+
+/**
+ * setLastSeen für reihum gemeldete Knoten: Registry-Zugriff und Verlängern der Offline-Frist am Knoten.
+ */
+static void BM_StorageSetLastSeen(benchmark::State& state)
+{
+    StorageFixture& storage = StorageFixture::get();
+    const std::vector<NodeHandle>& handles = storage.nodes(static_cast<size_t>(state.range(0)));
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        sStorage.setLastSeen(handles[i]);
+        if (++i == handles.size())
+            i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    storage.reset();
+}
+BENCHMARK(BM_StorageSetLastSeen)->RangeMultiplier(10)->Range(10000, 1000000);
+
+/**
+ * updateNodeData bis zur Übergabe an den NodeDataWriter. Der Schreib-Thread übergibt die Messwerte
+ * an das MemoryBackend, gemessen wird der Durchsatz des aufrufenden Threads.
+ */
+static void BM_StorageUpdateNodeData(benchmark::State& state)
+{
+    StorageFixture& storage = StorageFixture::get();
+    const std::vector<NodeHandle>& handles = storage.nodes(static_cast<size_t>(state.range(0)));
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        sStorage.updateNodeData(handles[i], Reading);
+        if (++i == handles.size())
+            i = 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    storage.reset();
+}
+BENCHMARK(BM_StorageUpdateNodeData)->RangeMultiplier(10)->Range(10000, 1000000);
+
+/**
+ * monitorLastSeen im eingeschwungenen Zustand: Alle Knoten sind online, ihre Fristen sind
+ * gleichmäßig über das Offline-Timeout verteilt. Jede Iteration stellt die Uhr um eine Sekunde
+ * weiter, der Anteil 1/60 der Knoten läuft ab und geht offline. Außerhalb der Messung melden
+ * sich diese Knoten wieder, damit der Zustand gleich bleibt.
+ */
+static void BM_StorageMonitorLastSeen(benchmark::State& state)
+{
+    StorageFixture& storage = StorageFixture::get();
+    const std::vector<NodeHandle>& handles = storage.nodes(static_cast<size_t>(state.range(0)));
+    const auto timeout = DefaultNodeOfflineTimeout;
+    TimerWheel& timers = sStorage.getOfflineTimers();
+
+    // Fristen in aufsteigender Reihenfolge, neu aufgezogene Timer werden hinten angehängt
+    std::deque<std::pair<TimerWheel::Clock::time_point, NodeHandle>> deadlines;
+
+    // Der Timer wird vor setNodeOnline() aufgezogen, das dann keinen eigenen Timer mit der echten Uhr
+    // einsortiert. Dessen verworfener Eintrag würde sonst erst in der Messung aus dem Fach entfernt
+    auto& now = storage.now();
+    for (size_t i = 0; i < handles.size(); ++i)
+    {
+        deadlines.emplace_back(now + timeout * (i + 1) / handles.size(), handles[i]);
+        timers.schedule(handles[i], deadlines.back().first);
+        sStorage.setNodeOnline(handles[i], true, false);
+    }
+
+    int64_t wentOffline = 0;
+
+    for (auto _ : state)
+    {
+        now += std::chrono::seconds(1);
+        sStorage.monitorLastSeen(now);
+
+        // Die abgelaufenen Knoten melden sich wieder
+        state.PauseTiming();
+        while (!deadlines.empty() && deadlines.front().first <= now && !timers.isArmed(deadlines.front().second))
+        {
+            NodeHandle handle = deadlines.front().second;
+            deadlines.pop_front();
+            ++wentOffline;
+
+            deadlines.emplace_back(now + timeout, handle);
+            timers.schedule(handle, deadlines.back().first);
+            sStorage.setNodeOnline(handle, true, false);
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(wentOffline);
+    state.counters["OfflinePerCall"] = benchmark::Counter(static_cast<double>(wentOffline) / std::max<int64_t>(state.iterations(), 1));
+    state.SetComplexityN(state.range(0));
+    storage.reset();
+}
+BENCHMARK(BM_StorageMonitorLastSeen)->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMicrosecond)->Complexity();
+
+/**
+ * monitorLastSeen ohne ablaufende Timer, der Normalfall im Sekundentakt. Die Dauer darf nicht
+ * von der Anzahl der Knoten abhängen.
+ */
+static void BM_StorageMonitorLastSeenIdle(benchmark::State& state)
+{
+    StorageFixture& storage = StorageFixture::get();
+    const std::vector<NodeHandle>& handles = storage.nodes(static_cast<size_t>(state.range(0)));
+    TimerWheel& timers = sStorage.getOfflineTimers();
+
+    auto& now = storage.now();
+
+    // Den Timer direkt an der endgültigen Frist einsortieren, bevor setNodeOnline() ihn auf 60s aufzieht.
+    // Ein späteres schedule() würde nur die Frist verlängern, der Timer würde dann erst in der Messung
+    // verschoben. Das Fach der Frist wird erst nach den 20000 Iterationen fällig
+    for (NodeHandle handle : handles)
+    {
+        timers.schedule(handle, now + std::chrono::hours(24));
+        sStorage.setNodeOnline(handle, true, false);
+    }
+
+    for (auto _ : state)
+    {
+        now += std::chrono::seconds(1);
+        sStorage.monitorLastSeen(now);
+    }
+    state.SetComplexityN(state.range(0));
+    storage.reset();
+}
+// Feste Anzahl an Iterationen, damit die simulierte Uhr die Fristen nicht erreicht
+BENCHMARK(BM_StorageMonitorLastSeenIdle)->RangeMultiplier(10)->Range(10000, 1000000)->Iterations(20000)->Complexity();
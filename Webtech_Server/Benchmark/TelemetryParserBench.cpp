@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "../MQTT/TelemetryParser.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+    // Typischer Payload eines Knotens auf "Nodes/{ID}/Data"
+    const std::string TelemetryPayload = R"({"temp":21.5,"pres":101325,"alt":412.25,"hum":45,"lux":300,"soun":42,"time":1697500000})";
+
+    // Derselbe Messwert im binären Format auf "Nodes/{ID}/Bin"
+    const std::string TelemetryBinaryPayload = TelemetryParser::encodeBinary(NodeData{ 21.5f, 101325, 412.25f, 45, 300, 42, 1697500000 });
+
+    // Derselbe Messwert als MessagePack, zum Vergleich mit dem eigenen binären Format
+    const std::vector<uint8_t> TelemetryMsgPackPayload = json::to_msgpack(json::parse(TelemetryPayload));
+}
+
+/**
+ * Bisheriger Pfad aus ClientsListener: JSON-Objekt aufbauen und die Felder per operator[] lesen.
+ */
+static void BM_TelemetryParseDom(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        json data_json = nlohmann::json::parse(TelemetryPayload);
+
+        NodeData data;
+        data.temperature = data_json["temp"].get<float>();
+        data.pressure = data_json["pres"].get<uint32_t>();
+        data.altitude = data_json["alt"].get<float>();
+        data.humidity = data_json["hum"].get<uint32_t>();
+        data.lux = data_json["lux"].get<uint32_t>();
+        data.sound = data_json["soun"].get<uint16_t>();
+        data.timeStamp = data_json["time"].get<time_t>();
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetBytesProcessed(state.iterations() * TelemetryPayload.size());
+    state.counters["BytesPerMessage"] = static_cast<double>(TelemetryPayload.size());
+}
+BENCHMARK(BM_TelemetryParseDom);
+
+/**
+ * Rückfallpfad des TelemetryParser über nlohmann::json.
+ */
+static void BM_TelemetryParseJson(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        NodeData data;
+        TelemetryParser::parseJson(TelemetryPayload, data);
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetBytesProcessed(state.iterations() * TelemetryPayload.size());
+    state.counters["BytesPerMessage"] = static_cast<double>(TelemetryPayload.size());
+}
+BENCHMARK(BM_TelemetryParseJson);
+
+/**
+ * Schneller Pfad des TelemetryParser ohne JSON-Objekt.
+ */
+static void BM_TelemetryParseFast(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        NodeData data;
+        benchmark::DoNotOptimize(TelemetryParser::parseFast(TelemetryPayload, data));
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetBytesProcessed(state.iterations() * TelemetryPayload.size());
+    state.counters["BytesPerMessage"] = static_cast<double>(TelemetryPayload.size());
+}
+BENCHMARK(BM_TelemetryParseFast);
+
+/**
+ * MessagePack über nlohmann::json, baut wie parseJson ein JSON-Objekt auf.
+ */
+static void BM_TelemetryParseMsgPack(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        json data_json = json::from_msgpack(TelemetryMsgPackPayload);
+
+        NodeData data;
+        data.temperature = data_json.at("temp").get<float>();
+        data.pressure = data_json.at("pres").get<uint32_t>();
+        data.altitude = data_json.at("alt").get<float>();
+        data.humidity = data_json.at("hum").get<uint32_t>();
+        data.lux = data_json.at("lux").get<uint32_t>();
+        data.sound = data_json.at("soun").get<uint16_t>();
+        data.timeStamp = data_json.at("time").get<time_t>();
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetBytesProcessed(state.iterations() * TelemetryMsgPackPayload.size());
+    state.counters["BytesPerMessage"] = static_cast<double>(TelemetryMsgPackPayload.size());
+}
+BENCHMARK(BM_TelemetryParseMsgPack);
+
+/**
+ * Binäres Format mit festem Layout, direkt in die NodeData-Struktur.
+ */
+static void BM_TelemetryParseBinary(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        NodeData data;
+        benchmark::DoNotOptimize(TelemetryParser::parseBinary(TelemetryBinaryPayload, data));
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetBytesProcessed(state.iterations() * TelemetryBinaryPayload.size());
+    state.counters["BytesPerMessage"] = static_cast<double>(TelemetryBinaryPayload.size());
+}
+BENCHMARK(BM_TelemetryParseBinary);
+
+/**
+ * Node-ID und Art des Topics aus dem Topic lesen, wie in ClientsListener::message_arrived und routingKey.
+ */
+static void BM_TelemetryNodeIdFromTopic(benchmark::State& state)
+{
+    const std::string topic = "Nodes/A4CF12B3C4D5/Data";
+
+    for (auto _ : state)
+    {
+        TelemetryParser::TopicKind kind;
+        benchmark::DoNotOptimize(TelemetryParser::nodeIdFromTopic(topic, &kind));
+        benchmark::DoNotOptimize(kind);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryNodeIdFromTopic);
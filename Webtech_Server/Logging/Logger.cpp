@@ -0,0 +1,416 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "Logger.hpp"
+#include "../Metrics/Metrics.hpp"
+
+#include <array>
+#include <cstdio>
+
+namespace
+{
+    /**
+     * Abstand, in dem der Hintergrund-Thread die Puffer leert. Die schreibenden Threads wecken ihn
+     * nicht, damit write() ohne Systemaufruf auskommt.
+     */
+    constexpr std::chrono::milliseconds DrainInterval{ 50 };
+}
+
+/**
+ * Ringpuffer eines schreibenden Threads mit genau einem Erzeuger (der Thread) und einem
+ * Verbraucher (der Hintergrund-Thread des Loggers).
+ */
+class Logger::ThreadBuffer
+{
+public:
+    static constexpr size_t Capacity = 256;
+
+    /* Gibt den nächsten freien Eintrag zurück, nullptr wenn der Puffer voll ist (nur Erzeuger) */
+    LogEntry* claim()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= Capacity)
+            return nullptr;
+
+        return &m_entries[head % Capacity];
+    }
+
+    /* Gibt den mit claim() geholten Eintrag frei (nur Erzeuger) */
+    void commit() { m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /* Hängt alle freigegebenen Einträge an, gibt den Platz danach wieder frei (nur Verbraucher) */
+    void popAll(std::vector<LogEntry>& entries)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+
+        for (; tail != head; ++tail)
+        {
+            const LogEntry& source = m_entries[tail % Capacity];
+            LogEntry& target = entries.emplace_back();
+            target.time = source.time;
+            target.level = source.level;
+            target.length = source.length;
+            std::memcpy(target.text, source.text, source.length);
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+    }
+
+    bool empty() const { return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire); }
+
+private:
+    alignas(64) std::atomic<size_t> m_head{ 0 };
+    alignas(64) std::atomic<size_t> m_tail{ 0 };
+    std::array<LogEntry, Capacity> m_entries;
+};
+
+/**
+ * Gibt den Namen der Stufe zurück.
+ *
+ * @param level Die Stufe.
+ * @return const char* "debug", "info", "warning" oder "error".
+ */
+const char* logLevelName(LogLevel level)
+{
+    switch (level)
+    {
+        case LogLevel::Debug:   return "debug";
+        case LogLevel::Info:    return "info";
+        case LogLevel::Warning: return "warning";
+        case LogLevel::Error:   return "error";
+    }
+
+    return "unknown";
+}
+
+/**
+ * Liest eine Stufe aus ihrem Namen, z.B. aus WEBTECH_LOG_LEVEL.
+ *
+ * @param text "debug", "info", "warning" oder "error".
+ * @param level Erhält die Stufe.
+ * @return bool Gibt false zurück, wenn der Text keine Stufe ist.
+ */
+bool parseLogLevel(std::string_view text, LogLevel& level)
+{
+    for (LogLevel candidate : { LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Error })
+    {
+        if (text == logLevelName(candidate))
+        {
+            level = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Konstruktor eines Schlüssels, wird nur über Logger::key() angelegt.
+ *
+ * @param name Name des Schlüssels, erscheint als Label key der Metrik.
+ * @param level Stufe aller Meldungen des Schlüssels.
+ * @param burst Meldungen je Zeitfenster, 0 schaltet die Begrenzung ab.
+ * @param suppressed Zähler der unterdrückten Meldungen.
+ */
+LogKey::LogKey(std::string name, LogLevel level, uint32_t burst, Counter& suppressed) :
+    m_name(std::move(name)), m_level(level), m_burst(burst), m_suppressed(suppressed)
+{
+}
+
+/**
+ * Prüft, ob die Meldung im aktuellen Zeitfenster noch ausgegeben wird.
+ * Ist das Fenster bereits ausgeschöpft, wird nur noch gelesen und im Slot des Threads gezählt.
+ *
+ * @return bool Gibt true zurück, wenn die Meldung ausgegeben werden soll.
+ */
+bool LogKey::admit()
+{
+    if (m_burst == 0)
+        return true;
+
+    if (m_inWindow.load(std::memory_order_relaxed) < m_burst && m_inWindow.fetch_add(1, std::memory_order_relaxed) < m_burst)
+        return true;
+
+    m_suppressed.inc();
+    return false;
+}
+
+/**
+ * Beginnt ein neues Zeitfenster. Wird nur vom Hintergrund-Thread des Loggers aufgerufen.
+ *
+ * @return uint64_t Anzahl der seit dem letzten Aufruf unterdrückten Meldungen.
+ */
+uint64_t LogKey::rollWindow()
+{
+    m_inWindow.store(0, std::memory_order_relaxed);
+
+    const uint64_t total = m_suppressed.value();
+    const uint64_t count = total - m_reported;
+    m_reported = total;
+    return count;
+}
+
+/**
+ * Standard-Konstruktor, der Logger schreibt bis zum Aufruf von start() direkt.
+ */
+Logger::Logger() :
+    m_dropped(sMetrics.counter("webtech_log_dropped_total", "Log messages dropped because the thread buffer was full"))
+{
+}
+
+/**
+ * Destruktor, schreibt noch wartende Meldungen, falls stop() nicht aufgerufen wurde.
+ */
+Logger::~Logger()
+{
+    stop();
+}
+
+/**
+ * Startet den Hintergrund-Thread, ab hier schreiben die Threads in ihre Puffer.
+ */
+void Logger::start()
+{
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+
+    if (m_running)
+        return;
+
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&Logger::run, this);
+}
+
+/**
+ * Beendet den Hintergrund-Thread und schreibt alle wartenden Meldungen sowie die Anzahl der
+ * unterdrückten Meldungen. Danach wird wieder direkt geschrieben.
+ */
+void Logger::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_running.store(false, std::memory_order_release);
+    }
+
+    m_wake.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    drain();
+    rollWindows();
+}
+
+/**
+ * Stellt die Begrenzung für alle danach angelegten Schlüssel ein.
+ *
+ * @param window Länge des Zeitfensters.
+ * @param burst Meldungen je Schlüssel und Fenster, 0 schaltet die Begrenzung ab.
+ */
+void Logger::setRateLimit(std::chrono::seconds window, uint32_t burst)
+{
+    std::lock_guard<std::mutex> lock(m_keysMutex);
+
+    m_window = std::max(window, std::chrono::seconds(1));
+    m_burst = burst;
+}
+
+/**
+ * Gibt den Schlüssel mit dem Namen zurück und legt ihn samt Zähler beim ersten Aufruf an.
+ *
+ * @param name Name des Schlüssels, z.B. "node_not_allowed".
+ * @param level Stufe aller Meldungen des Schlüssels.
+ * @return LogKey& Referenz, die für die gesamte Laufzeit gültig bleibt.
+ */
+LogKey& Logger::key(const std::string& name, LogLevel level)
+{
+    std::lock_guard<std::mutex> lock(m_keysMutex);
+
+    for (LogKey& key : m_keys)
+    {
+        if (key.name() == name)
+            return key;
+    }
+
+    Counter& suppressed = sMetrics.counter("webtech_log_suppressed_total", "Log messages counted but not printed due to rate limiting", { { "key", name } });
+    return m_keys.emplace_back(name, level, m_burst, suppressed);
+}
+
+/**
+ * Gibt den Puffer des aufrufenden Threads zurück. Der Logger hält einen zweiten Verweis, damit die
+ * Meldungen eines beendeten Threads noch geschrieben werden; danach wird der Puffer in drain() entfernt.
+ *
+ * @return ThreadBuffer& Der Puffer des Threads.
+ */
+Logger::ThreadBuffer& Logger::threadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+
+    if (!buffer)
+    {
+        buffer = std::make_shared<ThreadBuffer>();
+
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.push_back(buffer);
+    }
+
+    return *buffer;
+}
+
+/**
+ * Gibt den nächsten freien Eintrag im Puffer des Threads zurück.
+ *
+ * @return LogEntry* Der Eintrag oder nullptr, wenn der Puffer voll ist; die Meldung wird dann gezählt.
+ */
+LogEntry* Logger::claim()
+{
+    LogEntry* entry = threadBuffer().claim();
+    if (!entry)
+        m_dropped.inc();
+
+    return entry;
+}
+
+/**
+ * Gibt den zuletzt geholten Eintrag für den Hintergrund-Thread frei.
+ */
+void Logger::commit()
+{
+    threadBuffer().commit();
+}
+
+/**
+ * Hängt Text an die Meldung an. Passt er nicht mehr hinein, wird abgeschnitten und mit "..." markiert.
+ *
+ * @param entry Die Meldung.
+ * @param text Der anzuhängende Text.
+ */
+void Logger::append(LogEntry& entry, std::string_view text)
+{
+    const size_t available = LogEntry::MaxLength - entry.length;
+
+    if (text.size() <= available)
+    {
+        std::memcpy(entry.text + entry.length, text.data(), text.size());
+        entry.length += static_cast<uint16_t>(text.size());
+        return;
+    }
+
+    std::memcpy(entry.text + entry.length, text.data(), available);
+    entry.length = LogEntry::MaxLength;
+    std::memcpy(entry.text + LogEntry::MaxLength - 3, "...", 3);
+}
+
+/**
+ * Schreibt eine Meldung sofort als eigene Zeile.
+ *
+ * @param entry Die Meldung.
+ */
+void Logger::writeDirect(const LogEntry& entry)
+{
+    std::FILE* out = entry.level >= LogLevel::Warning ? stderr : stdout;
+
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    std::fwrite(entry.text, 1, entry.length, out);
+    std::fputc('\n', out);
+    std::fflush(out);
+}
+
+/**
+ * Leert die Puffer aller Threads und schreibt die Meldungen in der Reihenfolge ihres Zeitpunkts.
+ * Puffer von beendeten Threads werden danach entfernt.
+ */
+void Logger::drain()
+{
+    std::lock_guard<std::mutex> outputLock(m_outputMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+
+        for (auto it = m_buffers.begin(); it != m_buffers.end();)
+        {
+            (*it)->popAll(m_pending);
+
+            // Nur noch der Logger verweist auf den Puffer, der Thread ist beendet
+            if (it->use_count() == 1 && (*it)->empty())
+                it = m_buffers.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    if (m_pending.empty())
+        return;
+
+    std::stable_sort(m_pending.begin(), m_pending.end(),
+        [](const LogEntry& a, const LogEntry& b) { return a.time < b.time; });
+
+    for (const LogEntry& entry : m_pending)
+    {
+        std::FILE* out = entry.level >= LogLevel::Warning ? stderr : stdout;
+        std::fwrite(entry.text, 1, entry.length, out);
+        std::fputc('\n', out);
+    }
+
+    std::fflush(stdout);
+    std::fflush(stderr);
+    m_pending.clear();
+}
+
+/**
+ * Beginnt für alle Schlüssel ein neues Zeitfenster und schreibt je Schlüssel eine Zeile mit der
+ * Anzahl der seit dem letzten Fenster unterdrückten Meldungen.
+ */
+void Logger::rollWindows()
+{
+    std::lock_guard<std::mutex> lock(m_keysMutex);
+
+    for (LogKey& key : m_keys)
+    {
+        const uint64_t suppressed = key.rollWindow();
+        if (suppressed == 0)
+            continue;
+
+        LogEntry entry;
+        entry.level = key.level();
+        append(entry, "Log: ");
+        append(entry, suppressed);
+        append(entry, " more '");
+        append(entry, key.name());
+        append(entry, "' message(s) suppressed");
+        writeDirect(entry);
+    }
+}
+
+/**
+ * Schleife des Hintergrund-Threads: leert die Puffer alle DrainInterval und beginnt nach Ablauf
+ * des Zeitfensters ein neues.
+ */
+void Logger::run()
+{
+    std::chrono::steady_clock::time_point nextRoll;
+    {
+        std::lock_guard<std::mutex> keysLock(m_keysMutex);
+        nextRoll = std::chrono::steady_clock::now() + m_window;
+    }
+
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    while (m_running.load(std::memory_order_acquire))
+    {
+        m_wake.wait_for(lock, DrainInterval, [this] { return !m_running.load(std::memory_order_acquire); });
+        lock.unlock();
+
+        drain();
+
+        if (std::chrono::steady_clock::now() >= nextRoll)
+        {
+            rollWindows();
+
+            std::lock_guard<std::mutex> keysLock(m_keysMutex);
+            nextRoll = std::chrono::steady_clock::now() + m_window;
+        }
+
+        lock.lock();
+    }
+}
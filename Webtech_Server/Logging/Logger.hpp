@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <deque>
+#include <type_traits>
+
+class Counter;
+
+/**
+ * Stufe einer Meldung. Debug und Info gehen nach stdout, Warning und Error nach stderr.
+ */
+enum class LogLevel : uint8_t
+{
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+/* Gibt den Namen der Stufe zurück, z.B. "warning" */
+const char* logLevelName(LogLevel level);
+
+/* Liest eine Stufe aus "debug", "info", "warning" oder "error", gibt false bei einem unbekannten Text zurück */
+bool parseLogLevel(std::string_view text, LogLevel& level);
+
+/**
+ * Eine fertig formatierte Meldung, so wie sie im Ringpuffer eines Threads liegt.
+ * Längere Texte werden abgeschnitten und mit "..." markiert.
+ */
+struct LogEntry
+{
+    static constexpr size_t MaxLength = 232;
+
+    std::chrono::steady_clock::time_point time;     ///< Zeitpunkt der Meldung, zum Sortieren über alle Threads.
+    LogLevel level = LogLevel::Info;
+    uint16_t length = 0;
+    char text[MaxLength];
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Eine Art von Meldung, z.B. "node_not_allowed", mit eigener Begrenzung.
+ *
+ * Je Zeitfenster des Loggers werden höchstens burst Meldungen ausgegeben, alle weiteren werden nur
+ * gezählt (webtech_log_suppressed_total) und zu Beginn des nächsten Fensters in einer Zeile
+ * zusammengefasst. Ein einzelner Knoten, der ständig fehlerhafte Nachrichten sendet, kann die
+ * Ausgabe damit nicht mehr fluten. admit() ist sperrfrei.
+ */
+class LogKey
+{
+public:
+    LogKey(std::string name, LogLevel level, uint32_t burst, Counter& suppressed);
+
+    LogKey(LogKey const&) = delete;
+    void operator=(LogKey const&) = delete;
+
+    const std::string& name() const { return m_name; }
+    LogLevel level() const { return m_level; }
+
+    /* Gibt true zurück, wenn die Meldung im aktuellen Zeitfenster noch ausgegeben wird, sonst wird sie gezählt */
+    bool admit();
+
+    /* Beginnt ein neues Zeitfenster, gibt die Anzahl der im alten Fenster unterdrückten Meldungen zurück */
+    uint64_t rollWindow();
+
+private:
+    std::string m_name;
+    LogLevel m_level;
+    uint32_t m_burst;                       ///< 0 schaltet die Begrenzung ab.
+    std::atomic<uint32_t> m_inWindow{ 0 };  ///< Ausgegebene Meldungen im aktuellen Fenster, kann burst leicht überschreiten.
+    Counter& m_suppressed;                  ///< Zählt je Thread-Slot, damit eine Flut unterdrückter Meldungen keine Cache-Zeile teilt.
+    uint64_t m_reported = 0;                ///< Stand von m_suppressed beim letzten rollWindow().
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Asynchroner Logger für die Hot-Paths.
+ *
+ * Jeder schreibende Thread erhält beim ersten Aufruf einen eigenen Ringpuffer (ein Erzeuger, ein
+ * Verbraucher), in den write() die Meldung direkt formatiert. Ein Hintergrund-Thread leert alle
+ * Puffer in festen Abständen, sortiert die Meldungen nach ihrem Zeitpunkt und schreibt sie gesammelt
+ * nach stdout bzw. stderr. Der schreibende Thread sperrt dabei keinen Mutex und macht keinen
+ * Systemaufruf; ist sein Puffer voll, wird die Meldung verworfen und in webtech_log_dropped_total
+ * gezählt.
+ *
+ * Meldungen unter der eingestellten Stufe werden vor dem Formatieren verworfen. Jede Meldung gehört
+ * zu einem LogKey, der wie die Metriken einmalig über key() angelegt und danach über die Referenz
+ * verwendet wird:
+ *
+ *   static LogKey& notAllowed = sLog.key("node_not_allowed", LogLevel::Error);
+ *   sLog.write(notAllowed, "Error: Node ", id, " Not Allowed to Save Data");
+ *
+ * Solange der Logger nicht läuft (vor start() bzw. nach stop()), wird direkt geschrieben.
+ *
+ * Diese Klasse wird als Singleton implementiert und ist über das Makro sLog erreichbar.
+ */
+class Logger
+{
+private:
+    Logger();
+    ~Logger();
+
+    Logger(Logger const&) = delete;
+    void operator=(Logger const&) = delete;
+
+public:
+    static Logger& getInstance()
+    {
+        static Logger instance;
+        return instance;
+    }
+
+    /* Startet den Hintergrund-Thread */
+    void start();
+
+    /* Schreibt alle wartenden Meldungen und beendet den Hintergrund-Thread, erst nach dem Ende aller schreibenden Threads aufrufen */
+    void stop();
+
+    /* Niedrigste Stufe, die ausgegeben wird */
+    void setLevel(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+    LogLevel level() const { return m_level.load(std::memory_order_relaxed); }
+
+    /* Länge des Zeitfensters und Anzahl der Meldungen je Schlüssel und Fenster für später angelegte Schlüssel, 0 schaltet die Begrenzung ab */
+    void setRateLimit(std::chrono::seconds window, uint32_t burst);
+
+    /* Gibt den Schlüssel mit dem Namen zurück, legt ihn beim ersten Aufruf an. Die Stufe des ersten Aufrufs gilt */
+    LogKey& key(const std::string& name, LogLevel level);
+
+    /* Formatiert die Argumente hintereinander in den Puffer des Threads, sofern Stufe und Begrenzung des Schlüssels es zulassen */
+    template<typename... Args>
+    void write(LogKey& key, Args const&... args)
+    {
+        if (key.level() < level() || !key.admit())
+            return;
+
+        LogEntry direct;
+        const bool running = m_running.load(std::memory_order_acquire);
+
+        LogEntry* entry = running ? claim() : &direct;
+        if (!entry)
+            return;
+
+        entry->time = std::chrono::steady_clock::now();
+        entry->level = key.level();
+        entry->length = 0;
+        (append(*entry, args), ...);
+
+        if (running)
+            commit();
+        else
+            writeDirect(*entry);
+    }
+
+private:
+    class ThreadBuffer;
+
+    /* Gibt den Puffer des aufrufenden Threads zurück, legt ihn beim ersten Aufruf an */
+    ThreadBuffer& threadBuffer();
+
+    /* Gibt den nächsten freien Eintrag im Puffer des Threads zurück, nullptr wenn der Puffer voll ist */
+    LogEntry* claim();
+
+    /* Gibt den zuletzt mit claim() geholten Eintrag für den Hintergrund-Thread frei */
+    void commit();
+
+    /* Schreibt eine Meldung sofort, ohne den Hintergrund-Thread */
+    void writeDirect(const LogEntry& entry);
+
+    /* Leert alle Puffer und schreibt die Meldungen */
+    void drain();
+
+    /* Beginnt für alle Schlüssel ein neues Zeitfenster und meldet die unterdrückten Meldungen */
+    void rollWindows();
+
+    /* Schleife des Hintergrund-Threads */
+    void run();
+
+    static void append(LogEntry& entry, std::string_view text);
+    static void append(LogEntry& entry, char c) { append(entry, std::string_view(&c, 1)); }
+
+    // Als Template, damit Zeichenketten nicht über die Umwandlung in einen Zeiger als bool ausgegeben werden
+    template<typename T>
+        requires std::same_as<T, bool>
+    static void append(LogEntry& entry, T value) { append(entry, value ? std::string_view("true") : std::string_view("false")); }
+
+    template<typename T>
+        requires (std::integral<T> || std::floating_point<T>) && (!std::same_as<T, bool>) && (!std::same_as<T, char>)
+    static void append(LogEntry& entry, T value)
+    {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        append(entry, std::string_view(buffer, result.ptr - buffer));
+    }
+
+    std::atomic<LogLevel> m_level{ LogLevel::Info };
+    std::atomic<bool> m_running{ false };
+
+    std::mutex m_buffersMutex;              ///< Schützt m_buffers, wird nur beim ersten write() eines Threads und beim Leeren gesperrt.
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+
+    std::mutex m_keysMutex;                 ///< Schützt m_keys und die Einstellungen der Begrenzung.
+    std::deque<LogKey> m_keys;              ///< deque, damit die Referenzen beim Anlegen gültig bleiben.
+    std::chrono::seconds m_window{ 10 };
+    uint32_t m_burst = 10;
+
+    std::mutex m_outputMutex;               ///< Serialisiert die Ausgabe von Hintergrund-Thread und writeDirect().
+    std::vector<LogEntry> m_pending;        ///< Nur im Hintergrund-Thread bzw. nach dessen Ende verwendet.
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+
+    Counter& m_dropped;
+};
+
+// Makro, um den Singleton-Instance der Logger-Klasse zu erhalten.
+#define sLog Logger::getInstance()
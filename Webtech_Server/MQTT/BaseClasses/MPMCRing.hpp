@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Begrenzter, sperrfreier Ringpuffer für mehrere Erzeuger und mehrere Verbraucher.
+ *
+ * Jede Zelle trägt eine Sequenznummer, über die Erzeuger und Verbraucher ohne Mutex erkennen,
+ * ob die Zelle frei bzw. belegt ist (Verfahren nach D. Vyukov). tryPush() und tryPop() kehren
+ * sofort zurück, wenn der Puffer voll bzw. leer ist; das Warten ist Sache des Aufrufers.
+ *
+ * Die Kapazität wird auf die nächste Zweierpotenz aufgerundet.
+ */
+template<typename T>
+class MPMCRing
+{
+public:
+    explicit MPMCRing(size_t capacity) :
+        m_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        m_cells(new Cell[m_mask + 1])
+    {
+        for (size_t i = 0; i <= m_mask; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPMCRing(MPMCRing const&) = delete;
+    void operator=(MPMCRing const&) = delete;
+
+    /* Legt ein Element ab, gibt false zurück wenn der Puffer voll ist */
+    bool tryPush(T&& value)
+    {
+        size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+            if (diff == 0)
+            {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    /* Entnimmt ein Element, gibt false zurück wenn der Puffer leer ist */
+    bool tryPop(T& value)
+    {
+        size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+            if (diff == 0)
+            {
+                if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.value = T();
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = m_dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    /* Kapazität des Puffers */
+    size_t capacity() const { return m_mask + 1; }
+
+    /* Ungefähre Anzahl der Elemente, nur für Statistiken */
+    size_t sizeApprox() const
+    {
+        size_t enqueued = m_enqueuePosition.load(std::memory_order_relaxed);
+        size_t dequeued = m_dequeuePosition.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+private:
+    static constexpr size_t CacheLineSize = 64;
+
+    /**
+     * Eine Zelle des Puffers mit Sequenznummer.
+     */
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    alignas(CacheLineSize) std::atomic<size_t> m_enqueuePosition{ 0 };    ///< Eigene Cache-Zeile, damit Erzeuger und Verbraucher sich nicht stören.
+    alignas(CacheLineSize) std::atomic<size_t> m_dequeuePosition{ 0 };
+};
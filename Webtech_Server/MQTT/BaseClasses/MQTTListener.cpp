@@ -3,6 +3,12 @@ Copyright (c) 2023-2023 Webtech Projekt
 */
 
 #include "MQTTListener.hpp"
+#include "../../Logging/Logger.hpp"
+
+namespace
+{
+    thread_local std::chrono::steady_clock::time_point t_messageArrivedAt;     ///< Gesetzt während message_arrived läuft.
+}
 
 ///////////////////////////////////////////////////////////////////////////////////
 // Callback Klasse
@@ -12,11 +18,11 @@ Copyright (c) 2023-2023 Webtech Projekt
  */
 void ListenerCallback::message_arrived(mqtt::const_message_ptr msg)
 {
-    listener_->message_arrived(msg);
+    listener_->enqueueMessage(msg);
 }
 
 /**
- * Wird aufgerufen, wenn das Senden einer MQTT-Nachricht fehlschlgt.
+ * Wird aufgerufen, wenn das Senden einer MQTT-Nachricht fehlschlägt.
  */
 void ListenerCallback::on_failure(const mqtt::token& tok)
 {
@@ -35,15 +41,23 @@ void ListenerCallback::on_success(const mqtt::token& tok)
 // MQTT Listener Klasse
 
 /**
- * Konstruktor fr den MQTTListener.
- * Initialisiert den MQTT-Client mit dem gegebenen Broker und Topic.
+ * Konstruktor für den MQTTListener.
+ * Initialisiert den MQTT-Client mit dem gegebenen Broker und Topic und legt die Ringpuffer der
+ * Worker an. Der Callback wird sofort gesetzt, Nachrichten, die vor processMessages() eintreffen,
+ * warten im Ringpuffer.
  */
-MQTTListener::MQTTListener(const std::string& broker, const std::string& topic)
-    : broker_(broker), topic_(topic), connected_(false), client_(broker, "") {}
+MQTTListener::MQTTListener(const std::string& broker, const std::string& topic, size_t workerCount)
+    : broker_(broker), topics_{ topic }, connected_(false), callback_(this), client_(broker, "")
+{
+    for (size_t i = 0; i < std::max<size_t>(workerCount, 1); ++i)
+        workers_.push_back(std::make_unique<Worker>(WorkerQueueCapacity));
+
+    client_.set_callback(callback_);
+}
 
 /**
- * Destruktor fr den MQTTListener.
- * Stellt sicher, dass eine bestehende Verbindung beim Zerstren des Objekts getrennt wird.
+ * Destruktor für den MQTTListener.
+ * Stellt sicher, dass eine bestehende Verbindung beim Zerstören des Objekts getrennt wird.
  */
 MQTTListener::~MQTTListener()
 {
@@ -51,6 +65,9 @@ MQTTListener::~MQTTListener()
     {
         disconnect();
     }
+
+    stopProcessing();
+    joinWorkers();
 }
 
 /**
@@ -74,28 +91,38 @@ void MQTTListener::connect()
 }
 
 /**
- * Abonniert das vorher festgelegte Topic beim MQTT-Broker.
+ * Abonniert die vorher festgelegten Topics beim MQTT-Broker.
  */
 void MQTTListener::subscribe()
 {
-    try 
-    {
-        client_.subscribe(topic_, 0)->wait();
-    }
-    catch (const mqtt::exception& exc) 
+    for (const std::string& topic : topics_)
     {
-        std::cerr << "Error: Unable to subscribe to topic '" << topic_ << "': " << exc.what() << std::endl;
+        try 
+        {
+            client_.subscribe(topic, 0)->wait();
+        }
+        catch (const mqtt::exception& exc) 
+        {
+            std::cerr << "Error: Unable to subscribe to topic '" << topic << "': " << exc.what() << std::endl;
+        }
     }
 }
 
+/**
+ * Fügt ein weiteres Topic hinzu, das beim nächsten subscribe() abonniert wird.
+ *
+ * @param topic Das Topic.
+ */
+void MQTTListener::addTopic(const std::string& topic)
+{
+    topics_.push_back(topic);
+}
+
 /**
  * Trennt die Verbindung zum MQTT-Broker.
  */
 void MQTTListener::disconnect()
 {
-    // Stop Listening
-    stopProcessing();
-
     try 
     {
         client_.disconnect()->wait();
@@ -105,41 +132,241 @@ void MQTTListener::disconnect()
     {
         std::cerr << "Error: Unable to disconnect from the MQTT broker: " << exc.what() << std::endl;
     }
+
+    // Stop Listening, erst nach dem Trennen, damit alle zugestellten Nachrichten noch verarbeitet werden
+    stopProcessing();
 }
 
 /**
- * Startet den Prozess, um auf eingehende MQTT-Nachrichten zu hren.
+ * Startet den Prozess, um auf eingehende MQTT-Nachrichten zu hören.
+ * Der aufrufende Thread arbeitet selbst als erster Worker und verarbeitet die Nachrichten seines
+ * Ringpuffers, für weitere Worker werden eigene Threads gestartet. Kehrt zurück, sobald
+ * stopProcessing() aufgerufen wurde und alle Ringpuffer abgearbeitet sind.
  */
 void MQTTListener::processMessages()
 {
-    ListenerCallback cb(this);
-    client_.set_callback(cb);
+    for (size_t i = 1; i < workers_.size(); ++i)
+        workers_[i]->thread = std::thread(&MQTTListener::workerLoop, this, std::ref(*workers_[i]));
 
-    stopProcessing_ = false;
+    workerLoop(*workers_[0]);
 
-    try
-    {
-        client_.start_consuming();  // Startet das asynchrone Konsumieren
+    joinWorkers();
 
-        while (!stopProcessing_)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+    std::cerr << "Shutdown Completed for MQTTListener" << std::endl;
+}
+
+/**
+ * Leitet eine eingetroffene Nachricht an message_arrived weiter.
+ * Topic und Payload werden als std::string_view direkt auf den Puffern der Nachricht übergeben,
+ * msg hält die Puffer für die Dauer des Aufrufs am Leben.
+ *
+ * @param msg Ein Zeiger auf die eingetroffene MQTT-Nachricht.
+ * @param arrivedAt Zeitpunkt des Eintreffens, während des Aufrufs über messageArrivedAt() abrufbar.
+ */
+void MQTTListener::dispatchMessage(const mqtt::const_message_ptr& msg, std::chrono::steady_clock::time_point arrivedAt)
+{
+    if (!msg)
+        return;
+
+    std::string_view topic, payload;
+    messageViews(msg, topic, payload);
+
+    t_messageArrivedAt = arrivedAt;
+    message_arrived(topic, payload);
+}
+
+/**
+ * Gibt den Zeitpunkt zurück, an dem die gerade verarbeitete Nachricht im Callback eingetroffen ist.
+ * Nur innerhalb von message_arrived gültig.
+ *
+ * @return std::chrono::steady_clock::time_point Der Zeitpunkt des Eintreffens.
+ */
+std::chrono::steady_clock::time_point MQTTListener::messageArrivedAt()
+{
+    return t_messageArrivedAt;
+}
+
+/**
+ * Liefert Topic und Payload einer Nachricht als std::string_view auf deren Puffer.
+ *
+ * @param msg Die Nachricht, muss gültig sein.
+ * @param topic Erhält das Topic.
+ * @param payload Erhält den Payload.
+ */
+void MQTTListener::messageViews(const mqtt::const_message_ptr& msg, std::string_view& topic, std::string_view& payload)
+{
+    const mqtt::string_ref& topicRef = msg->get_topic_ref();
+    const mqtt::binary_ref& payloadRef = msg->get_payload_ref();
+
+    topic = topicRef ? std::string_view(topicRef.data(), topicRef.size()) : std::string_view();
+    payload = payloadRef ? std::string_view(payloadRef.data(), payloadRef.size()) : std::string_view();
+}
+
+/**
+ * Übergibt eine eingetroffene Nachricht zur Verarbeitung. Läuft auf dem Callback-Thread und
+ * legt die Nachricht nur in den Ringpuffer des über routingKey() bestimmten Workers. Ist dieser
+ * voll, wartet der Callback, bis wieder Platz frei ist, sodass der Broker die Übertragung drosselt.
+ *
+ * @param msg Ein Zeiger auf die eingetroffene MQTT-Nachricht.
+ */
+void MQTTListener::enqueueMessage(const mqtt::const_message_ptr& msg)
+{
+    if (!msg)
+        return;
 
-        client_.stop_consuming();  // Stoppt das asynchrone Konsumieren
+    std::string_view topic, payload;
+    messageViews(msg, topic, payload);
+
+    if (capture_)
+        capture_->write(topic, payload, static_cast<uint8_t>(msg->get_qos()), msg->is_retained(), std::chrono::system_clock::now());
+
+    Worker& worker = *workers_[routingKey(topic) % workers_.size()];
+
+    QueuedMessage item{ msg, std::chrono::steady_clock::now() };
+    while (!worker.ring.tryPush(std::move(item)))
+    {
+        if (stopProcessing_)
+            return;
+        std::this_thread::yield();
     }
-    catch (const mqtt::exception& exc)
+
+    // Weckt den Worker nur, wenn er tatsächlich schläft
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker.sleeping.exchange(false))
+        worker.sleeping.notify_one();
+}
+
+/**
+ * Setzt die Aufzeichnung, in die enqueueMessage() jede eintreffende Nachricht mit Topic, Payload und
+ * Zeitpunkt schreibt. Mehrere Listener können sich eine Aufzeichnung teilen. Muss vor connect()
+ * aufgerufen werden, da der Callback-Thread ohne Sperre auf die Aufzeichnung zugreift.
+ *
+ * @param capture Die geöffnete Aufzeichnung oder nullptr.
+ */
+void MQTTListener::setCapture(std::shared_ptr<MessageCapture> capture)
+{
+    capture_ = std::move(capture);
+}
+
+/**
+ * Bestimmt den Schlüssel, nach dem Nachrichten auf die Worker verteilt werden.
+ * Nachrichten mit gleichem Schlüssel landen immer beim selben Worker.
+ *
+ * @param topic Das Topic der Nachricht.
+ * @return size_t Der Schlüssel, standardmäßig der Hash des Topics.
+ */
+size_t MQTTListener::routingKey(std::string_view topic) const
+{
+    return std::hash<std::string_view>{}(topic);
+}
+
+/**
+ * Bildet das Topic für ein Shared Subscription. Der Broker verteilt die Nachrichten des Topics
+ * auf alle Clients, die mit derselben Gruppe abonniert haben, jede Nachricht erhält nur einer von ihnen.
+ * Das Topic der zugestellten Nachrichten enthält das Präfix nicht mehr.
+ *
+ * @param group Name der Gruppe.
+ * @param topic Das eigentliche Topic, z.B. "Nodes/+/Data".
+ * @return std::string Das Topic in der Form "$share/{group}/{topic}".
+ */
+std::string MQTTListener::sharedTopic(std::string_view group, std::string_view topic)
+{
+    std::string shared;
+    shared.reserve(8 + group.size() + topic.size());
+    shared.append("$share/").append(group).append("/").append(topic);
+    return shared;
+}
+
+/**
+ * Wartet auf das Ende der zusätzlichen Worker-Threads.
+ */
+void MQTTListener::joinWorkers()
+{
+    for (auto& worker : workers_)
     {
-        std::cerr << "Error: MQTT error occurred: " << exc.what() << std::endl;
+        if (worker->thread.joinable())
+            worker->thread.join();
     }
+}
 
-    std::cerr << "Shutdown Completed for MQTTListener" << std::endl;
+/**
+ * Hauptschleife eines Workers.
+ * Entnimmt pro Durchlauf bis zu WorkerBatchSize Nachrichten aus dem eigenen Ringpuffer,
+ * verarbeitet sie in Reihenfolge und ruft danach messages_processed() auf. Ist der Ringpuffer
+ * leer, wartet der Worker kurz aktiv und legt sich dann schlafen, bis enqueueMessage() oder
+ * stopProcessing() ihn weckt.
+ *
+ * @param worker Der zugehörige Worker.
+ */
+void MQTTListener::workerLoop(Worker& worker)
+{
+    std::array<QueuedMessage, WorkerBatchSize> batch;
+
+    while (true)
+    {
+        size_t count = 0;
+        while (count < batch.size() && worker.ring.tryPop(batch[count]))
+            ++count;
+
+        if (count != 0)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                try
+                {
+                    dispatchMessage(batch[i].msg, batch[i].arrivedAt);
+                }
+                catch (const std::exception& e)
+                {
+                    static LogKey& processError = sLog.key("mqtt_process_error", LogLevel::Error);
+                    sLog.write(processError, "Error: Exception while processing MQTT message: ", e.what());
+                }
+
+                batch[i].msg.reset();
+            }
+
+            messages_processed(count);
+            continue;
+        }
+
+        if (stopProcessing_)
+            break;
+
+        // Kurz aktiv warten, bei hoher Last kommt die nächste Nachricht meist sofort
+        bool pending = false;
+        for (int spin = 0; spin < 64 && !pending; ++spin)
+        {
+            std::this_thread::yield();
+            pending = worker.ring.sizeApprox() != 0;
+        }
+
+        if (pending)
+            continue;
+
+        worker.sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (worker.ring.sizeApprox() != 0 || stopProcessing_)
+        {
+            worker.sleeping = false;
+            continue;
+        }
+
+        worker.sleeping.wait(true);
+    }
 }
 
 /**
- * Stoppt das Hren auf eingehende MQTT-Nachrichten.
+ * Stoppt das Hören auf eingehende MQTT-Nachrichten.
+ * Weckt alle Worker, diese arbeiten ihre Ringpuffer noch ab und beenden sich dann.
  */
 void MQTTListener::stopProcessing() 
 {
     stopProcessing_ = true;
+
+    for (auto& worker : workers_)
+    {
+        worker->sleeping = false;
+        worker->sleeping.notify_one();
+    }
 }
@@ -5,7 +5,12 @@ Copyright (c) 2023-2023 Webtech Projekt
 #pragma once
 
 #include "../../Webtech_Server.h"
-#include "../../MySQL/MySQLConnection.hpp"
+#include "../../Storage/NodeStorage.hpp"
+#include "MPMCRing.hpp"
+#include "MessageCapture.hpp"
+
+#include <array>
+#include <atomic>
 
 class MQTTListener;
 
@@ -18,21 +23,29 @@ class ListenerCallback : public virtual mqtt::callback, public virtual mqtt::iac
 public:
     /**
      * Konstruktor, der einen MQTTListener als Parameter annimmt.
-     * @param listener Zeiger auf den zugehrigen MQTTListener.
+     * @param listener Zeiger auf den zugehörigen MQTTListener.
      */
     ListenerCallback(MQTTListener* listener) : listener_(listener) {}
 
-    // berschriebene Methoden aus mqtt::callback und mqtt::iaction_listener
+    // Überschriebene Methoden aus mqtt::callback und mqtt::iaction_listener
     void message_arrived(mqtt::const_message_ptr msg) override;
     void on_failure(const mqtt::token& tok) override;
     void on_success(const mqtt::token& tok) override;
 
 private:
-    MQTTListener* listener_; ///< Zeiger auf den zugehrigen MQTTListener.
+    MQTTListener* listener_; ///< Zeiger auf den zugehörigen MQTTListener.
 };
 
 /**
- * Klasse zur Verwaltung und zum Abhren von MQTT-Nachrichten.
+ * Klasse zur Verwaltung und zum Abhören von MQTT-Nachrichten.
+ *
+ * Der Callback der MQTT-Bibliothek legt eingetroffene Nachrichten nur in den sperrfreien
+ * Ringpuffer eines Workers ab. Der Thread, der processMessages() aufruft, ist selbst der erste
+ * Worker, weitere Worker laufen auf eigenen Threads. Jeder Worker arbeitet seinen Ringpuffer
+ * blockweise ab und schläft, solange keine Nachrichten anstehen.
+ *
+ * Der Worker wird über routingKey() bestimmt, Nachrichten mit gleichem Schlüssel werden daher in
+ * Reihenfolge verarbeitet. Bei mehr als einem Worker muss message_arrived threadsicher sein.
  */
 class MQTTListener
 {
@@ -41,31 +54,81 @@ public:
      * Konstruktor, der Broker- und Topic-Strings als Parameter annimmt.
      * @param broker String, der den MQTT-Broker angibt.
      * @param topic String, der das abonnierte MQTT-Topic angibt.
+     * @param workerCount Anzahl der Worker einschließlich des Threads von processMessages(), mindestens 1.
      */
-    MQTTListener(const std::string& broker, const std::string& topic);
-    ~MQTTListener();
+    MQTTListener(const std::string& broker, const std::string& topic, size_t workerCount = 1);
+    virtual ~MQTTListener();
 
     // Verbindungsverwaltung
     void connect();                 ///< Stellt eine Verbindung zum MQTT-Broker her.
-    void subscribe();               ///< Abonniert das festgelegte Topic.
+    void subscribe();               ///< Abonniert die festgelegten Topics.
+    void addTopic(const std::string& topic);    ///< Fügt ein weiteres zu abonnierendes Topic hinzu, vor subscribe() aufzurufen.
     void disconnect();              ///< Trennt die Verbindung zum MQTT-Broker.
 
+    // Zeichnet alle eintreffenden Nachrichten auf, vor connect() aufzurufen. nullptr beendet die Aufzeichnung
+    void setCapture(std::shared_ptr<MessageCapture> capture);
+
     // Nachrichtenverarbeitung
-    void processMessages();         ///< Startet das Abhren von eingehenden MQTT-Nachrichten.
-    void stopProcessing();          ///< Stoppt das Abhren von eingehenden MQTT-Nachrichten.
+    void processMessages();         ///< Verarbeitet eingehende MQTT-Nachrichten bis stopProcessing() aufgerufen wird.
+    void stopProcessing();          ///< Stoppt das Abhören von eingehenden MQTT-Nachrichten.
+
+    // Leitet eine eingetroffene Nachricht ohne Kopie von Topic und Payload an message_arrived weiter
+    void dispatchMessage(const mqtt::const_message_ptr& msg, std::chrono::steady_clock::time_point arrivedAt = std::chrono::steady_clock::now());
+
+    // Übergibt eine eingetroffene Nachricht an den zuständigen Worker
+    void enqueueMessage(const mqtt::const_message_ptr& msg);
 
-    // Methoden, die von abgeleiteten Klassen berschrieben werden sollten
-    virtual void message_arrived(mqtt::const_message_ptr msg) = 0;      ///< Wird aufgerufen, wenn eine MQTT-Nachricht eintrifft.
-    virtual void message_failed(const mqtt::token& tok) { };            ///< Wird aufgerufen, wenn das Senden einer MQTT-Nachricht fehlschlgt.
+    // Schlüssel für die Verteilung auf die Worker, Standard ist der Hash des Topics
+    virtual size_t routingKey(std::string_view topic) const;
+
+    // Bildet das Topic für ein Shared Subscription ("$share/{group}/{topic}")
+    static std::string sharedTopic(std::string_view group, std::string_view topic);
+
+    // Methoden, die von abgeleiteten Klassen überschrieben werden sollten
+    virtual void message_arrived(std::string_view topic, std::string_view payload) = 0;   ///< Wird aufgerufen, wenn eine MQTT-Nachricht eintrifft. Topic und Payload verweisen auf den Puffer der Nachricht und sind nur während des Aufrufs gültig.
+    virtual void message_failed(const mqtt::token& tok) { };            ///< Wird aufgerufen, wenn das Senden einer MQTT-Nachricht fehlschlägt.
     virtual void message_success(const mqtt::token& tok) { };           ///< Wird aufgerufen, wenn das Senden einer MQTT-Nachricht erfolgreich war.
+    virtual void messages_processed(size_t count) { };                  ///< Wird auf dem Worker-Thread aufgerufen, nachdem ein Block von count Nachrichten verarbeitet wurde.
 
+protected:
+    /* Zeitpunkt, an dem die gerade in message_arrived verarbeitete Nachricht im Callback eingetroffen ist */
+    static std::chrono::steady_clock::time_point messageArrivedAt();
 
 private:
+    /**
+     * Ein Worker-Thread mit eigenem Ringpuffer.
+     */
+    struct QueuedMessage
+    {
+        mqtt::const_message_ptr msg;
+        std::chrono::steady_clock::time_point arrivedAt;    ///< Zeitpunkt des Callbacks, für die Latenzmessung.
+    };
+
+    struct Worker
+    {
+        explicit Worker(size_t capacity) : ring(capacity) {}
+
+        MPMCRing<QueuedMessage> ring;                   ///< Wartende Nachrichten dieses Workers.
+        std::atomic<bool> sleeping{ false };            ///< Gesetzt, solange der Worker auf neue Nachrichten wartet.
+        std::thread thread;
+    };
+
+    static constexpr size_t WorkerQueueCapacity = 8192;
+    static constexpr size_t WorkerBatchSize = 64;
+
+    static void messageViews(const mqtt::const_message_ptr& msg, std::string_view& topic, std::string_view& payload);
+
+    void joinWorkers();             ///< Wartet auf das Ende der zusätzlichen Worker-Threads.
+    void workerLoop(Worker& worker);
+
     std::string broker_;            ///< MQTT-Broker-String.
-    std::string topic_;             ///< Abonniertes MQTT-Topic.
+    std::vector<std::string> topics_;   ///< Abonnierte MQTT-Topics.
     bool connected_;                ///< Status der Verbindung zum MQTT-Broker.
+    ListenerCallback callback_;     ///< Callback für den MQTT-Client, lebt so lange wie der Client.
     mqtt::async_client client_;     ///< Asynchroner MQTT-Client.
 
-    bool stopProcessing_;           ///< Steuerflag zum Stoppen des Abhrens von Nachrichten.
+    std::atomic<bool> stopProcessing_{ false };         ///< Steuerflag zum Stoppen des Abhörens von Nachrichten.
+    std::shared_ptr<MessageCapture> capture_;           ///< Aufzeichnung der eintreffenden Nachrichten, falls gesetzt.
 
+    std::vector<std::unique_ptr<Worker>> workers_;      ///< Worker, der erste läuft auf dem Thread von processMessages().
 };
@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "MessageCapture.hpp"
+
+namespace
+{
+    constexpr char CaptureMagic[8] = { 'W', 'T', 'C', 'A', 'P', 'T', 'R', '1' };
+    constexpr size_t RecordHeaderSize = 16;     ///< Zeitpunkt, QoS, Flags, Länge von Topic und Payload.
+    constexpr uint8_t FlagRetained = 0x01;
+
+    template<typename T>
+    char* put(char* it, T value)
+    {
+        std::memcpy(it, &value, sizeof(T));
+        return it + sizeof(T);
+    }
+
+    template<typename T>
+    const char* get(const char* it, T& value)
+    {
+        std::memcpy(&value, it, sizeof(T));
+        return it + sizeof(T);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// MessageCapture
+
+/**
+ * Destruktor, schreibt die gepufferten Nachrichten.
+ */
+MessageCapture::~MessageCapture()
+{
+    close();
+}
+
+/**
+ * Legt die Aufzeichnung an. Eine bestehende Datei wird überschrieben.
+ *
+ * @param path Pfad der Datei.
+ * @return bool Gibt false zurück, wenn die Datei nicht angelegt werden konnte.
+ */
+bool MessageCapture::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_file)
+        return false;
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        std::cerr << "Error: Could not create MQTT capture '" << path << "': " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Großer Puffer, damit der Callback-Thread nur selten auf die Platte wartet
+    m_buffer.resize(1 << 20);
+    std::setvbuf(m_file, m_buffer.data(), _IOFBF, m_buffer.size());
+
+    std::fwrite(CaptureMagic, 1, sizeof(CaptureMagic), m_file);
+    m_count = 0;
+    return true;
+}
+
+/**
+ * Schreibt die gepufferten Nachrichten und schließt die Datei.
+ */
+void MessageCapture::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_file)
+        return;
+
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+/**
+ * Hängt eine Nachricht an die Aufzeichnung an. Topics über 64 KiB werden nicht aufgezeichnet.
+ *
+ * @param topic Das Topic der Nachricht.
+ * @param payload Der Payload der Nachricht.
+ * @param qos QoS, mit der die Nachricht zugestellt wurde.
+ * @param retained Gibt an, ob die Nachricht eine gespeicherte Nachricht des Brokers ist.
+ * @param arrivedAt Zeitpunkt des Eintreffens.
+ */
+void MessageCapture::write(std::string_view topic, std::string_view payload, uint8_t qos, bool retained, std::chrono::system_clock::time_point arrivedAt)
+{
+    if (topic.size() > std::numeric_limits<uint16_t>::max() || payload.size() > std::numeric_limits<uint32_t>::max())
+        return;
+
+    char header[RecordHeaderSize];
+    char* it = put(header, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(arrivedAt.time_since_epoch()).count()));
+    it = put(it, qos);
+    it = put(it, static_cast<uint8_t>(retained ? FlagRetained : 0));
+    it = put(it, static_cast<uint16_t>(topic.size()));
+    put(it, static_cast<uint32_t>(payload.size()));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_file)
+        return;
+
+    std::fwrite(header, 1, sizeof(header), m_file);
+    std::fwrite(topic.data(), 1, topic.size(), m_file);
+    std::fwrite(payload.data(), 1, payload.size(), m_file);
+    ++m_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+// CaptureReader
+
+/**
+ * Destruktor, schließt die Datei.
+ */
+CaptureReader::~CaptureReader()
+{
+    if (m_file)
+        std::fclose(m_file);
+}
+
+/**
+ * Öffnet eine Aufzeichnung und prüft die Magic.
+ *
+ * @param path Pfad der Datei.
+ * @return bool Gibt false zurück, wenn die Datei nicht gelesen werden kann oder keine Aufzeichnung ist.
+ */
+bool CaptureReader::open(const std::string& path)
+{
+    if (m_file)
+        std::fclose(m_file);
+
+    m_file = std::fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        std::cerr << "Error: Could not open MQTT capture '" << path << "': " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(CaptureMagic)];
+    if (std::fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) || std::memcmp(magic, CaptureMagic, sizeof(magic)) != 0)
+    {
+        std::cerr << "Error: '" << path << "' is not an MQTT capture" << std::endl;
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+
+    std::fseek(m_file, 0, SEEK_END);
+    m_size = std::ftell(m_file);
+    std::fseek(m_file, sizeof(CaptureMagic), SEEK_SET);
+
+    return true;
+}
+
+/**
+ * Liest die nächste Nachricht.
+ *
+ * Die Längen im Kopf werden vor dem Anlegen der Puffer mit dem Rest der Datei verglichen, damit ein
+ * beschädigter Eintrag keine beliebig großen Puffer anfordert.
+ *
+ * @param message Erhält die Nachricht, die Puffer von topic und payload werden wiederverwendet.
+ * @return bool Gibt false am Ende der Datei oder bei einem unvollständigen bzw. beschädigten Eintrag zurück.
+ */
+bool CaptureReader::next(CapturedMessage& message)
+{
+    if (!m_file)
+        return false;
+
+    const long offset = std::ftell(m_file);
+
+    char header[RecordHeaderSize];
+    if (std::fread(header, 1, sizeof(header), m_file) != sizeof(header))
+        return false;
+
+    uint8_t flags = 0;
+    uint16_t topicLength = 0;
+    uint32_t payloadLength = 0;
+
+    const char* it = get(header, message.arrivedAt);
+    it = get(it, message.qos);
+    it = get(it, flags);
+    it = get(it, topicLength);
+    get(it, payloadLength);
+    message.retained = (flags & FlagRetained) != 0;
+
+    const uint64_t remaining = static_cast<uint64_t>(m_size - offset) - RecordHeaderSize;
+    if (uint64_t(topicLength) + payloadLength > remaining)
+    {
+        std::cerr << "Error: MQTT capture record at offset " << offset << " claims " << topicLength << " + " << payloadLength
+                  << " bytes, but only " << remaining << " are left, stopping" << std::endl;
+        return false;
+    }
+
+    message.topic.resize(topicLength);
+    message.payload.resize(payloadLength);
+
+    return std::fread(message.topic.data(), 1, topicLength, m_file) == topicLength &&
+           std::fread(message.payload.data(), 1, payloadLength, m_file) == payloadLength;
+}
+
+/**
+ * Beginnt wieder bei der ersten Nachricht.
+ */
+void CaptureReader::rewind()
+{
+    if (m_file)
+        std::fseek(m_file, sizeof(CaptureMagic), SEEK_SET);
+}
@@ -0,0 +1,90 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+#include <cstdio>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Eine aufgezeichnete MQTT-Nachricht.
+ */
+struct CapturedMessage
+{
+    int64_t arrivedAt = 0;          ///< Zeitpunkt des Eintreffens in Nanosekunden seit 1970 (Systemuhr).
+    uint8_t qos = 0;
+    bool retained = false;
+    std::string topic;
+    std::string payload;
+};
+
+/**
+ * Zeichnet eingetroffene MQTT-Nachrichten in einer kompakten Binärdatei auf, z.B. um echten
+ * Verkehr später mit dem Replay-Tool wieder abzuspielen.
+ *
+ * Aufbau der Datei: 8 Bytes Magic "WTCAPTR1", danach die Nachrichten hintereinander mit je
+ * 16 Bytes Kopf (int64 Zeitpunkt, uint8 QoS, uint8 Flags, uint16 Länge des Topics, uint32 Länge
+ * des Payloads) gefolgt von Topic und Payload. Alle Werte in der Byte-Reihenfolge des Rechners,
+ * wie im TelemetrySpool.
+ *
+ * write() ist threadsicher, mehrere MQTTListener können in dieselbe Aufzeichnung schreiben.
+ * Die Nachrichten werden gepuffert geschrieben, ein unvollständiger letzter Eintrag nach einem
+ * Absturz wird beim Lesen ignoriert.
+ */
+class MessageCapture
+{
+public:
+    MessageCapture() = default;
+    ~MessageCapture();
+
+    MessageCapture(MessageCapture const&) = delete;
+    void operator=(MessageCapture const&) = delete;
+
+    /* Legt die Datei an bzw. überschreibt sie, gibt false zurück wenn das nicht möglich ist */
+    bool open(const std::string& path);
+
+    /* Schreibt die gepufferten Nachrichten und schließt die Datei */
+    void close();
+
+    /* Hängt eine Nachricht an, ohne geöffnete Datei passiert nichts */
+    void write(std::string_view topic, std::string_view payload, uint8_t qos, bool retained, std::chrono::system_clock::time_point arrivedAt);
+
+    /* Anzahl der geschriebenen Nachrichten */
+    uint64_t count() const { return m_count; }
+
+private:
+    std::mutex m_mutex;
+    std::FILE* m_file = nullptr;
+    std::vector<char> m_buffer;     ///< Puffer für setvbuf, muss so lange leben wie die Datei.
+    uint64_t m_count = 0;
+};
+
+/**
+ * Liest eine Aufzeichnung von MessageCapture Nachricht für Nachricht.
+ */
+class CaptureReader
+{
+public:
+    CaptureReader() = default;
+    ~CaptureReader();
+
+    CaptureReader(CaptureReader const&) = delete;
+    void operator=(CaptureReader const&) = delete;
+
+    /* Öffnet die Datei und prüft die Magic, gibt false zurück wenn das nicht möglich ist */
+    bool open(const std::string& path);
+
+    /* Liest die nächste Nachricht, gibt false am Ende der Datei oder bei einem unvollständigen bzw. beschädigten Eintrag zurück */
+    bool next(CapturedMessage& message);
+
+    /* Beginnt wieder bei der ersten Nachricht */
+    void rewind();
+
+private:
+    std::FILE* m_file = nullptr;
+    long m_size = 0;                ///< Größe der Datei, die Längen im Kopf eines Eintrags dürfen sie nicht überschreiten.
+};
@@ -3,57 +3,147 @@ Copyright (c) 2023-2023 Webtech Projekt
 */
 
 #include "ClientsListener.hpp"
+#include "../Metrics/Metrics.hpp"
+#include "../Metrics/IngestLatency.hpp"
+#include "../Logging/Logger.hpp"
+
+namespace
+{
+    /**
+     * Metriken je Topic-Art, werden einmalig angelegt und danach ohne Sperre aktualisiert.
+     */
+    struct TopicMetrics
+    {
+        Counter& received;
+        Counter& parseFailures;
+        Histogram& parseTime;
+
+        explicit TopicMetrics(const std::string& topic) :
+            received(sMetrics.counter("webtech_mqtt_messages_received_total", "MQTT messages received per topic kind", { { "topic", topic } })),
+            parseFailures(sMetrics.counter("webtech_mqtt_parse_failures_total", "MQTT payloads that could not be parsed", { { "topic", topic } })),
+            parseTime(sMetrics.histogram("webtech_mqtt_parse_seconds", "Time spent parsing MQTT payloads", { { "topic", topic } }))
+        {
+        }
+    };
+
+    TopicMetrics& metricsFor(ClientsListener::TopicKind kind)
+    {
+        static TopicMetrics data("Data");
+        static TopicMetrics binary("Bin");
+        static TopicMetrics batch("Batch");
+
+        switch (kind)
+        {
+            case ClientsListener::TopicKind::Binary: return binary;
+            case ClientsListener::TopicKind::Batch: return batch;
+            default: return data;
+        }
+    }
+}
 
 /**
  * Diese Methode wird aufgerufen, wenn eine MQTT-Nachricht eintrifft.
+ * Topic und Payload werden nicht kopiert, die Node-ID wird direkt als std::string_view
+ * aus dem Topic gelesen und ohne Allokation in der NodeRegistry gesucht.
  *
- * @param msg Ein Zeiger auf die eingetroffene MQTT-Nachricht.
+ * @param topic Das Topic der Nachricht, verweist auf den Puffer der Nachricht.
+ * @param payload Der Payload der Nachricht, verweist auf den Puffer der Nachricht.
  */
-void ClientsListener::message_arrived(mqtt::const_message_ptr msg)
+void ClientsListener::message_arrived(std::string_view topic, std::string_view payload)
 {
-    // Liest den Inhalt (Payload) der Nachricht.
-    std::string payload = msg->get_payload_str();
+    TopicKind kind = TopicKind::Data;
+    std::string_view node_id = TelemetryParser::nodeIdFromTopic(topic, &kind);
 
-    // Liest das Topic der Nachricht.
-    std::string topic = msg->get_topic();
-    std::string node_id = "unk";
+    // Überprüft, ob die Node-ID erfolgreich extrahiert wurde.
+    if (!node_id.empty())
+    {
+        // Sucht den Knoten einmalig, alle weiteren Zugriffe erfolgen über das Handle
+        NodeHandle node = sStorage.findNode(node_id);
 
-    // Extrahiert die Node-ID aus dem Topic (angenommenes Format: "Nodes/{ID}/Data").
-    size_t start = topic.find("Nodes/") + 6;
-    size_t end = topic.find("/Data");
+        TopicMetrics& metrics = metricsFor(kind);
+        metrics.received.inc();
 
-    // berprft, ob die Node-ID erfolgreich extrahiert wurde.
-    if (start != std::string::npos && end != std::string::npos)
-    {
-        node_id = topic.substr(start, end - start);
+        // Mehrere Messwerte werden gemeinsam an den NodeDataWriter übergeben
+        if (kind == TopicKind::Batch)
+        {
+            // Pro Worker-Thread wiederverwendet, damit nicht für jede Nachricht neu allokiert wird
+            thread_local std::vector<NodeData> readings;
+
+            try
+            {
+                ScopedLatency latency(metrics.parseTime);
+                if (!TelemetryParser::parseBatch(payload, readings))
+                {
+                    metrics.parseFailures.inc();
+                    static LogKey& parseError = sLog.key("telemetry_parse_error", LogLevel::Error);
+                    sLog.write(parseError, "Error parsing telemetry batch from id: ", node_id, " (", payload.size(), " bytes)");
+                    return;
+                }
+            }
+            catch (const nlohmann::json::exception& e)
+            {
+                metrics.parseFailures.inc();
+                static LogKey& jsonError = sLog.key("telemetry_json_error", LogLevel::Error);
+                sLog.write(jsonError, "Error parsing JSON from id: ", node_id, ": ", e.what());
+                return;
+            }
 
-        // Versucht, den Payload als JSON zu interpretieren.
-        json data_json;
-        try
+            sIngestLatency.arrivalToParsed.observe(std::chrono::steady_clock::now() - messageArrivedAt());
+
+            sStorage.updateNodeData(node, readings);
+            sStorage.setNodeOnline(node, true);
+            return;
+        }
+
+        // Liest den Payload direkt in eine NodeData-Struktur, unbekannte Formate über den JSON-Parser.
+        NodeData data;
+        if (kind == TopicKind::Binary)
         {
-            data_json = nlohmann::json::parse(payload);
+            ScopedLatency latency(metrics.parseTime);
+            if (!TelemetryParser::parseBinary(payload, data))
+            {
+                metrics.parseFailures.inc();
+                static LogKey& parseError = sLog.key("telemetry_parse_error", LogLevel::Error);
+                sLog.write(parseError, "Error parsing binary telemetry from id: ", node_id, " (", payload.size(), " bytes)");
+                return;
+            }
         }
-        catch (const nlohmann::json::exception& e)
+        else
         {
-            std::cerr << "Error parsing JSON: " << e.what() << std::endl;
-            return;
+            try
+            {
+                ScopedLatency latency(metrics.parseTime);
+                TelemetryParser::parse(payload, data);
+            }
+            catch (const nlohmann::json::exception& e)
+            {
+                metrics.parseFailures.inc();
+                static LogKey& jsonError = sLog.key("telemetry_json_error", LogLevel::Error);
+                sLog.write(jsonError, "Error parsing JSON from id: ", node_id, ": ", e.what());
+                return;
+            }
         }
 
         // Gibt die empfangene ID auf der Konsole aus
-        //std::cout << "Received Data from id: " << id << std::endl;
+        static LogKey& received = sLog.key("telemetry_received", LogLevel::Debug);
+        sLog.write(received, "Received Data from id: ", node_id);
 
-        // Befllt eine NodeData-Struktur mit den extrahierten Werten aus dem JSON.
-        NodeData data;
-        data.temperature = data_json["temp"].get<float>();
-        data.pressure = data_json["pres"].get<uint32_t>();
-        data.altitude = data_json["alt"].get<float>();
-        data.humidity = data_json["hum"].get<uint32_t>();
-        data.lux = data_json["lux"].get<uint32_t>();
-        data.sound = data_json["soun"].get<uint16_t>();
-        data.timeStamp = data_json["time"].get<time_t>();
+        sIngestLatency.arrivalToParsed.observe(std::chrono::steady_clock::now() - messageArrivedAt());
 
         // Aktualisiert die Daten des Knotens in der Datenbank und setzt seinen Online-Status.
-        sMySQL.updateNodeData(node_id, data);
-        sMySQL.setNodeOnline(node_id, true);
+        sStorage.updateNodeData(node, data);
+        sStorage.setNodeOnline(node, true);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Verteilt die Nachrichten anhand der Node-ID auf die Worker. Alle Messwerte eines Knotens
+ * landen beim selben Worker und werden damit in der Reihenfolge ihres Eintreffens verarbeitet.
+ *
+ * @param topic Das Topic der Nachricht.
+ * @return size_t Hash der Node-ID.
+ */
+size_t ClientsListener::routingKey(std::string_view topic) const
+{
+    return std::hash<std::string_view>{}(TelemetryParser::nodeIdFromTopic(topic));
+}
@@ -6,6 +6,7 @@ Copyright (c) 2023-2023 Webtech Projekt
 
 #include "../../Webtech_Server.h"
 #include "BaseClasses/MQTTListener.hpp"
+#include "TelemetryParser.hpp"
 
 class MQTTListener;
 
@@ -13,26 +14,34 @@ class MQTTListener;
 // ClientsListener
 /**
  * Die ClientsListener-Klasse erbt von MQTTListener und implementiert
- * spezifische Funktionen fr das Zerlegen und Auslesen von MQTT-Topics
+ * spezifische Funktionen für das Zerlegen und Auslesen von MQTT-Topics
  * unter Verwendung der JSON-Bibliothek.
  */
 class ClientsListener : public MQTTListener
 {
 public:
+    using TopicKind = TelemetryParser::TopicKind;
+
     /**
-     * Konstruktor fr die ClientsListener-Klasse.
+     * Konstruktor für die ClientsListener-Klasse.
      *
-     * @param broker Der Broker-Endpunkt fr den MQTT-Client.
+     * @param broker Der Broker-Endpunkt für den MQTT-Client.
      * @param topic Das zu abonnierende MQTT-Topic.
+     * @param workerCount Anzahl der Worker einschließlich des Threads von processMessages().
      */
-    ClientsListener(const std::string& broker, const std::string& topic)
-        : MQTTListener(broker, topic) {}
+    ClientsListener(const std::string& broker, const std::string& topic, size_t workerCount = 1)
+        : MQTTListener(broker, topic, workerCount) {}
 
     /**
-     * berschreibt die Methode message_arrived von MQTTListener.
+     * Überschreibt die Methode message_arrived von MQTTListener.
      * Diese Methode wird aufgerufen, wenn eine MQTT-Nachricht eintrifft.
      *
-     * @param msg Ein Zeiger auf die eingetroffene MQTT-Nachricht.
+     * @param topic Das Topic der Nachricht, verweist auf den Puffer der Nachricht.
+     * @param payload Der Payload der Nachricht, verweist auf den Puffer der Nachricht.
      */
-    void message_arrived(mqtt::const_message_ptr msg) override;
+    void message_arrived(std::string_view topic, std::string_view payload) override;
+
+protected:
+    /* Verteilt nach Node-ID, damit die Messwerte eines Knotens in Reihenfolge verarbeitet werden */
+    size_t routingKey(std::string_view topic) const override;
 };
@@ -3,27 +3,38 @@ Copyright (c) 2023-2023 Webtech Projekt
 */
 
 #include "ConnectionListener.hpp"
+#include "../Metrics/Metrics.hpp"
+#include "../Logging/Logger.hpp"
 
 /**
  * Diese Methode wird aufgerufen, wenn eine MQTT-Nachricht eintrifft.
  *
- * @param msg Ein Zeiger auf die eingetroffene MQTT-Nachricht.
+ * @param topic Das Topic der Nachricht, verweist auf den Puffer der Nachricht.
+ * @param payload Der Payload der Nachricht, verweist auf den Puffer der Nachricht.
  */
-void ConnectionListener::message_arrived(mqtt::const_message_ptr msg)
+void ConnectionListener::message_arrived(std::string_view topic, std::string_view payload)
 {
-    // Liest den Payload der MQTT-Nachricht
-    std::string payload = msg->get_payload_str();
     std::string id = "unk";
 
+    static Counter& received = sMetrics.counter("webtech_mqtt_messages_received_total", "MQTT messages received per topic kind", { { "topic", "client/accepted" } });
+    static Counter& parseFailures = sMetrics.counter("webtech_mqtt_parse_failures_total", "MQTT payloads that could not be parsed", { { "topic", "client/accepted" } });
+    static Histogram& parseTime = sMetrics.histogram("webtech_mqtt_parse_seconds", "Time spent parsing MQTT payloads", { { "topic", "client/accepted" } });
+
+    received.inc();
+
     try
     {
-        // Versucht, den Payload als JSON zu parsen
-        json jsonData = json::parse(payload);
+        // Versucht, den Payload direkt aus dem Puffer der Nachricht als JSON zu parsen
+        json jsonData;
+        {
+            ScopedLatency latency(parseTime);
+            jsonData = json::parse(payload);
+        }
 
-        // berprft, ob das JSON-Objekt ein "id"-Feld enthlt
+        // Überprüft, ob das JSON-Objekt ein "id"-Feld enthält
         if (jsonData.contains("id"))
         {
-            // berprft den Datentyp des "id"-Felds und liest den Wert entsprechend aus
+            // Überprüft den Datentyp des "id"-Felds und liest den Wert entsprechend aus
             if (jsonData["id"].is_string())
             {
                 id = jsonData["id"];
@@ -36,25 +47,31 @@ void ConnectionListener::message_arrived(mqtt::const_message_ptr msg)
             }
 
             // Gibt die empfangene ID auf der Konsole aus
-            //std::cout << "Received id: " << id << std::endl;
+            static LogKey& received = sLog.key("connection_received", LogLevel::Debug);
+            sLog.write(received, "Received id: ", id);
 
-            // Fgt den Knoten mit der empfangenen ID zur Datenbank hinzu und setzt seinen Status auf "online"
-            sMySQL.addNode(id);
-            sMySQL.setNodeOnline(id, true);
+            // Fügt den Knoten mit der empfangenen ID zur Datenbank hinzu und setzt seinen Status auf "online"
+            NodeHandle node = sStorage.addNode(id);
+            sStorage.setNodeOnline(node, true);
 
-            // Setzt den Zeitstempel fr den letzten Update-Vorgang
-            sMySQL.setLastSeen(id);
+            // Setzt den Zeitstempel für den letzten Update-Vorgang
+            sStorage.setLastSeen(node);
         }
         else
         {
+            parseFailures.inc();
+
             // Gibt einen Fehler aus, wenn das "id"-Feld nicht im JSON gefunden wird
-            std::cerr << "Error: 'id' field not found in JSON." << std::endl;
+            static LogKey& missingId = sLog.key("connection_missing_id", LogLevel::Error);
+            sLog.write(missingId, "Error: 'id' field not found in JSON.");
         }
 
     }
-    // Fngt etwaige Fehler beim Parsen des JSONs ab und gibt diese aus
+    // Fängt etwaige Fehler beim Parsen des JSONs ab und gibt diese aus
     catch (const json::exception& e)
     {
-        std::cerr << "JSON parsing error: " << e.what() << std::endl;
+        parseFailures.inc();
+        static LogKey& jsonError = sLog.key("connection_json_error", LogLevel::Error);
+        sLog.write(jsonError, "JSON parsing error: ", e.what());
     }
 }
\ No newline at end of file
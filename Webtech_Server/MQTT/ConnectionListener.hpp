@@ -13,26 +13,27 @@ class MQTTListener;
 // ConnectionListener
 /**
  * Die ConnectionListener-Klasse erbt von MQTTListener und implementiert
- * spezifische Funktionen fr das Zerlegen und Auslesen von MQTT-Topics
+ * spezifische Funktionen für das Zerlegen und Auslesen von MQTT-Topics
  * unter Verwendung der JSON-Bibliothek.
  */
 class ConnectionListener : public MQTTListener
 {
 public:
     /**
-     * Konstruktor fr die ConnectionListener-Klasse.
+     * Konstruktor für die ConnectionListener-Klasse.
      *
-     * @param broker Der Broker-Endpunkt fr den MQTT-Client.
+     * @param broker Der Broker-Endpunkt für den MQTT-Client.
      * @param topic Das zu abonnierende MQTT-Topic.
      */
     ConnectionListener(const std::string& broker, const std::string& topic)
         : MQTTListener(broker, topic) {}
 
     /**
-     * berschreibt die Methode message_arrived von MQTTListener.
+     * Überschreibt die Methode message_arrived von MQTTListener.
      * Diese Methode wird aufgerufen, wenn eine MQTT-Nachricht eintrifft.
      *
-     * @param msg Ein Zeiger auf die eingetroffene MQTT-Nachricht.
+     * @param topic Das Topic der Nachricht, verweist auf den Puffer der Nachricht.
+     * @param payload Der Payload der Nachricht, verweist auf den Puffer der Nachricht.
      */
-    void message_arrived(mqtt::const_message_ptr msg) override;
+    void message_arrived(std::string_view topic, std::string_view payload) override;
 };
@@ -0,0 +1,471 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "TelemetryParser.hpp"
+
+#include <bit>
+#include <charconv>
+
+namespace
+{
+    /**
+     * Felder des Telemetrie-Schemas, als Bitmaske um fehlende Felder zu erkennen.
+     */
+    enum TelemetryField : uint32_t
+    {
+        FieldTemperature = 1 << 0,
+        FieldPressure    = 1 << 1,
+        FieldAltitude    = 1 << 2,
+        FieldHumidity    = 1 << 3,
+        FieldLux         = 1 << 4,
+        FieldSound       = 1 << 5,
+        FieldTime        = 1 << 6,
+        FieldAll         = (1 << 7) - 1
+    };
+
+    /**
+     * Eine Zahl aus dem Payload. Ganzzahlen und Gleitkommazahlen werden wie bei
+     * nlohmann::json getrennt gehalten, damit die Umwandlung in den Zieltyp identisch ist.
+     */
+    struct Number
+    {
+        bool isInteger = true;
+        int64_t integer = 0;
+        double real = 0.0;
+
+        template<typename T>
+        T as() const { return isInteger ? static_cast<T>(integer) : static_cast<T>(real); }
+    };
+
+    inline const char* skipWhitespace(const char* it, const char* end)
+    {
+        while (it != end && (*it == ' ' || *it == '\t' || *it == '\n' || *it == '\r'))
+            ++it;
+        return it;
+    }
+
+    /**
+     * Liest eine JSON-Zahl ab der aktuellen Position.
+     *
+     * @return const char* Position nach der Zahl oder nullptr, wenn keine gültige Zahl vorliegt.
+     */
+    const char* parseNumber(const char* it, const char* end, Number& number)
+    {
+        const char* start = it;
+        bool isInteger = true;
+
+        while (it != end)
+        {
+            char c = *it;
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+')
+                ++it;
+            else if (c == '.' || c == 'e' || c == 'E')
+            {
+                isInteger = false;
+                ++it;
+            }
+            else
+                break;
+        }
+
+        if (it == start)
+            return nullptr;
+
+        number.isInteger = isInteger;
+        std::from_chars_result result = isInteger
+            ? std::from_chars(start, it, number.integer)
+            : std::from_chars(start, it, number.real);
+
+        return (result.ec == std::errc() && result.ptr == it) ? it : nullptr;
+    }
+
+    /**
+     * Ordnet einen Schlüssel dem zugehörigen Feld zu.
+     *
+     * @return uint32_t Das Feld oder 0 bei einem unbekannten Schlüssel.
+     */
+    inline uint32_t fieldForKey(std::string_view key)
+    {
+        switch (key.size())
+        {
+            case 3:
+                if (key == "alt") return FieldAltitude;
+                if (key == "hum") return FieldHumidity;
+                if (key == "lux") return FieldLux;
+                break;
+            case 4:
+                if (key == "temp") return FieldTemperature;
+                if (key == "pres") return FieldPressure;
+                if (key == "soun") return FieldSound;
+                if (key == "time") return FieldTime;
+                break;
+        }
+        return 0;
+    }
+
+    /**
+     * Vorzeichenloser Ganzzahltyp gleicher Größe, für das Umkopieren von Gleitkommazahlen.
+     */
+    template<typename T>
+    using UnsignedOf = std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+
+    /**
+     * Liest einen Wert in Little-Endian, unabhängig von der Byte-Reihenfolge und Ausrichtung der Plattform.
+     */
+    template<typename T>
+    inline T loadLittleEndian(const unsigned char* it)
+    {
+        UnsignedOf<T> value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+            value |= static_cast<UnsignedOf<T>>(it[i]) << (8 * i);
+        return std::bit_cast<T>(value);
+    }
+
+    /**
+     * Schreibt einen Wert in Little-Endian.
+     */
+    template<typename T>
+    inline unsigned char* storeLittleEndian(unsigned char* it, T value)
+    {
+        UnsignedOf<T> bits = std::bit_cast<UnsignedOf<T>>(value);
+        for (size_t i = 0; i < sizeof(T); ++i)
+            *it++ = static_cast<unsigned char>(bits >> (8 * i));
+        return it;
+    }
+
+    /**
+     * Liest die Felder eines Messwerts im binären Format, ohne Versionsbyte.
+     */
+    inline void loadNodeData(const unsigned char* it, NodeData& data)
+    {
+        data.temperature = loadLittleEndian<float>(it);
+        data.pressure = loadLittleEndian<uint32_t>(it + 4);
+        data.altitude = loadLittleEndian<float>(it + 8);
+        data.humidity = loadLittleEndian<uint32_t>(it + 12);
+        data.lux = loadLittleEndian<uint32_t>(it + 16);
+        data.sound = loadLittleEndian<uint16_t>(it + 20);
+        data.timeStamp = static_cast<time_t>(loadLittleEndian<int64_t>(it + 22));
+    }
+
+    /**
+     * Schreibt die Felder eines Messwerts im binären Format, ohne Versionsbyte.
+     */
+    inline unsigned char* storeNodeData(unsigned char* it, const NodeData& data)
+    {
+        it = storeLittleEndian(it, data.temperature);
+        it = storeLittleEndian(it, data.pressure);
+        it = storeLittleEndian(it, data.altitude);
+        it = storeLittleEndian(it, data.humidity);
+        it = storeLittleEndian(it, data.lux);
+        it = storeLittleEndian(it, data.sound);
+        return storeLittleEndian(it, static_cast<int64_t>(data.timeStamp));
+    }
+
+    /**
+     * Liest ein flaches Objekt mit genau den sieben bekannten Feldern und Zahlenwerten ab der
+     * öffnenden Klammer, ohne ein JSON-Objekt aufzubauen.
+     *
+     * @return const char* Position nach der schließenden Klammer oder nullptr, wenn das Objekt vom Schema abweicht.
+     */
+    const char* parseObject(const char* it, const char* end, NodeData& data)
+    {
+        if (it == end || *it != '{')
+            return nullptr;
+
+        NodeData result;
+        uint32_t seen = 0;
+
+        it = skipWhitespace(it + 1, end);
+        while (it != end && *it != '}')
+        {
+            // Schlüssel lesen, Escapes werden dem vollständigen Parser überlassen
+            if (*it != '"')
+                return nullptr;
+
+            const char* keyStart = ++it;
+            while (it != end && *it != '"' && *it != '\\')
+                ++it;
+            if (it == end || *it != '"')
+                return nullptr;
+
+            uint32_t field = fieldForKey(std::string_view(keyStart, it - keyStart));
+            if (field == 0)
+                return nullptr;
+
+            it = skipWhitespace(it + 1, end);
+            if (it == end || *it != ':')
+                return nullptr;
+
+            Number number;
+            it = parseNumber(skipWhitespace(it + 1, end), end, number);
+            if (!it)
+                return nullptr;
+
+            switch (field)
+            {
+                case FieldTemperature: result.temperature = number.as<float>(); break;
+                case FieldPressure:    result.pressure = number.as<uint32_t>(); break;
+                case FieldAltitude:    result.altitude = number.as<float>(); break;
+                case FieldHumidity:    result.humidity = number.as<uint32_t>(); break;
+                case FieldLux:         result.lux = number.as<uint32_t>(); break;
+                case FieldSound:       result.sound = number.as<uint16_t>(); break;
+                case FieldTime:        result.timeStamp = number.as<time_t>(); break;
+            }
+            seen |= field;
+
+            it = skipWhitespace(it, end);
+            if (it != end && *it == ',')
+            {
+                // Nach einem Komma muss ein weiterer Schlüssel folgen
+                it = skipWhitespace(it + 1, end);
+                if (it == end || *it != '"')
+                    return nullptr;
+            }
+            else if (it == end || *it != '}')
+                return nullptr;
+        }
+
+        if (it == end || seen != FieldAll)
+            return nullptr;
+
+        data = result;
+        return it + 1;
+    }
+
+    /**
+     * Liest ein Array von Objekten im bekannten Schema in einem Durchlauf.
+     *
+     * @return bool Gibt false zurück, wenn der Payload vom Schema abweicht oder zu viele Messwerte enthält.
+     */
+    bool parseBatchFast(std::string_view payload, std::vector<NodeData>& readings)
+    {
+        const char* it = payload.data();
+        const char* end = it + payload.size();
+
+        it = skipWhitespace(it, end);
+        if (it == end || *it != '[')
+            return false;
+
+        it = skipWhitespace(it + 1, end);
+        while (it != end && *it != ']')
+        {
+            if (readings.size() == TelemetryParser::MaxBatchReadings)
+                return false;
+
+            it = parseObject(it, end, readings.emplace_back());
+            if (!it)
+                return false;
+
+            it = skipWhitespace(it, end);
+            if (it != end && *it == ',')
+            {
+                // Nach einem Komma muss ein weiteres Objekt folgen
+                it = skipWhitespace(it + 1, end);
+                if (it == end || *it != '{')
+                    return false;
+            }
+            else if (it == end || *it != ']')
+                return false;
+        }
+
+        // Nach dem Array sind nur noch Leerzeichen erlaubt
+        return it != end && skipWhitespace(it + 1, end) == end;
+    }
+
+    /**
+     * Liest die Felder eines Messwerts aus einem JSON-Objekt. Fehlende Felder oder falsche Typen lösen eine Ausnahme aus.
+     */
+    void readNodeData(const json& data_json, NodeData& data)
+    {
+        data.temperature = data_json.at("temp").get<float>();
+        data.pressure = data_json.at("pres").get<uint32_t>();
+        data.altitude = data_json.at("alt").get<float>();
+        data.humidity = data_json.at("hum").get<uint32_t>();
+        data.lux = data_json.at("lux").get<uint32_t>();
+        data.sound = data_json.at("soun").get<uint16_t>();
+        data.timeStamp = data_json.at("time").get<time_t>();
+    }
+}
+
+/**
+ * Liest einen Telemetrie-Payload in die NodeData-Struktur.
+ * Weicht der Payload vom bekannten Schema ab, wird der vollständige JSON-Parser verwendet.
+ *
+ * @param payload Der Payload der MQTT-Nachricht.
+ * @param data Die zu befüllende NodeData-Struktur.
+ */
+void TelemetryParser::parse(std::string_view payload, NodeData& data)
+{
+    if (!parseFast(payload, data))
+        parseJson(payload, data);
+}
+
+/**
+ * Liest den Payload in einem Durchlauf, ohne ein JSON-Objekt aufzubauen.
+ * Akzeptiert nur ein flaches Objekt mit genau den sieben bekannten Feldern und Zahlenwerten.
+ *
+ * @param payload Der Payload der MQTT-Nachricht.
+ * @param data Die zu befüllende NodeData-Struktur, wird nur bei Erfolg vollständig geschrieben.
+ * @return bool Gibt false zurück, wenn der Payload vom Schema abweicht.
+ */
+bool TelemetryParser::parseFast(std::string_view payload, NodeData& data)
+{
+    const char* end = payload.data() + payload.size();
+
+    NodeData result;
+    const char* it = parseObject(skipWhitespace(payload.data(), end), end, result);
+
+    // Nach dem Objekt sind nur noch Leerzeichen erlaubt
+    if (!it || skipWhitespace(it, end) != end)
+        return false;
+
+    data = result;
+    return true;
+}
+
+/**
+ * Liest den Payload über nlohmann::json. Fehlende Felder oder falsche Typen lösen eine Ausnahme aus.
+ *
+ * @param payload Der Payload der MQTT-Nachricht.
+ * @param data Die zu befüllende NodeData-Struktur.
+ */
+void TelemetryParser::parseJson(std::string_view payload, NodeData& data)
+{
+    readNodeData(json::parse(payload), data);
+}
+
+/**
+ * Extrahiert die Node-ID aus dem Topic (angenommenes Format: "Nodes/{ID}/Data", "Nodes/{ID}/Bin" bzw. "Nodes/{ID}/Batch").
+ *
+ * @param topic Das Topic der Nachricht.
+ * @param kind Optional, erhält die Art des Topics.
+ * @return std::string_view Die Node-ID als Teil des Topics, leer wenn das Format nicht passt.
+ */
+std::string_view TelemetryParser::nodeIdFromTopic(std::string_view topic, TopicKind* kind)
+{
+    constexpr std::string_view prefix = "Nodes/";
+
+    size_t start = topic.find(prefix);
+    if (start == std::string_view::npos)
+        return std::string_view();
+
+    start += prefix.size();
+    size_t end = topic.find('/', start);
+    if (end == std::string_view::npos)
+        return std::string_view();
+
+    std::string_view suffix = topic.substr(end + 1);
+    TopicKind topicKind;
+    if (suffix == "Data")
+        topicKind = TopicKind::Data;
+    else if (suffix == "Bin")
+        topicKind = TopicKind::Binary;
+    else if (suffix == "Batch")
+        topicKind = TopicKind::Batch;
+    else
+        return std::string_view();
+
+    if (kind)
+        *kind = topicKind;
+
+    return topic.substr(start, end - start);
+}
+
+/**
+ * Liest einen Payload im binären Format direkt in die NodeData-Struktur.
+ *
+ * @param payload Der Payload der MQTT-Nachricht.
+ * @param data Die zu befüllende NodeData-Struktur, wird nur bei Erfolg geschrieben.
+ * @return bool Gibt false zurück, wenn die Version unbekannt ist oder die Länge nicht passt.
+ */
+bool TelemetryParser::parseBinary(std::string_view payload, NodeData& data)
+{
+    if (payload.size() != BinarySize || static_cast<uint8_t>(payload[0]) != BinaryVersion)
+        return false;
+
+    loadNodeData(reinterpret_cast<const unsigned char*>(payload.data()) + 1, data);
+    return true;
+}
+
+/**
+ * Schreibt einen Messwert im binären Format, so wie ihn ein Knoten auf "Nodes/{ID}/Bin" sendet.
+ *
+ * @param data Der Messwert.
+ * @return std::string Der Payload mit BinarySize Bytes.
+ */
+std::string TelemetryParser::encodeBinary(const NodeData& data)
+{
+    std::string payload(BinarySize, '\0');
+    unsigned char* it = reinterpret_cast<unsigned char*>(payload.data());
+
+    *it++ = BinaryVersion;
+    storeNodeData(it, data);
+    return payload;
+}
+
+/**
+ * Liest einen Payload des Topics "Nodes/{ID}/Batch" mit mehreren Messwerten eines Knotens.
+ * Beginnt der Payload mit dem Versionsbyte, wird er als binäres Format gelesen (Versionsbyte gefolgt
+ * von den Messwerten ohne eigenes Versionsbyte), sonst als JSON-Array von Objekten im bekannten Schema.
+ * Das JSON-Array wird zuerst in einem Durchlauf gelesen, bei Abweichungen über nlohmann::json.
+ *
+ * @param payload Der Payload der MQTT-Nachricht.
+ * @param readings Erhält die Messwerte in der Reihenfolge des Payloads.
+ * @return bool Gibt false zurück, wenn das binäre Format ungültig ist, der Batch leer ist oder mehr als MaxBatchReadings Messwerte enthält.
+ */
+bool TelemetryParser::parseBatch(std::string_view payload, std::vector<NodeData>& readings)
+{
+    readings.clear();
+
+    if (!payload.empty() && static_cast<uint8_t>(payload[0]) == BinaryVersion)
+    {
+        constexpr size_t recordSize = BinarySize - 1;
+
+        size_t count = (payload.size() - 1) / recordSize;
+        if ((payload.size() - 1) % recordSize != 0 || count == 0 || count > MaxBatchReadings)
+            return false;
+
+        readings.resize(count);
+        const unsigned char* it = reinterpret_cast<const unsigned char*>(payload.data()) + 1;
+        for (size_t i = 0; i < count; ++i, it += recordSize)
+            loadNodeData(it, readings[i]);
+
+        return true;
+    }
+
+    if (!parseBatchFast(payload, readings))
+    {
+        readings.clear();
+
+        json batch_json = json::parse(payload);
+        if (!batch_json.is_array())
+            throw json::type_error::create(302, "telemetry batch must be an array", &batch_json);
+
+        if (batch_json.size() > MaxBatchReadings)
+            return false;
+
+        readings.resize(batch_json.size());
+        for (size_t i = 0; i < batch_json.size(); ++i)
+            readNodeData(batch_json[i], readings[i]);
+    }
+
+    return !readings.empty();
+}
+
+/**
+ * Schreibt mehrere Messwerte im binären Batch-Format.
+ *
+ * @param readings Die Messwerte.
+ * @return std::string Der Payload mit Versionsbyte und (BinarySize - 1) Bytes je Messwert.
+ */
+std::string TelemetryParser::encodeBinaryBatch(const std::vector<NodeData>& readings)
+{
+    std::string payload(1 + readings.size() * (BinarySize - 1), '\0');
+    unsigned char* it = reinterpret_cast<unsigned char*>(payload.data());
+
+    *it++ = BinaryVersion;
+    for (const NodeData& data : readings)
+        it = storeNodeData(it, data);
+    return payload;
+}
@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "../MySQL/NodeRegistry.hpp"
+
+#include <string_view>
+
+///////////////////////////////////////////////////////////////////////////////////
+// TelemetryParser
+/**
+ * Parser für den Payload der Topics "Nodes/{ID}/Data" (JSON) und "Nodes/{ID}/Bin" (binär).
+ *
+ * Der JSON-Payload hat immer die Form {"temp":..,"pres":..,"alt":..,"hum":..,"lux":..,"soun":..,"time":..}.
+ * parseFast() liest genau dieses Schema in einem Durchlauf direkt aus dem Puffer in eine
+ * NodeData-Struktur, ohne ein JSON-Objekt anzulegen oder Speicher zu allokieren.
+ * Weicht der Payload davon ab (unbekannte oder fehlende Felder, Strings, Escapes, ...),
+ * wird auf den vollständigen nlohmann::json-Parser zurückgegriffen.
+ *
+ * Das binäre Format besteht aus einem Versionsbyte gefolgt von den Feldern ohne Füllbytes,
+ * alle Werte in Little-Endian. Version 1 (31 Bytes):
+ *
+ *   Offset  Typ      Feld
+ *   0       uint8    Version (1)
+ *   1       float32  temp
+ *   5       uint32   pres
+ *   9       float32  alt
+ *   13      uint32   hum
+ *   17      uint32   lux
+ *   21      uint16   soun
+ *   23      int64    time (Unix-Zeit in Sekunden)
+ *
+ * Auf "Nodes/{ID}/Batch" sendet ein Knoten mehrere Messwerte auf einmal, entweder als JSON-Array
+ * von Objekten im obigen Schema oder binär als Versionsbyte gefolgt von den Messwerten ohne
+ * eigenes Versionsbyte (je 30 Bytes).
+ */
+class TelemetryParser
+{
+public:
+    static constexpr uint8_t BinaryVersion = 1;
+    static constexpr size_t BinarySize = 31;
+    static constexpr size_t MaxBatchReadings = 4096;
+
+    /**
+     * Art eines Telemetrie-Topics, ergibt sich aus dessen letzter Ebene.
+     */
+    enum class TopicKind
+    {
+        Data,       ///< "Nodes/{ID}/Data", ein Messwert als JSON.
+        Binary,     ///< "Nodes/{ID}/Bin", ein Messwert im binären Format.
+        Batch       ///< "Nodes/{ID}/Batch", mehrere Messwerte als JSON-Array oder binär.
+    };
+
+    /* Liest die Node-ID aus einem Topic der Form "Nodes/{ID}/Data", "Nodes/{ID}/Bin" oder "Nodes/{ID}/Batch", leer wenn das Topic nicht passt */
+    static std::string_view nodeIdFromTopic(std::string_view topic, TopicKind* kind = nullptr);
+
+    /* Liest den Payload, zuerst über parseFast(), sonst über parseJson(). Wirft json::exception bei ungültigen Daten */
+    static void parse(std::string_view payload, NodeData& data);
+
+    /* Schneller Pfad für das bekannte Schema, gibt false zurück wenn der Payload davon abweicht */
+    static bool parseFast(std::string_view payload, NodeData& data);
+
+    /* Vollständiger Pfad über nlohmann::json, wirft json::exception bei ungültigen Daten */
+    static void parseJson(std::string_view payload, NodeData& data);
+
+    /* Liest das binäre Format, gibt false zurück wenn Version oder Länge nicht passen */
+    static bool parseBinary(std::string_view payload, NodeData& data);
+
+    /* Schreibt einen Messwert im binären Format */
+    static std::string encodeBinary(const NodeData& data);
+
+    /* Liest mehrere Messwerte (JSON-Array oder binär), gibt false zurück wenn der Batch ungültig ist. Wirft json::exception bei ungültigem JSON */
+    static bool parseBatch(std::string_view payload, std::vector<NodeData>& readings);
+
+    /* Schreibt mehrere Messwerte im binären Batch-Format */
+    static std::string encodeBinaryBatch(const std::vector<NodeData>& readings);
+};
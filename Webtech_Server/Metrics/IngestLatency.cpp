@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "IngestLatency.hpp"
+
+namespace
+{
+    /**
+     * Formatiert eine Dauer in Nanosekunden mit passender Einheit, z.B. "850ns", "12.3us" oder "4.1ms".
+     */
+    std::string formatDuration(uint64_t nanoseconds)
+    {
+        char buffer[32];
+
+        if (nanoseconds < 1000)
+            std::snprintf(buffer, sizeof(buffer), "%lluns", static_cast<unsigned long long>(nanoseconds));
+        else if (nanoseconds < 1000000)
+            std::snprintf(buffer, sizeof(buffer), "%.1fus", nanoseconds / 1e3);
+        else if (nanoseconds < 1000000000)
+            std::snprintf(buffer, sizeof(buffer), "%.1fms", nanoseconds / 1e6);
+        else
+            std::snprintf(buffer, sizeof(buffer), "%.1fs", nanoseconds / 1e9);
+
+        return buffer;
+    }
+
+    /**
+     * Gibt eine Zeile der Zusammenfassung für das Intervall seit last aus und merkt sich den aktuellen Stand.
+     */
+    void logStage(const char* stage, const LatencyHistogram& histogram, LatencyHistogram::Snapshot& last)
+    {
+        LatencyHistogram::Snapshot current = histogram.snapshot();
+        LatencyHistogram::Snapshot interval = current;
+        interval -= last;
+        last = current;
+
+        if (interval.count == 0)
+            return;
+
+        std::cout << "Ingest latency " << stage << ": n=" << interval.count
+                  << " p50=" << formatDuration(interval.quantile(0.5))
+                  << " p99=" << formatDuration(interval.quantile(0.99))
+                  << " p999=" << formatDuration(interval.quantile(0.999)) << std::endl;
+    }
+}
+
+/**
+ * Konstruktor, legt die Metriken in der MetricsRegistry an.
+ */
+IngestLatency::IngestLatency() :
+    arrivalToParsed(sMetrics.latency("webtech_ingest_arrival_to_parsed_seconds", "Time from MQTT arrival until the payload is parsed")),
+    parsedToCommitted(sMetrics.latency("webtech_ingest_parsed_to_committed_seconds", "Time from queueing a reading until it is committed to node_data")),
+    nodeTimeToCommitted(sMetrics.latency("webtech_ingest_node_time_to_committed_seconds", "Time from the node's own timestamp until the reading is committed")),
+    futureTimestamps(sMetrics.counter("webtech_ingest_future_timestamps_total", "Readings committed with a node timestamp ahead of the server clock")),
+    invalidTimestamps(sMetrics.counter("webtech_ingest_invalid_timestamps_total", "Readings committed with a node timestamp outside the plausible window"))
+{
+}
+
+/**
+ * Erfasst die Latenz vom Zeitstempel des Knotens bis zum Commit.
+ *
+ * Der Zeitstempel kommt ungeprüft vom Knoten. Liegt er außerhalb des plausiblen Bereichs, wird er
+ * nur gezählt, from_time_t() würde bei sehr großen oder negativen Werten überlaufen.
+ *
+ * @param nodeTime Zeitstempel des Messwerts laut Knoten.
+ * @param now Zeitpunkt des Commits.
+ */
+void IngestLatency::observeNodeTime(time_t nodeTime, std::chrono::system_clock::time_point now)
+{
+    const time_t nowSeconds = std::chrono::system_clock::to_time_t(now);
+    if (nodeTime < nowSeconds - MaxNodeTimeAge.count() || nodeTime > nowSeconds + MaxNodeTimeAhead.count())
+    {
+        invalidTimestamps.inc();
+        return;
+    }
+
+    auto latency = now - std::chrono::system_clock::from_time_t(nodeTime);
+
+    // Der Zeitstempel hat nur Sekunden, erst ab einer vollen Sekunde ist die Uhr des Knotens sicher voraus
+    if (latency <= -std::chrono::seconds(1))
+        futureTimestamps.inc();
+    else
+        nodeTimeToCommitted.observe(latency);
+}
+
+/**
+ * Gibt p50, p99 und p999 jeder Stufe für das Intervall seit dem letzten Aufruf auf der Konsole aus.
+ * Stufen ohne Messwerte im Intervall werden ausgelassen.
+ */
+void IngestLatency::logSummary()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    logStage("arrival->parsed", arrivalToParsed, m_lastArrivalToParsed);
+    logStage("parsed->committed", parsedToCommitted, m_lastParsedToCommitted);
+    logStage("node time->committed", nodeTimeToCommitted, m_lastNodeTimeToCommitted);
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "Metrics.hpp"
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Latenzen eines Messwerts auf dem Weg vom Eintreffen der MQTT-Nachricht bis zum Commit in node_data.
+ *
+ * - arrivalToParsed: Eintreffen im Callback der MQTT-Bibliothek bis der Payload gelesen ist,
+ *   enthält die Wartezeit im Ringpuffer des Workers.
+ * - parsedToCommitted: Einreihen in den NodeDataWriter bis zum erfolgreichen Schreiben,
+ *   enthält das Sammeln zu Batches. Messwerte aus dem Spool werden nicht erfasst.
+ * - nodeTimeToCommitted: Zeitstempel des Knotens bis zum Commit. Wächst bei Rückstau oder wenn die
+ *   Uhr des Knotens nachgeht, die Auflösung ist durch den Zeitstempel auf eine Sekunde begrenzt.
+ *   Zeitstempel in der Zukunft werden nur gezählt, ebenso Zeitstempel außerhalb von
+ *   [now - MaxNodeTimeAge, now + MaxNodeTimeAhead], die auf eine falsch gestellte Uhr hindeuten.
+ *
+ * Diese Klasse wird als Singleton implementiert und ist über das Makro sIngestLatency erreichbar.
+ */
+class IngestLatency
+{
+private:
+    IngestLatency();
+
+    IngestLatency(IngestLatency const&) = delete;
+    void operator=(IngestLatency const&) = delete;
+
+public:
+    static IngestLatency& getInstance()
+    {
+        static IngestLatency instance;
+        return instance;
+    }
+
+    LatencyHistogram& arrivalToParsed;
+    LatencyHistogram& parsedToCommitted;
+    LatencyHistogram& nodeTimeToCommitted;
+    Counter& futureTimestamps;
+    Counter& invalidTimestamps;
+
+    static constexpr std::chrono::seconds MaxNodeTimeAge{ 365 * 24 * 3600 };    ///< Ältere Zeitstempel gelten als ungültig.
+    static constexpr std::chrono::seconds MaxNodeTimeAhead{ 24 * 3600 };        ///< Weiter vorausgehende Zeitstempel gelten als ungültig.
+
+    /* Erfasst die Latenz zum Zeitstempel des Knotens, now ist der Zeitpunkt des Commits */
+    void observeNodeTime(time_t nodeTime, std::chrono::system_clock::time_point now);
+
+    /* Gibt p50, p99 und p999 seit dem letzten Aufruf auf der Konsole aus */
+    void logSummary();
+
+private:
+    std::mutex m_mutex;
+    LatencyHistogram::Snapshot m_lastArrivalToParsed;
+    LatencyHistogram::Snapshot m_lastParsedToCommitted;
+    LatencyHistogram::Snapshot m_lastNodeTimeToCommitted;
+};
+
+// Makro, um den Singleton-Instance der IngestLatency-Klasse zu erhalten.
+#define sIngestLatency IngestLatency::getInstance()
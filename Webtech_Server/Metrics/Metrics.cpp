@@ -0,0 +1,449 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "Metrics.hpp"
+
+#include <bit>
+#include <cmath>
+
+namespace
+{
+    /**
+     * Hängt einen Zahlenwert im Format von Prometheus an.
+     */
+    void appendValue(std::string& out, double value)
+    {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        out += buffer;
+    }
+
+    /**
+     * Hängt den Namen einer Zeitreihe samt Labels an, extra wird als zusätzliches Label angehängt.
+     */
+    void appendSeriesName(std::string& out, const std::string& name, const char* suffix, const std::string& labels, const std::string& extra = std::string())
+    {
+        out += name;
+        out += suffix;
+
+        if (labels.empty() && extra.empty())
+            return;
+
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty())
+            out += ',';
+        out += extra;
+        out += '}';
+    }
+}
+
+/**
+ * Gibt die Summe des Zählers über alle Slots zurück.
+ *
+ * @return uint64_t Der aktuelle Zählerstand.
+ */
+uint64_t Counter::value() const
+{
+    uint64_t sum = 0;
+    for (const Slot& slot : m_slots)
+        sum += slot.value.load(std::memory_order_relaxed);
+    return sum;
+}
+
+/**
+ * Erfasst eine Laufzeit im Bucket mit der kleinsten passenden Obergrenze.
+ *
+ * @param duration Die gemessene Laufzeit.
+ */
+void Histogram::observe(std::chrono::nanoseconds duration)
+{
+    uint64_t nanoseconds = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+
+    size_t bucket = 0;
+    while (bucket < Bounds.size() && nanoseconds > Bounds[bucket])
+        ++bucket;
+
+    Slot& slot = m_slots[metricThreadSlot()];
+    slot.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    slot.sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+/**
+ * Summiert die Buckets aller Slots auf. Die Werte werden ohne Sperre gelesen, ein gleichzeitiges
+ * observe() kann daher in count, aber noch nicht in sum enthalten sein.
+ *
+ * @return Snapshot Die aufsummierten Werte.
+ */
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot result;
+
+    for (const Slot& slot : m_slots)
+    {
+        for (size_t i = 0; i < slot.buckets.size(); ++i)
+        {
+            uint64_t count = slot.buckets[i].load(std::memory_order_relaxed);
+            result.buckets[i] += count;
+            result.count += count;
+        }
+        result.sumNanoseconds += slot.sum.load(std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+/**
+ * Bestimmt den Bucket eines Werts. Werte unter SubBuckets erhalten je einen eigenen Bucket,
+ * darüber bestimmen das höchste gesetzte Bit die Zweierpotenz und die folgenden SubBucketBits
+ * Bits den Bucket innerhalb dieser Zweierpotenz.
+ *
+ * @param nanoseconds Der Wert in Nanosekunden.
+ * @return size_t Index des Buckets.
+ */
+size_t LatencyHistogram::bucketOf(uint64_t nanoseconds)
+{
+    if (nanoseconds < SubBuckets)
+        return static_cast<size_t>(nanoseconds);
+
+    unsigned exponent = static_cast<unsigned>(std::bit_width(nanoseconds)) - 1;
+    if (exponent > MaxExponent)
+        return BucketCount - 1;
+
+    unsigned shift = exponent - SubBucketBits;
+    return static_cast<size_t>((shift + 1) * SubBuckets + ((nanoseconds >> shift) - SubBuckets));
+}
+
+/**
+ * Gibt den größten Wert zurück, der im Bucket landet.
+ *
+ * @param bucket Index des Buckets.
+ * @return uint64_t Obergrenze in Nanosekunden (einschließlich).
+ */
+uint64_t LatencyHistogram::upperBoundOf(size_t bucket)
+{
+    if (bucket < SubBuckets)
+        return bucket;
+
+    unsigned shift = static_cast<unsigned>(bucket / SubBuckets) - 1;
+    uint64_t lower = (SubBuckets + bucket % SubBuckets) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+/**
+ * Erfasst eine Laufzeit im zugehörigen Bucket.
+ *
+ * @param duration Die gemessene Laufzeit.
+ */
+void LatencyHistogram::observe(std::chrono::nanoseconds duration)
+{
+    uint64_t nanoseconds = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+
+    Slot& slot = m_slots[metricThreadSlot()];
+    slot.buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    slot.sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+/**
+ * Summiert die Buckets aller Slots auf, wie Histogram::snapshot() ohne Sperre.
+ *
+ * @return Snapshot Die aufsummierten Werte.
+ */
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot result;
+
+    for (const Slot& slot : m_slots)
+    {
+        for (size_t i = 0; i < BucketCount; ++i)
+        {
+            uint64_t count = slot.buckets[i].load(std::memory_order_relaxed);
+            result.buckets[i] += count;
+            result.count += count;
+        }
+        result.sumNanoseconds += slot.sum.load(std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+/**
+ * Bestimmt das Quantil q. Zurückgegeben wird die Obergrenze des Buckets, der den Wert mit dem
+ * Rang ceil(q * count) enthält, das Ergebnis überschätzt den tatsächlichen Wert also höchstens
+ * um die Breite des Buckets.
+ *
+ * @param q Das Quantil zwischen 0 und 1, z.B. 0.99.
+ * @return uint64_t Der Wert in Nanosekunden, 0 wenn keine Werte erfasst sind.
+ */
+uint64_t LatencyHistogram::Snapshot::quantile(double q) const
+{
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count)));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return upperBoundOf(i);
+    }
+
+    return upperBoundOf(BucketCount - 1);
+}
+
+/**
+ * Zieht einen früheren Stand desselben Histogramms ab.
+ *
+ * @param earlier Der frühere Stand.
+ * @return Snapshot& Dieser Stand mit den Werten seit earlier.
+ */
+LatencyHistogram::Snapshot& LatencyHistogram::Snapshot::operator-=(const Snapshot& earlier)
+{
+    count = 0;
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        buckets[i] = buckets[i] >= earlier.buckets[i] ? buckets[i] - earlier.buckets[i] : 0;
+        count += buckets[i];
+    }
+    sumNanoseconds = sumNanoseconds >= earlier.sumNanoseconds ? sumNanoseconds - earlier.sumNanoseconds : 0;
+    return *this;
+}
+
+/**
+ * Formatiert die Labels im Format von Prometheus, Sonderzeichen in den Werten werden maskiert.
+ *
+ * @param labels Die Labels.
+ * @return std::string Die Labels ohne geschweifte Klammern, z.B. topic="Data",format="json".
+ */
+std::string MetricsRegistry::formatLabels(const MetricLabels& labels)
+{
+    std::string result;
+
+    for (const auto& [name, value] : labels)
+    {
+        if (!result.empty())
+            result += ',';
+
+        result += name;
+        result += "=\"";
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+                result += '\\';
+            if (c == '\n')
+            {
+                result += "\\n";
+                continue;
+            }
+            result += c;
+        }
+        result += '"';
+    }
+
+    return result;
+}
+
+/**
+ * Sucht die Zeitreihe mit Name und Labels oder legt sie an. m_mutex muss gesperrt sein.
+ *
+ * @param name Name der Metrik.
+ * @param help Beschreibung der Metrik, wird beim ersten Anlegen übernommen.
+ * @param type Typ der Metrik (counter, gauge, histogram).
+ * @param labels Labels der Zeitreihe.
+ * @return Series& Die Zeitreihe.
+ */
+MetricsRegistry::Series& MetricsRegistry::series(const std::string& name, const std::string& help, const char* type, const MetricLabels& labels)
+{
+    Family& family = m_families[name];
+    if (family.type.empty())
+    {
+        family.help = help;
+        family.type = type;
+    }
+    else if (family.type != type)
+    {
+        std::cerr << "Error: Metric '" << name << "' registered as " << family.type << " and " << type << std::endl;
+    }
+
+    std::string formatted = formatLabels(labels);
+    for (auto& existing : family.series)
+    {
+        if (existing->labels == formatted)
+            return *existing;
+    }
+
+    family.series.push_back(std::make_unique<Series>());
+    family.series.back()->labels = std::move(formatted);
+    return *family.series.back();
+}
+
+/**
+ * Gibt den Zähler mit Name und Labels zurück und legt ihn beim ersten Aufruf an.
+ *
+ * @return Counter& Referenz, die für die gesamte Laufzeit gültig bleibt.
+ */
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Series& entry = series(name, help, "counter", labels);
+    if (!entry.counter)
+        entry.counter = std::make_unique<Counter>();
+    return *entry.counter;
+}
+
+/**
+ * Gibt den Momentanwert mit Name und Labels zurück und legt ihn beim ersten Aufruf an.
+ *
+ * @return Gauge& Referenz, die für die gesamte Laufzeit gültig bleibt.
+ */
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Series& entry = series(name, help, "gauge", labels);
+    if (!entry.gauge)
+        entry.gauge = std::make_unique<Gauge>();
+    return *entry.gauge;
+}
+
+/**
+ * Gibt das Histogramm mit Name und Labels zurück und legt es beim ersten Aufruf an.
+ *
+ * @return Histogram& Referenz, die für die gesamte Laufzeit gültig bleibt.
+ */
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Series& entry = series(name, help, "histogram", labels);
+    if (!entry.histogram)
+        entry.histogram = std::make_unique<Histogram>();
+    return *entry.histogram;
+}
+
+/**
+ * Gibt das Latenz-Histogramm mit Name und Labels zurück und legt es beim ersten Aufruf an.
+ *
+ * @return LatencyHistogram& Referenz, die für die gesamte Laufzeit gültig bleibt.
+ */
+LatencyHistogram& MetricsRegistry::latency(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Series& entry = series(name, help, "summary", labels);
+    if (!entry.latency)
+        entry.latency = std::make_unique<LatencyHistogram>();
+    return *entry.latency;
+}
+
+/**
+ * Registriert einen Momentanwert, der erst beim Abruf bestimmt wird, z.B. die Länge einer Warteschlange.
+ * Die Funktion wird auf dem Thread des Abrufs aufgerufen und muss daher threadsicher sein.
+ *
+ * @param callback Liefert den aktuellen Wert.
+ */
+void MetricsRegistry::gaugeCallback(const std::string& name, const std::string& help, std::function<double()> callback, const MetricLabels& labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    series(name, help, "gauge", labels).callback = std::move(callback);
+}
+
+/**
+ * Gibt alle Metriken im Textformat von Prometheus (Version 0.0.4) aus.
+ * Laufzeiten werden in Sekunden ausgegeben.
+ *
+ * @return std::string Der Inhalt für die Antwort auf /metrics.
+ */
+std::string MetricsRegistry::render() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::string out;
+    out.reserve(4096);
+
+    for (const auto& [name, family] : m_families)
+    {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + family.type + "\n";
+
+        for (const auto& series : family.series)
+        {
+            if (series->histogram)
+            {
+                Histogram::Snapshot snapshot = series->histogram->snapshot();
+
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < snapshot.buckets.size(); ++i)
+                {
+                    cumulative += snapshot.buckets[i];
+
+                    std::string le = "le=\"";
+                    if (i < Histogram::Bounds.size())
+                    {
+                        char buffer[32];
+                        std::snprintf(buffer, sizeof(buffer), "%g", Histogram::Bounds[i] / 1e9);
+                        le += buffer;
+                    }
+                    else
+                        le += "+Inf";
+                    le += '"';
+
+                    appendSeriesName(out, name, "_bucket", series->labels, le);
+                    out += ' ' + std::to_string(cumulative) + '\n';
+                }
+
+                appendSeriesName(out, name, "_sum", series->labels);
+                out += ' ';
+                appendValue(out, snapshot.sumNanoseconds / 1e9);
+                out += '\n';
+
+                appendSeriesName(out, name, "_count", series->labels);
+                out += ' ' + std::to_string(snapshot.count) + '\n';
+                continue;
+            }
+
+            if (series->latency)
+            {
+                LatencyHistogram::Snapshot snapshot = series->latency->snapshot();
+
+                for (const char* quantile : { "0.5", "0.99", "0.999" })
+                {
+                    appendSeriesName(out, name, "", series->labels, std::string("quantile=\"") + quantile + '"');
+                    out += ' ';
+                    appendValue(out, snapshot.quantile(std::atof(quantile)) / 1e9);
+                    out += '\n';
+                }
+
+                appendSeriesName(out, name, "_sum", series->labels);
+                out += ' ';
+                appendValue(out, snapshot.sumNanoseconds / 1e9);
+                out += '\n';
+
+                appendSeriesName(out, name, "_count", series->labels);
+                out += ' ' + std::to_string(snapshot.count) + '\n';
+                continue;
+            }
+
+            appendSeriesName(out, name, "", series->labels);
+            out += ' ';
+
+            if (series->counter)
+                out += std::to_string(series->counter->value());
+            else if (series->gauge)
+                out += std::to_string(series->gauge->value());
+            else if (series->callback)
+                appendValue(out, series->callback());
+            else
+                out += '0';
+
+            out += '\n';
+        }
+    }
+
+    return out;
+}
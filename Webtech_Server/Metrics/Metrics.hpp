@@ -0,0 +1,254 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <map>
+
+/**
+ * Anzahl der Slots je Metrik. Jeder Thread schreibt in seinen eigenen Slot, sodass sich die
+ * Threads beim Zählen keine Cache-Zeile teilen. Beim Abruf werden die Slots aufsummiert.
+ */
+static constexpr size_t MetricSlots = 16;
+
+/**
+ * Labels einer Metrik als Paare aus Name und Wert, z.B. {{"topic", "Data"}}.
+ */
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Gibt den Slot des aufrufenden Threads zurück, vergeben reihum beim ersten Aufruf.
+ */
+inline size_t metricThreadSlot()
+{
+    static std::atomic<size_t> nextSlot{ 0 };
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % MetricSlots;
+    return slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Monoton steigender Zähler. inc() ist sperrfrei und schreibt nur in den Slot des Threads.
+ */
+class Counter
+{
+public:
+    /* Erhöht den Zähler */
+    void inc(uint64_t value = 1) { m_slots[metricThreadSlot()].value.fetch_add(value, std::memory_order_relaxed); }
+
+    /* Summe über alle Slots */
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> value{ 0 };
+    };
+
+    std::array<Slot, MetricSlots> m_slots;
+};
+
+/**
+ * Momentanwert, der vom Aufrufer gesetzt wird.
+ */
+class Gauge
+{
+public:
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value{ 0 };
+};
+
+/**
+ * Histogramm für Laufzeiten mit festen Bucket-Grenzen von 1 µs bis 10 s.
+ * observe() ist sperrfrei und schreibt nur in den Slot des Threads.
+ */
+class Histogram
+{
+public:
+    /* Obergrenzen der Buckets in Nanosekunden, der letzte Bucket (+Inf) ist implizit */
+    static constexpr std::array<uint64_t, 15> Bounds = {
+        1000, 5000, 10000, 50000, 100000, 500000,
+        1000000, 5000000, 10000000, 50000000, 100000000, 500000000,
+        1000000000, 5000000000, 10000000000
+    };
+
+    /* Erfasst eine Laufzeit */
+    void observe(std::chrono::nanoseconds duration);
+
+    /* Aufsummierte Werte über alle Slots */
+    struct Snapshot
+    {
+        std::array<uint64_t, Bounds.size() + 1> buckets{};     ///< Anzahl je Bucket, nicht kumuliert.
+        uint64_t count = 0;
+        uint64_t sumNanoseconds = 0;
+    };
+
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::array<std::atomic<uint64_t>, Bounds.size() + 1> buckets{};
+        std::atomic<uint64_t> sum{ 0 };
+    };
+
+    std::array<Slot, MetricSlots> m_slots;
+};
+
+/**
+ * Histogramm für Laufzeiten mit logarithmisch-linearen Buckets nach dem Vorbild von HdrHistogram.
+ *
+ * Jede Zweierpotenz ist in SubBuckets gleich breite Buckets unterteilt, der Fehler eines Quantils
+ * beträgt daher höchstens 1 / SubBuckets (6,25 %) bei konstantem Speicherbedarf. Erfasst werden
+ * Werte von 1 ns bis etwa 73 Minuten, größere Werte landen im letzten Bucket. observe() ist
+ * sperrfrei und schreibt nur in den Slot des Threads.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned SubBucketBits = 4;
+    static constexpr uint64_t SubBuckets = uint64_t(1) << SubBucketBits;
+    static constexpr unsigned MaxExponent = 42;     ///< Höchstes erfasstes Bit, 2^42 ns sind etwa 73 Minuten.
+    static constexpr size_t BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+    /* Index des Buckets für einen Wert in Nanosekunden */
+    static size_t bucketOf(uint64_t nanoseconds);
+
+    /* Größter Wert in Nanosekunden, der im Bucket landet */
+    static uint64_t upperBoundOf(size_t bucket);
+
+    /* Erfasst eine Laufzeit, negative Werte zählen als 0 */
+    void observe(std::chrono::nanoseconds duration);
+
+    /* Aufsummierte Werte über alle Slots */
+    struct Snapshot
+    {
+        std::array<uint64_t, BucketCount> buckets{};
+        uint64_t count = 0;
+        uint64_t sumNanoseconds = 0;
+
+        /* Obergrenze des Buckets, in dem das Quantil q (0..1) liegt, 0 ohne Werte */
+        uint64_t quantile(double q) const;
+
+        /* Zieht einen früheren Stand ab, ergibt die Werte des Intervalls dazwischen */
+        Snapshot& operator-=(const Snapshot& earlier);
+    };
+
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::array<std::atomic<uint64_t>, BucketCount> buckets{};
+        std::atomic<uint64_t> sum{ 0 };
+    };
+
+    std::array<Slot, MetricSlots> m_slots;
+};
+
+/**
+ * Misst die Laufzeit eines Blocks und erfasst sie beim Verlassen im Histogramm.
+ */
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(Histogram& histogram) : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() { m_histogram.observe(std::chrono::steady_clock::now() - m_start); }
+
+    ScopedLatency(ScopedLatency const&) = delete;
+    void operator=(ScopedLatency const&) = delete;
+
+private:
+    Histogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Registry aller Metriken des Servers, Ausgabe im Textformat von Prometheus.
+ *
+ * Die Metriken werden einmalig über counter(), gauge(), histogram() bzw. latency() angelegt und danach über
+ * die zurückgegebene Referenz aktualisiert, die für die gesamte Laufzeit gültig bleibt. Nur das
+ * Anlegen und render() sperren einen Mutex, das Aktualisieren ist sperrfrei.
+ *
+ * Diese Klasse wird als Singleton implementiert und ist über das Makro sMetrics erreichbar.
+ */
+class MetricsRegistry
+{
+private:
+    MetricsRegistry() = default;
+
+    MetricsRegistry(MetricsRegistry const&) = delete;
+    void operator=(MetricsRegistry const&) = delete;
+
+public:
+    static MetricsRegistry& getInstance()
+    {
+        static MetricsRegistry instance;
+        return instance;
+    }
+
+    /* Gibt den Zähler mit Name und Labels zurück, legt ihn beim ersten Aufruf an */
+    Counter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+    /* Gibt den Momentanwert mit Name und Labels zurück, legt ihn beim ersten Aufruf an */
+    Gauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+    /* Gibt das Histogramm mit Name und Labels zurück, legt es beim ersten Aufruf an */
+    Histogram& histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+    /* Gibt das Latenz-Histogramm mit Name und Labels zurück, wird als summary mit p50, p99 und p999 ausgegeben */
+    LatencyHistogram& latency(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+
+    /* Momentanwert, der erst beim Abruf über die Funktion bestimmt wird. Ersetzt eine bereits registrierte Funktion */
+    void gaugeCallback(const std::string& name, const std::string& help, std::function<double()> callback, const MetricLabels& labels = {});
+
+    /* Alle Metriken im Textformat von Prometheus */
+    std::string render() const;
+
+private:
+    /**
+     * Eine Zeitreihe einer Metrik, genau einer der Zeiger bzw. callback ist gesetzt.
+     */
+    struct Series
+    {
+        std::string labels;                         ///< Bereits formatiert, z.B. topic="Data".
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::unique_ptr<LatencyHistogram> latency;
+        std::function<double()> callback;
+    };
+
+    /**
+     * Alle Zeitreihen eines Metriknamens.
+     */
+    struct Family
+    {
+        std::string help;
+        std::string type;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    Series& series(const std::string& name, const std::string& help, const char* type, const MetricLabels& labels);
+
+    static std::string formatLabels(const MetricLabels& labels);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Family> m_families;       ///< Nach Name sortiert, damit die Ausgabe stabil ist.
+};
+
+// Makro, um den Singleton-Instance der MetricsRegistry-Klasse zu erhalten.
+#define sMetrics MetricsRegistry::getInstance()
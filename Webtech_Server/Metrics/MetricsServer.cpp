@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "MetricsServer.hpp"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Konstruktor für den MetricsServer.
+ *
+ * @param port TCP-Port, auf dem /metrics ausgeliefert wird.
+ */
+MetricsServer::MetricsServer(uint16_t port) :
+    m_port(port)
+{
+}
+
+/**
+ * Destruktor, stellt sicher, dass der Thread beendet ist.
+ */
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+/**
+ * Öffnet den Port auf allen Schnittstellen und startet den Thread, der die Anfragen beantwortet.
+ *
+ * @return bool Gibt false zurück, wenn der Port nicht geöffnet werden konnte.
+ */
+bool MetricsServer::start()
+{
+    if (m_thread.joinable())
+        return true;
+
+    m_socket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+    {
+        std::cerr << "Error: Metrics server could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    int reuse = 1;
+    ::setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(m_port);
+
+    if (::bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_socket, 16) != 0)
+    {
+        std::cerr << "Error: Metrics server could not listen on port " << m_port << ": " << std::strerror(errno) << std::endl;
+        ::close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    m_stopping = false;
+    m_thread = std::thread(&MetricsServer::serveLoop, this);
+    return true;
+}
+
+/**
+ * Beendet den Thread und schließt den Port.
+ */
+void MetricsServer::stop()
+{
+    m_stopping = true;
+
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_socket >= 0)
+    {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+/**
+ * Hauptschleife des Servers. Wartet mit Zeitlimit auf neue Verbindungen, damit stop() den
+ * Thread zügig beenden kann.
+ */
+void MetricsServer::serveLoop()
+{
+    while (!m_stopping)
+    {
+        pollfd descriptor{ m_socket, POLLIN, 0 };
+        if (::poll(&descriptor, 1, 200) <= 0)
+            continue;
+
+        int client = ::accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+            continue;
+
+        handleClient(client);
+        ::close(client);
+    }
+}
+
+/**
+ * Beantwortet eine einzelne Anfrage. Nur GET /metrics liefert die Metriken, alles andere 404.
+ *
+ * @param client Socket der Verbindung.
+ */
+void MetricsServer::handleClient(int client)
+{
+    // Langsame oder hängende Clients dürfen den Server nicht blockieren
+    timeval timeout{ 1, 0 };
+    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Es wird nur die Anfragezeile benötigt, der Rest der Anfrage wird ignoriert
+    char buffer[2048];
+    size_t received = 0;
+    while (received < sizeof(buffer))
+    {
+        ssize_t n = ::recv(client, buffer + received, sizeof(buffer) - received, 0);
+        if (n <= 0)
+            break;
+
+        received += static_cast<size_t>(n);
+        if (std::string_view(buffer, received).find("\r\n") != std::string_view::npos)
+            break;
+    }
+
+    std::string_view request(buffer, received);
+    bool isMetrics = request.starts_with("GET /metrics ") || request.starts_with("GET /metrics?");
+
+    std::string body = isMetrics ? sMetrics.render() : std::string("Not Found\n");
+    std::string response = isMetrics ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n";
+    response += isMetrics ? "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n" : "Content-Type: text/plain\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+        ssize_t n = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        sent += static_cast<size_t>(n);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "Metrics.hpp"
+
+#include <atomic>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Minimaler HTTP-Server, der die Metriken der MetricsRegistry unter /metrics ausliefert.
+ *
+ * Die Anfragen werden nacheinander auf einem eigenen Thread beantwortet, jede Verbindung wird
+ * nach der Antwort geschlossen. Das genügt für den Abruf durch Prometheus im Abstand einiger Sekunden.
+ */
+class MetricsServer
+{
+public:
+    explicit MetricsServer(uint16_t port);
+    ~MetricsServer();
+
+    MetricsServer(MetricsServer const&) = delete;
+    void operator=(MetricsServer const&) = delete;
+
+    /* Öffnet den Port und startet den Thread, gibt false zurück wenn der Port nicht geöffnet werden konnte */
+    bool start();
+
+    /* Beendet den Thread und schließt den Port */
+    void stop();
+
+private:
+    void serveLoop();
+    void handleClient(int client);
+
+    uint16_t m_port;
+    int m_socket = -1;
+    std::thread m_thread;
+    std::atomic<bool> m_stopping{ false };
+};
@@ -0,0 +1,882 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "MySQLBackend.hpp"
+#include "NodeDataWriter.hpp"
+#include "../Logging/Logger.hpp"
+#include "../Storage/DateTimeFormat.hpp"
+
+#include <bit>
+
+namespace
+{
+    /**
+     * Baut eine mehrzeilige INSERT-Anweisung für die Spalten von node_data auf.
+     *
+     * @param head Anfang der Anweisung bis einschließlich VALUES.
+     * @param rows Anzahl der Zeilen.
+     * @param tail Ende der Anweisung nach den Zeilen.
+     * @param timestamp Platzhalter für den Zeitstempel, "?" oder "FROM_UNIXTIME(?)".
+     * @return std::string Die vollständige Anweisung.
+     */
+    std::string buildNodeDataQuery(const char* head, size_t rows, const char* tail, const char* timestamp)
+    {
+        const std::string row = std::string("(?, ") + timestamp + ", ?, ?, ?, ?, ?, ?)";
+
+        std::string query = head;
+        for (size_t i = 0; i < rows; ++i)
+        {
+            if (i != 0)
+                query += ", ";
+            query += row;
+        }
+        query += tail;
+        return query;
+    }
+
+    /**
+     * Bindet einen Messwert an die Parameter einer Zeile aus buildNodeDataQuery().
+     *
+     * @param stmt Die vorbereitete Anweisung.
+     * @param param Index des ersten Parameters der Zeile.
+     * @param record Der Messwert.
+     * @param timeStamp Der bereits formatierte Zeitstempel des Messwerts, nullptr bindet ihn als Unix-Zeit.
+     */
+    void bindNodeDataRow(sql::PreparedStatement& stmt, unsigned int param, const NodeDataRecord& record, const char* timeStamp)
+    {
+        stmt.setString(param++, sql::SQLString(record.id.data(), record.id.size()));
+        if (timeStamp)
+            stmt.setString(param++, timeStamp);
+        else
+            stmt.setInt64(param++, record.data.timeStamp);
+        stmt.setDouble(param++, record.data.temperature);
+        stmt.setInt(param++, record.data.pressure);
+        stmt.setInt(param++, record.data.altitude);
+        stmt.setInt(param++, record.data.humidity);
+        stmt.setInt(param++, record.data.lux);
+        stmt.setInt(param++, record.data.sound);
+    }
+
+    /**
+     * Gibt den lokalen Kalendertag eines Zeitpunkts zurück, passend zu den lokal formatierten Zeitstempeln.
+     */
+    std::chrono::sys_days localDay(time_t time)
+    {
+        const std::tm tm = toLocalTime(time);
+        return std::chrono::year_month_day{ std::chrono::year{ tm.tm_year + 1900 },
+                                            std::chrono::month{ static_cast<unsigned>(tm.tm_mon + 1) },
+                                            std::chrono::day{ static_cast<unsigned>(tm.tm_mday) } };
+    }
+
+    /**
+     * Formatiert einen Tag im angegebenen Format, z.B. "p%04d%02u%02u" für den Partitionsnamen.
+     */
+    std::string formatDay(std::chrono::sys_days day, const char* format)
+    {
+        std::chrono::year_month_day ymd{ day };
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), format, static_cast<int>(ymd.year()), static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));
+        return buffer;
+    }
+
+    /**
+     * Definition der Tagespartition, die alle Zeilen vor dem Folgetag aufnimmt.
+     */
+    std::string partitionDefinition(std::chrono::sys_days day)
+    {
+        return "PARTITION " + formatDay(day, "p%04d%02u%02u") + " VALUES LESS THAN (TO_DAYS('" + formatDay(day + std::chrono::days{ 1 }, "%04d-%02u-%02u") + "'))";
+    }
+
+    /**
+     * Liest den Tag aus einem Partitionsnamen der Form pYYYYMMDD.
+     *
+     * @return bool Gibt false zurück, wenn der Name keine Tagespartition bezeichnet (z.B. pmax).
+     */
+    bool parsePartitionDay(const std::string& name, std::chrono::sys_days& day)
+    {
+        int year = 0;
+        unsigned month = 0, dayOfMonth = 0;
+        if (name.size() != 9 || std::sscanf(name.c_str(), "p%4d%2u%2u", &year, &month, &dayOfMonth) != 3)
+            return false;
+
+        std::chrono::year_month_day ymd{ std::chrono::year{ year }, std::chrono::month{ month }, std::chrono::day{ dayOfMonth } };
+        if (!ymd.ok())
+            return false;
+
+        day = ymd;
+        return true;
+    }
+}
+
+/**
+ * Parst den gegebenen String, um MySQL-Verbindungsdetails wie Host, Benutzer, Passwort und Datenbank zu extrahieren.
+ *
+ * @param infoString Ein durch Semikolon getrennter String mit MySQL-Verbindungsdetails.
+ */
+MySQLConnectionInfo::MySQLConnectionInfo(std::string const& infoString)
+{
+    std::istringstream iss(infoString);
+    std::string part;
+    int partIndex = 0;
+
+    // Teilt die infoString an jedem Semikolon
+    while (std::getline(iss, part, ';'))
+    {
+        // Entferne überflüssige Leerzeichen
+        size_t startPos = part.find_first_not_of(" ");
+        size_t endPos = part.find_last_not_of(" ");
+
+        if (startPos != std::string::npos)
+        {
+            part = part.substr(startPos, endPos - startPos + 1);
+        }
+
+        // Weise die Teile den entsprechenden Variablen zu
+        switch (partIndex)
+        {
+            case 0: // Host
+                host = part;
+                break;
+            case 1: // User
+                user = part;
+                break;
+            case 2: // Password
+                password = part;
+                break;
+            case 3: // Database
+                database = part;
+                break;
+            default:
+                // Handle unexpected part
+                break;
+        }
+        partIndex++;
+    }
+}
+
+/**
+ * Konstruktor für das MySQLBackend. Die Verbindungen werden erst mit open() aufgebaut.
+ *
+ * @param connectionInfo Verbindungsinformationen der Datenbank.
+ * @param connectionCount Anzahl der Verbindungen für die Statusänderungen der Knoten.
+ * @param timestampMode Übergabe der Zeitstempel als Text oder als Unix-Zeit.
+ */
+MySQLBackend::MySQLBackend(MySQLConnectionInfo const& connectionInfo, size_t connectionCount, MySQLTimestampMode timestampMode) :
+    m_connectionInfo(connectionInfo), m_timestampMode(timestampMode)
+{
+    for (size_t i = 0; i < std::max<size_t>(1, connectionCount); ++i)
+        m_nodeConnections.push_back(std::make_unique<NodeConnection>());
+
+    // Für das gesammelte Schreiben von lastSeen werden volle Blöcke mit einer eigenen Anweisung
+    // geschrieben, Reste in Zweierpotenzen zerlegt. Es wird bewusst ein UPDATE verwendet, damit
+    // ein zwischenzeitlich über die Webseite gelöschter Knoten nicht neu angelegt wird
+    for (size_t rows = LastSeenBatchSize; rows > 0; rows = std::bit_floor(rows - 1))
+    {
+        std::string query = "UPDATE nodes SET lastSeen = CASE id";
+        for (size_t i = 0; i < rows; ++i)
+            query += std::string(" WHEN ? THEN ") + timestampPlaceholder();
+        query += " END WHERE id IN (";
+        for (size_t i = 0; i < rows; ++i)
+            query += (i == 0) ? "?" : ", ?";
+        query += ")";
+
+        m_lastSeenUpdateQueries.emplace(rows, std::move(query));
+    }
+}
+
+/**
+ * Destruktor, trennt die Verbindungen der Schreib-Threads.
+ */
+MySQLBackend::~MySQLBackend()
+{
+    closeWriters();
+}
+
+/**
+ * Stellt die Verbindungen zur MySQL-Datenbank mit den hinterlegten Verbindungsinformationen her.
+ *
+ * @return bool Gibt true zurück, wenn die Verbindungen aufgebaut wurden, sonst false.
+ */
+bool MySQLBackend::open()
+{
+    try
+    {
+        driver_ = sql::mysql::get_mysql_driver_instance();
+
+        {
+            std::lock_guard<std::mutex> lock(m_connectionMutex);
+            m_session = openSession();
+        }
+
+        // Jede Verbindung übernimmt die Statusänderungen der ihr zugeordneten Knoten
+        for (auto& connection : m_nodeConnections)
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            connection->session = openSession();
+        }
+    }
+    catch (const sql::SQLException& e)
+    {
+        std::cerr << "SQL Exception in open: " << e.what() << std::endl;
+        std::cerr << "Error Code: " << e.getErrorCode() << std::endl;
+        std::cerr << "SQL State: " << e.getSQLState() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Baut die Verbindungen der Schreib-Threads auf und bereitet die INSERT-Anweisungen vor.
+ *
+ * @param writerCount Anzahl der Schreib-Threads.
+ * @param batchSize Maximale Anzahl Messwerte eines Batches.
+ * @return bool Gibt false zurück, wenn eine Verbindung nicht aufgebaut werden konnte.
+ */
+bool MySQLBackend::openWriters(size_t writerCount, size_t batchSize)
+{
+    // Größere Batches werden in mehrere Anweisungen innerhalb einer Transaktion zerlegt
+    batchSize = std::min(batchSize, MaxNodeDataRows);
+
+    // Volle Batches verwenden eine eigene Anweisung, Reste werden in Zweierpotenzen zerlegt,
+    // damit pro Verbindung nur wenige unterschiedliche Anweisungen vorbereitet werden
+    m_nodeDataInsertQueries.clear();
+    m_nodeDataHistoryQueries.clear();
+    for (size_t rows = batchSize; rows > 0; rows = std::bit_floor(rows - 1))
+    {
+        m_nodeDataInsertQueries.emplace(rows, buildNodeDataQuery(
+            "INSERT INTO node_data(id, timestamp, temperature, pressure, altitude, humidity, lux, sound) VALUES ", rows,
+            " ON DUPLICATE KEY UPDATE"
+            " temperature = IF(VALUES(timestamp) >= timestamp, VALUES(temperature), temperature),"
+            " pressure = IF(VALUES(timestamp) >= timestamp, VALUES(pressure), pressure),"
+            " altitude = IF(VALUES(timestamp) >= timestamp, VALUES(altitude), altitude),"
+            " humidity = IF(VALUES(timestamp) >= timestamp, VALUES(humidity), humidity),"
+            " lux = IF(VALUES(timestamp) >= timestamp, VALUES(lux), lux),"
+            " sound = IF(VALUES(timestamp) >= timestamp, VALUES(sound), sound),"
+            " timestamp = GREATEST(timestamp, VALUES(timestamp))", timestampPlaceholder()));
+
+        // Doppelte Messwerte (gleicher Knoten, gleiche Sekunde) werden in der Historie verworfen
+        m_nodeDataHistoryQueries.emplace(rows, buildNodeDataQuery(
+            "INSERT IGNORE INTO node_data_history(id, timestamp, temperature, pressure, altitude, humidity, lux, sound) VALUES ", rows, "", timestampPlaceholder()));
+    }
+
+    try
+    {
+        for (size_t i = 0; i < writerCount; ++i)
+            m_writerSessions.push_back(openSession());
+    }
+    catch (const sql::SQLException& e)
+    {
+        std::cerr << "SQL Exception in openWriters: " << e.what() << std::endl;
+        m_writerSessions.clear();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Trennt die Verbindungen der Schreib-Threads.
+ */
+void MySQLBackend::closeWriters()
+{
+    m_writerSessions.clear();
+}
+
+/**
+ * Baut eine neue Verbindung zur MySQL-Datenbank auf und wählt das Schema aus.
+ *
+ * @return sql::Connection* Die neue Verbindung, der Aufrufer übernimmt den Besitz.
+ */
+sql::Connection* MySQLBackend::openConnection()
+{
+    sql::Connection* connection = driver_->connect(m_connectionInfo.host, m_connectionInfo.user, m_connectionInfo.password);
+    connection->setSchema(m_connectionInfo.database);
+    return connection;
+}
+
+/**
+ * Legt eine neue Session an, deren Verbindungen über openConnection() aufgebaut werden.
+ *
+ * @return std::unique_ptr<MySQLSession> Die verbundene Session.
+ */
+std::unique_ptr<MySQLSession> MySQLBackend::openSession()
+{
+    auto session = std::make_unique<MySQLSession>([this] { return openConnection(); });
+    session->open();
+    return session;
+}
+
+/**
+ * Fügt einen Knoten zur Datenbank hinzu oder aktualisiert ihn, wenn er bereits existiert.
+ *
+ * @param id ID des hinzuzufügenden oder zu aktualisierenden Knotens.
+ * @return bool Gibt false zurück, wenn das Schreiben fehlgeschlagen ist.
+ */
+bool MySQLBackend::upsertNode(const std::string& id)
+{
+    NodeConnection& connection = connectionFor(id);
+    std::lock_guard<std::mutex> lock(connection.mutex);
+
+    if (!connection.session)
+        return false;
+
+    try
+    {
+        // Erstelle eine SQL-Anweisung zum Hinzufügen oder Aktualisieren eines Knotens
+        connection.session->execute([&](MySQLSession& session)
+            {
+                sql::PreparedStatement& addStmt = session.prepare("INSERT INTO nodes (id) VALUES (?) ON DUPLICATE KEY UPDATE id = ?");
+                addStmt.setString(1, id);
+                addStmt.setString(2, id);
+                addStmt.executeUpdate();
+            });
+
+        return true;
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& addError = sLog.key("sql_add_node", LogLevel::Error);
+        sLog.write(addError, "SQL Exception in addNode: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+    }
+
+    return false;
+}
+
+/**
+ * Entfernt einen Knoten aus der Datenbank.
+ *
+ * @param id ID des zu löschenden Knotens.
+ * @return bool Gibt false zurück, wenn das Löschen fehlgeschlagen ist.
+ */
+bool MySQLBackend::deleteNode(const std::string& id)
+{
+    NodeConnection& nodeConnection = connectionFor(id);
+    std::lock_guard<std::mutex> lock(nodeConnection.mutex);
+
+    if (!nodeConnection.session)
+        return false;
+
+    try
+    {
+        nodeConnection.session->execute([&](MySQLSession& session)
+            {
+                sql::Connection& connection = session.connection();
+
+                // Beginne eine Transaktion
+                connection.setAutoCommit(false);
+
+                try
+                {
+                    // Lösche zugehörige Daten für den Knoten
+                    sql::PreparedStatement& delNodeDataStmt = session.prepare("DELETE FROM node_data WHERE id = ?");
+                    delNodeDataStmt.setString(1, id);
+                    delNodeDataStmt.executeUpdate();
+
+                    // Lösche den Knoteneintrag selbst
+                    sql::PreparedStatement& delNodeStmt = session.prepare("DELETE FROM nodes WHERE id = ?");
+                    delNodeStmt.setString(1, id);
+                    delNodeStmt.executeUpdate();
+
+                    // Führe die Transaktion aus
+                    connection.commit();
+                }
+                catch (const sql::SQLException& e)
+                {
+                    // Bei einem Fehler, führe einen Rollback der Transaktion durch
+                    if (!MySQLSession::isConnectionLost(e))
+                    {
+                        connection.rollback();
+                        connection.setAutoCommit(true);
+                    }
+                    throw;
+                }
+
+                // Beende die Transaktion
+                connection.setAutoCommit(true);
+            });
+
+        return true;
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& deleteError = sLog.key("sql_delete_node", LogLevel::Error);
+        sLog.write(deleteError, "SQL Exception in deleteNode: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+    }
+
+    return false;
+}
+
+/**
+ * Schreibt die gesammelten Messwerte mit mehrzeiligen INSERT-Anweisungen in die Datenbank.
+ * Jeder Messwert wird an node_data_history angehängt und ersetzt den letzten Wert in node_data.
+ * Ein voller Batch wird mit einer Anweisung je Tabelle geschrieben. Ältere Messwerte, z.B. aus dem
+ * Spool, überschreiben einen neueren Wert in node_data nicht, daher ist die Reihenfolge beliebig.
+ * Sind mehrere Anweisungen nötig (z.B. bei Batch-Nachrichten), werden sie in einer Transaktion
+ * geschrieben. Wird auf dem jeweiligen Schreib-Thread mit dessen eigener Verbindung aufgerufen.
+ *
+ * @param writerIndex Index des Schreib-Threads, bestimmt die verwendete Verbindung.
+ * @param batch Die zu schreibenden Messwerte.
+ * @return AppendResult Retry, wenn die Datenbank vorübergehend nicht erreichbar ist, Dropped bei anderen Fehlern.
+ */
+AppendResult MySQLBackend::appendNodeData(size_t writerIndex, std::vector<NodeDataRecord>& batch)
+{
+    if (batch.empty())
+        return AppendResult::Committed;
+
+    // Passt der Batch in eine Anweisung je Tabelle, genügt das automatische Commit
+    const bool transaction = !m_nodeDataInsertQueries.contains(batch.size());
+
+    try
+    {
+        m_writerSessions[writerIndex]->execute([&](MySQLSession& session)
+            {
+                if (transaction)
+                    session.connection().setAutoCommit(false);
+
+                // Volle Batches mit einer Anweisung, Reste in Stücken aus den vorbereiteten Größen
+                size_t offset = 0;
+                while (offset < batch.size())
+                {
+                    size_t remaining = batch.size() - offset;
+                    auto it = m_nodeDataInsertQueries.upper_bound(remaining);
+                    size_t rows = (--it)->first;
+
+                    sql::PreparedStatement& historyStmt = session.prepare(m_nodeDataHistoryQueries.at(rows));
+                    sql::PreparedStatement& updateDataStmt = session.prepare(it->second);
+
+                    unsigned int param = 1;
+                    for (size_t i = offset; i < offset + rows; ++i, param += 8)
+                    {
+                        const NodeDataRecord& record = batch[i];
+
+                        // Als Text einmal formatieren und für beide Anweisungen verwenden, sonst als Unix-Zeit binden
+                        char buffer[DateTimeBufferSize];
+                        const char* timeStamp = nullptr;
+                        if (m_timestampMode == MySQLTimestampMode::Text)
+                        {
+                            formatLocalDateTime(record.data.timeStamp, buffer);
+                            timeStamp = buffer;
+                        }
+
+                        bindNodeDataRow(historyStmt, param, record, timeStamp);
+                        bindNodeDataRow(updateDataStmt, param, record, timeStamp);
+                    }
+
+                    historyStmt.executeUpdate();
+                    updateDataStmt.executeUpdate();
+                    offset += rows;
+                }
+
+                if (transaction)
+                {
+                    session.connection().commit();
+                    session.connection().setAutoCommit(true);
+                }
+            });
+    }
+    catch (const sql::SQLException& e)
+    {
+        if (transaction)
+        {
+            // Die Verbindung kann bereits verloren sein, dann ist die Transaktion ohnehin verworfen
+            try
+            {
+                m_writerSessions[writerIndex]->connection().rollback();
+                m_writerSessions[writerIndex]->connection().setAutoCommit(true);
+            }
+            catch (const sql::SQLException&)
+            {
+            }
+        }
+
+        // Bei einem Ausfall der Datenbank scheitert jeder Batch, die Meldungen werden daher begrenzt
+        static LogKey& batchError = sLog.key("sql_node_data_batch", LogLevel::Error);
+        sLog.write(batchError, "SQL Exception in writeNodeDataBatch: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+
+        // Andere Fehler würden bei jeder Wiederholung erneut auftreten, der Batch wird verworfen
+        return MySQLSession::isTransient(e) ? AppendResult::Retry : AppendResult::Dropped;
+    }
+
+    return AppendResult::Committed;
+}
+
+/**
+ * Aktualisiert den Status einer spezifischen Spalte für einen Knoten in der Datenbank.
+ *
+ * @param id ID des Knotens.
+ * @param column Name der zu aktualisierenden Spalte.
+ * @param status Neuer Statuswert.
+ */
+void MySQLBackend::updateNodeStatus(const std::string& id, const std::string& column, bool status)
+{
+    NodeConnection& connection = connectionFor(id);
+    std::lock_guard<std::mutex> lock(connection.mutex);
+
+    if (!connection.session)
+        return;
+
+    try
+    {
+        // Aktualisiere die Datenbank
+        connection.session->execute([&](MySQLSession& session)
+            {
+                sql::PreparedStatement& stmt = session.prepare("UPDATE nodes SET " + column + " = ? WHERE id = ?");
+                stmt.setInt(1, status);
+                stmt.setString(2, id);
+                stmt.executeUpdate();
+            });
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& statusError = sLog.key("sql_node_status", LogLevel::Error);
+        sLog.write(statusError, "SQL Exception in updateNodeStatusInDB: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+    }
+}
+
+/**
+ * Aktualisiert den Status mehrerer Knoten in der Datenbank.
+ * Die IDs werden in Blöcken zu höchstens LastSeenBatchSize mit je einer Anweisung geschrieben,
+ * die Blockgrößen sind Zweierpotenzen, damit nur wenige Anweisungen vorbereitet werden.
+ *
+ * @param ids IDs der Knoten.
+ * @param column Name der zu aktualisierenden Spalte.
+ * @param status Neuer Statuswert.
+ */
+void MySQLBackend::updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status)
+{
+    std::lock_guard<std::mutex> lock(m_connectionMutex);
+
+    if (!m_session || ids.empty())
+        return;
+
+    try
+    {
+        m_session->execute([&](MySQLSession& session)
+            {
+                size_t offset = 0;
+                while (offset < ids.size())
+                {
+                    size_t rows = std::bit_floor(std::min(ids.size() - offset, LastSeenBatchSize));
+
+                    std::string query = "UPDATE nodes SET " + column + " = ? WHERE id IN (";
+                    for (size_t i = 0; i < rows; ++i)
+                        query += (i == 0) ? "?" : ", ?";
+                    query += ")";
+
+                    sql::PreparedStatement& stmt = session.prepare(query);
+                    stmt.setInt(1, status);
+                    for (size_t i = 0; i < rows; ++i)
+                        stmt.setString(static_cast<unsigned int>(i + 2), sql::SQLString(ids[offset + i].data(), ids[offset + i].size()));
+
+                    stmt.executeUpdate();
+                    offset += rows;
+                }
+            });
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& statusError = sLog.key("sql_nodes_status", LogLevel::Error);
+        sLog.write(statusError, "SQL Exception in updateNodesStatusInDB: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+    }
+}
+
+/**
+ * Aktualisiert den Status aller Knoten in der Datenbank mit einer einzigen Anweisung.
+ * Die Dauer hängt nicht von der Anzahl der Knoten ab, sondern nur von den tatsächlich geänderten Zeilen.
+ *
+ * @param column Name der zu aktualisierenden Spalte.
+ * @param status Neuer Statuswert.
+ */
+void MySQLBackend::updateAllNodesStatus(const std::string& column, bool status)
+{
+    std::lock_guard<std::mutex> lock(m_connectionMutex);
+
+    if (!m_session)
+        return;
+
+    try
+    {
+        m_session->execute([&](MySQLSession& session)
+            {
+                sql::PreparedStatement& stmt = session.prepare("UPDATE nodes SET " + column + " = ? WHERE " + column + " <> ?");
+                stmt.setInt(1, status);
+                stmt.setInt(2, status);
+                stmt.executeUpdate();
+            });
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& statusError = sLog.key("sql_all_nodes_status", LogLevel::Error);
+        sLog.write(statusError, "SQL Exception in updateAllNodesStatusInDB: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+    }
+}
+
+/**
+ * Liest die Audit-Tabelle, in der die Webseite Änderungen der Freigabe hinterlegt, und löscht die gelesenen Einträge.
+ *
+ * @param entries Erhält die Einträge in der Reihenfolge der Tabelle.
+ * @return bool Gibt false zurück, wenn die Tabelle nicht gelesen werden konnte.
+ */
+bool MySQLBackend::fetchAudit(std::vector<AuditEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_connectionMutex);
+
+    if (!m_session)
+        return false;
+
+    try
+    {
+        m_session->execute([&](MySQLSession& session)
+            {
+                entries.clear();
+                std::unique_ptr<sql::ResultSet> result(session.prepare("SELECT * FROM audit").executeQuery());
+
+                while (result->next())
+                    entries.push_back(AuditEntry{ result->getString("node_id"), result->getBoolean("allowed_value") });
+
+                for (const AuditEntry& entry : entries)
+                {
+                    // Lösche den Eintrag aus der audit-Tabelle
+                    sql::PreparedStatement& deleteStmt = session.prepare("DELETE FROM audit WHERE node_id = ?");
+                    deleteStmt.setString(1, entry.nodeId);
+                    deleteStmt.executeUpdate();
+                }
+            });
+
+        return true;
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& auditError = sLog.key("sql_audit", LogLevel::Error);
+        sLog.write(auditError, "SQL Exception in fetchAudit: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+        return false;
+    }
+}
+
+/**
+ * Lädt alle Knoten aus der Datenbank und speichert sie in der Registry.
+ *
+ * Die Knoten werden in Blöcken von FetchChunkSize Zeilen geladen (fortlaufend nach id), sodass nie
+ * die ganze Tabelle im Speicher des Clients liegt. Alle Knoten starten offline, die Datenbank wird
+ * danach mit einer einzigen UPDATE-Anweisung angeglichen statt mit einer Anweisung pro Knoten.
+ *
+ * @param registry Die Registry, in die die Knoten geladen werden.
+ * @return bool Gibt true zurück, wenn das Laden erfolgreich war, andernfalls false.
+ */
+bool MySQLBackend::loadNodes(NodeRegistry& registry)
+{
+    std::lock_guard<std::mutex> lock(m_connectionMutex);
+
+    if (!m_session)
+        return false;
+
+    try
+    {
+        m_session->execute([&](MySQLSession& session)
+            {
+                // Löscht den aktuellen Audit-Verlauf
+                session.prepare("DELETE FROM audit").executeUpdate();
+
+                // Knoten blockweise laden, lastSeen wird als Unix-Zeit gelesen
+                sql::PreparedStatement& firstStmt = session.prepare("SELECT id, allowed, UNIX_TIMESTAMP(lastSeen) AS lastSeen FROM nodes ORDER BY id LIMIT ?");
+                sql::PreparedStatement& nextStmt = session.prepare("SELECT id, allowed, UNIX_TIMESTAMP(lastSeen) AS lastSeen FROM nodes WHERE id > ? ORDER BY id LIMIT ?");
+
+                size_t loaded = 0;
+                std::string lastId;
+
+                while (true)
+                {
+                    std::unique_ptr<sql::ResultSet> result;
+                    if (loaded == 0)
+                    {
+                        firstStmt.setUInt(1, FetchChunkSize);
+                        result.reset(firstStmt.executeQuery());
+                    }
+                    else
+                    {
+                        nextStmt.setString(1, lastId);
+                        nextStmt.setUInt(2, FetchChunkSize);
+                        result.reset(nextStmt.executeQuery());
+                    }
+
+                    size_t rows = 0;
+                    while (result->next())
+                    {
+                        lastId = result->getString("id");
+                        registry.load(lastId, result->getBoolean("allowed"), static_cast<time_t>(result->getInt64("lastSeen")));
+                        ++rows;
+                    }
+
+                    loaded += rows;
+                    if (rows < FetchChunkSize)
+                        break;
+                }
+
+                // Setzt den Online-Status aller Knoten mit einer Anweisung auf false
+                int reset = session.prepare("UPDATE nodes SET online = 0 WHERE online <> 0").executeUpdate();
+
+                std::cout << "Loaded " << loaded << " Nodes, " << reset << " set Offline" << std::endl;
+            });
+
+        return true;
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& loadError = sLog.key("sql_load_nodes", LogLevel::Error);
+        sLog.write(loadError, "SQL Exception in loadNodes: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+        return false;
+    }
+}
+
+/**
+ * Schreibt die "lastSeen"-Daten mehrerer Knoten in die Datenbank.
+ * Es wird eine UPDATE-Anweisung je bis zu LastSeenBatchSize Knoten ausgeführt.
+ *
+ * @param entries Die geänderten Knoten mit ihrem lastSeen.
+ * @return bool Gibt false zurück, wenn das Schreiben fehlgeschlagen ist.
+ */
+bool MySQLBackend::updateLastSeen(const std::vector<LastSeenEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_connectionMutex);
+
+    if (!m_session)
+        return false;
+
+    try
+    {
+        m_session->execute([&](MySQLSession& session)
+            {
+                size_t offset = 0;
+                while (offset < entries.size())
+                {
+                    size_t remaining = entries.size() - offset;
+                    auto it = m_lastSeenUpdateQueries.upper_bound(remaining);
+                    size_t rows = (--it)->first;
+
+                    sql::PreparedStatement& updateStmt = session.prepare(it->second);
+
+                    // Erst die Paare für CASE, danach die IDs für die WHERE-Bedingung
+                    unsigned int param = 1;
+                    for (size_t i = offset; i < offset + rows; ++i)
+                    {
+                        updateStmt.setString(param++, sql::SQLString(entries[i].id.data(), entries[i].id.size()));
+
+                        // Konvertiere time_t in ein timestamp-Format für die Datenbank
+                        if (m_timestampMode == MySQLTimestampMode::Text)
+                        {
+                            char buffer[DateTimeBufferSize];
+                            formatLocalDateTime(entries[i].lastSeen, buffer);
+                            updateStmt.setString(param++, buffer);
+                        }
+                        else
+                            updateStmt.setInt64(param++, entries[i].lastSeen);
+                    }
+
+                    for (size_t i = offset; i < offset + rows; ++i)
+                        updateStmt.setString(param++, sql::SQLString(entries[i].id.data(), entries[i].id.size()));
+
+                    updateStmt.executeUpdate();
+                    offset += rows;
+                }
+            });
+
+        return true;
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& lastSeenError = sLog.key("sql_last_seen", LogLevel::Error);
+        sLog.write(lastSeenError, "SQL Exception in updateLastSeen: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+        return false;
+    }
+}
+
+/**
+ * Wartung der Historientabelle node_data_history.
+ *
+ * Die Tabelle ist nach Tagen partitioniert (RANGE über TO_DAYS(timestamp)) und besitzt eine
+ * Partition pmax für Zeitstempel in der Zukunft. Der Aufruf legt die Tabelle bei Bedarf an,
+ * teilt die Partitionen für die nächsten partitionsAhead Tage aus pmax ab und löscht
+ * Tagespartitionen, die älter als retentionDays sind. Das Löschen einer Partition ist
+ * unabhängig von der Anzahl der enthaltenen Zeilen günstig.
+ *
+ * @param config Aufbewahrungsdauer und Anzahl der im Voraus angelegten Partitionen.
+ */
+void MySQLBackend::maintainHistory(NodeHistoryConfig const& config)
+{
+    std::lock_guard<std::mutex> lock(m_connectionMutex);
+
+    if (!m_session)
+        return;
+
+    std::chrono::sys_days today = localDay(std::time(nullptr));
+
+    try
+    {
+        m_session->execute([&](MySQLSession& session)
+            {
+                std::unique_ptr<sql::Statement> stmt(session.connection().createStatement());
+
+                stmt->execute(
+                    "CREATE TABLE IF NOT EXISTS node_data_history ("
+                    "id VARCHAR(64) NOT NULL, "
+                    "timestamp DATETIME NOT NULL, "
+                    "temperature FLOAT, "
+                    "pressure INT UNSIGNED, "
+                    "altitude FLOAT, "
+                    "humidity INT UNSIGNED, "
+                    "lux INT UNSIGNED, "
+                    "sound SMALLINT UNSIGNED, "
+                    "PRIMARY KEY (id, timestamp)"
+                    ") ENGINE=InnoDB "
+                    "PARTITION BY RANGE (TO_DAYS(timestamp)) (" + partitionDefinition(today) + ", PARTITION pmax VALUES LESS THAN MAXVALUE)");
+
+                // Vorhandene Tagespartitionen ermitteln
+                std::vector<std::chrono::sys_days> days;
+                std::unique_ptr<sql::ResultSet> result(stmt->executeQuery(
+                    "SELECT PARTITION_NAME FROM INFORMATION_SCHEMA.PARTITIONS "
+                    "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = 'node_data_history'"));
+
+                while (result->next())
+                {
+                    std::chrono::sys_days day;
+                    if (parsePartitionDay(result->getString("PARTITION_NAME"), day))
+                        days.push_back(day);
+                }
+
+                std::sort(days.begin(), days.end());
+
+                // Fehlende künftige Partitionen aus pmax abteilen, pmax ist dabei in der Regel leer
+                std::chrono::sys_days next = days.empty() ? today : days.back() + std::chrono::days{ 1 };
+                std::chrono::sys_days last = today + std::chrono::days{ config.partitionsAhead };
+
+                if (next <= last)
+                {
+                    std::string query = "ALTER TABLE node_data_history REORGANIZE PARTITION pmax INTO (";
+                    for (std::chrono::sys_days day = next; day <= last; day += std::chrono::days{ 1 })
+                        query += partitionDefinition(day) + ", ";
+                    query += "PARTITION pmax VALUES LESS THAN MAXVALUE)";
+
+                    stmt->execute(query);
+                }
+
+                // Abgelaufene Partitionen löschen
+                std::chrono::sys_days oldest = today - std::chrono::days{ config.retentionDays };
+                std::string dropList;
+                for (std::chrono::sys_days day : days)
+                {
+                    if (day < oldest)
+                        dropList += (dropList.empty() ? "" : ", ") + formatDay(day, "p%04d%02u%02u");
+                }
+
+                if (!dropList.empty())
+                    stmt->execute("ALTER TABLE node_data_history DROP PARTITION " + dropList);
+            });
+    }
+    catch (const sql::SQLException& e)
+    {
+        static LogKey& historyError = sLog.key("sql_history", LogLevel::Error);
+        sLog.write(historyError, "SQL Exception in maintainNodeDataHistory: ", e.what(), " (Error Code: ", e.getErrorCode(), ", SQL State: ", e.getSQLState(), ")");
+    }
+}
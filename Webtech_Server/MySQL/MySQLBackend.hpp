@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+// Einbinden der benötigten MySQL-Bibliotheken
+#include <mysql_driver.h>
+#include <cppconn/resultset.h>
+#include <cppconn/statement.h>
+#include <mysql_connection.h>
+#include <mysql_error.h>
+#include <cppconn/prepared_statement.h>
+#include <cppconn/exception.h>
+
+#include "MySQLSession.hpp"
+#include "../Storage/StorageBackend.hpp"
+
+#include <map>
+
+/**
+ * Struktur zur Speicherung von MySQL-Verbindungsinformationen.
+ */
+struct MySQLConnectionInfo
+{
+    explicit MySQLConnectionInfo(std::string const& infoString);
+
+    std::string user;
+    std::string password;
+    std::string database;
+    std::string host;
+};
+
+/**
+ * Übergabe der Zeitstempel an MySQL, die Spalten bleiben in beiden Fällen DATETIME.
+ */
+enum class MySQLTimestampMode
+{
+    Text,       ///< Lokal formatiert als "YYYY-MM-DD HH:MM:SS", der Server parst den Text.
+    Epoch       ///< Als Unix-Zeit, umgewandelt mit FROM_UNIXTIME() in der Zeitzone der Sitzung, passend zu UNIX_TIMESTAMP() in loadNodes().
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Speicherung in MySQL, die Datenbank wird auch von der Webseite gelesen.
+ *
+ * Statusänderungen laufen über eine Reihe von Verbindungen, die nach der ID des Knotens gewählt
+ * werden, sodass Knoten mit verschiedenen Verbindungen parallel geschrieben werden können.
+ * Audit-Tabelle, Startup und Wartung verwenden eine eigene Verbindung, jeder Schreib-Thread
+ * des NodeDataWriter ebenfalls.
+ *
+ * Messwerte werden sowohl in node_data (nur der letzte Wert je Knoten) als auch in die nach Tagen
+ * partitionierte Tabelle node_data_history geschrieben. Alte Historie wird durch das Löschen
+ * ganzer Partitionen entfernt, siehe maintainHistory().
+ */
+class MySQLBackend : public StorageBackend
+{
+public:
+    explicit MySQLBackend(MySQLConnectionInfo const& connectionInfo, size_t connectionCount = DefaultNodeShardCount,
+        MySQLTimestampMode timestampMode = MySQLTimestampMode::Text);
+    ~MySQLBackend() override;
+
+    MySQLBackend(MySQLBackend const&) = delete;
+    void operator=(MySQLBackend const&) = delete;
+
+    const char* name() const override { return "mysql"; }
+
+    bool open() override;
+    bool openWriters(size_t writerCount, size_t batchSize) override;
+    void closeWriters() override;
+
+    bool loadNodes(NodeRegistry& registry) override;
+    bool upsertNode(const std::string& id) override;
+    bool deleteNode(const std::string& id) override;
+
+    void updateNodeStatus(const std::string& id, const std::string& column, bool status) override;
+    void updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status) override;
+    void updateAllNodesStatus(const std::string& column, bool status) override;
+    bool updateLastSeen(const std::vector<LastSeenEntry>& entries) override;
+
+    AppendResult appendNodeData(size_t writerIndex, std::vector<NodeDataRecord>& batch) override;
+    bool fetchAudit(std::vector<AuditEntry>& entries) override;
+    void maintainHistory(NodeHistoryConfig const& config) override;
+
+private:
+    /**
+     * Eine Verbindung für die Statusänderungen der Knoten, deren ID ihr zugeordnet ist.
+     */
+    struct NodeConnection
+    {
+        std::mutex mutex;                               ///< Serialisiert die Zugriffe auf die Verbindung.
+        std::unique_ptr<MySQLSession> session;          ///< Verbindung, nullptr solange open() nicht aufgerufen wurde.
+    };
+
+    /* Baut eine neue Verbindung mit den hinterlegten Verbindungsinformationen auf */
+    sql::Connection* openConnection();
+
+    /* Legt eine neue Session an und baut ihre Verbindung auf */
+    std::unique_ptr<MySQLSession> openSession();
+
+    /* Verbindung für die Statusänderungen des Knotens mit der gegebenen ID */
+    NodeConnection& connectionFor(std::string_view id) { return *m_nodeConnections[std::hash<std::string_view>{}(id) % m_nodeConnections.size()]; }
+
+    /* Platzhalter für einen Zeitstempel in den Anweisungen, passend zu m_timestampMode */
+    const char* timestampPlaceholder() const { return m_timestampMode == MySQLTimestampMode::Epoch ? "FROM_UNIXTIME(?)" : "?"; }
+
+    /* Maximale Anzahl an Knoten, deren lastSeen oder Status mit einer Anweisung geschrieben wird */
+    static constexpr size_t LastSeenBatchSize = 256;
+
+    /* Maximale Anzahl an Messwerten je INSERT-Anweisung, MySQL erlaubt höchstens 65535 Platzhalter bei 8 je Messwert */
+    static constexpr size_t MaxNodeDataRows = 65535 / 8;
+
+    /* Anzahl der Knoten, die beim Start pro Abfrage geladen werden */
+    static constexpr unsigned int FetchChunkSize = 10000;
+
+    MySQLConnectionInfo m_connectionInfo;
+    MySQLTimestampMode m_timestampMode;
+    sql::mysql::MySQL_Driver* driver_ = nullptr;
+
+    std::vector<std::unique_ptr<NodeConnection>> m_nodeConnections;
+    std::mutex m_connectionMutex;   ///< Schützt m_session, die für Audit-Tabelle, Startup und Wartung verwendet wird.
+    std::unique_ptr<MySQLSession> m_session;
+
+    // Eigene Verbindungen für die Schreib-Threads, da sql::Connection nicht threadsicher ist
+    std::vector<std::unique_ptr<MySQLSession>> m_writerSessions;
+    std::map<size_t, std::string> m_nodeDataInsertQueries;     ///< Wird in openWriters() befüllt und danach nur gelesen.
+    std::map<size_t, std::string> m_nodeDataHistoryQueries;    ///< Gleiche Zeilenanzahlen wie m_nodeDataInsertQueries.
+    std::map<size_t, std::string> m_lastSeenUpdateQueries;     ///< Wird im Konstruktor befüllt und danach nur gelesen.
+};
@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "MySQLSession.hpp"
+
+/**
+ * Konstruktor für die MySQLSession. Die Verbindung wird erst mit open() aufgebaut.
+ *
+ * @param factory Funktion, die eine neue Verbindung aufbaut.
+ */
+MySQLSession::MySQLSession(ConnectionFactory factory) :
+    m_factory(std::move(factory))
+{
+}
+
+/**
+ * Destruktor, gibt die Anweisungen vor der Verbindung frei.
+ */
+MySQLSession::~MySQLSession()
+{
+    close();
+}
+
+/**
+ * Baut die Verbindung auf. Eine bestehende Verbindung wird vorher geschlossen.
+ */
+void MySQLSession::open()
+{
+    close();
+    m_connection.reset(m_factory());
+}
+
+/**
+ * Gibt alle vorbereiteten Anweisungen frei und schließt die Verbindung.
+ */
+void MySQLSession::close()
+{
+    m_statements.clear();
+    m_connection.reset();
+}
+
+/**
+ * Gibt die vorbereitete Anweisung für den gegebenen Text zurück.
+ * Beim ersten Aufruf pro Verbindung wird die Anweisung auf dem Server vorbereitet.
+ *
+ * @param query Text der SQL-Anweisung.
+ * @return sql::PreparedStatement& Die Anweisung, sie gehört weiterhin der Session.
+ */
+sql::PreparedStatement& MySQLSession::prepare(const std::string& query)
+{
+    auto it = m_statements.find(query);
+    if (it != m_statements.end())
+        return *it->second;
+
+    std::unique_ptr<sql::PreparedStatement> statement(connection().prepareStatement(query));
+    return *m_statements.emplace(query, std::move(statement)).first->second;
+}
+
+/**
+ * Zugriff auf die Verbindung. Besteht keine Verbindung, wird sie aufgebaut.
+ *
+ * @return sql::Connection& Die aktuelle Verbindung.
+ */
+sql::Connection& MySQLSession::connection()
+{
+    if (!m_connection)
+        open();
+
+    return *m_connection;
+}
+
+/**
+ * Baut die Verbindung neu auf. Die Anweisungen der alten Verbindung werden verworfen
+ * und beim nächsten prepare() neu vorbereitet.
+ */
+void MySQLSession::reconnect()
+{
+    std::cerr << "MySQL connection lost, reconnecting..." << std::endl;
+    open();
+}
+
+/**
+ * Prüft, ob eine Ausnahme durch eine verlorene Verbindung ausgelöst wurde.
+ *
+ * @param e Die aufgetretene Ausnahme.
+ * @return bool Gibt true zurück bei "server has gone away", "lost connection" oder Verbindungs-Timeout.
+ */
+bool MySQLSession::isConnectionLost(const sql::SQLException& e)
+{
+    switch (e.getErrorCode())
+    {
+        case 2006: // CR_SERVER_GONE_ERROR
+        case 2013: // CR_SERVER_LOST
+        case 2055: // CR_SERVER_LOST_EXTENDED
+        case 4031: // ER_CLIENT_INTERACTION_TIMEOUT
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Prüft, ob eine Ausnahme auf einen vorübergehenden Fehler hinweist, z.B. während einer Wartung der Datenbank.
+ *
+ * @param e Die aufgetretene Ausnahme.
+ * @return bool Gibt true zurück bei verlorener oder nicht aufbaubarer Verbindung, Überlast oder Sperrkonflikten.
+ */
+bool MySQLSession::isTransient(const sql::SQLException& e)
+{
+    if (isConnectionLost(e))
+        return true;
+
+    switch (e.getErrorCode())
+    {
+        case 1040: // ER_CON_COUNT_ERROR
+        case 1053: // ER_SERVER_SHUTDOWN
+        case 1205: // ER_LOCK_WAIT_TIMEOUT
+        case 1213: // ER_LOCK_DEADLOCK
+        case 2002: // CR_CONNECTION_ERROR
+        case 2003: // CR_CONN_HOST_ERROR
+            return true;
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+// Einbinden der benötigten MySQL-Bibliotheken
+#include <mysql_connection.h>
+#include <cppconn/resultset.h>
+#include <cppconn/prepared_statement.h>
+#include <cppconn/exception.h>
+
+#include <functional>
+#include <unordered_map>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Eine einzelne Datenbankverbindung mit Cache für vorbereitete Anweisungen.
+ *
+ * Jede unterschiedliche Anweisung wird pro Verbindung nur einmal vorbereitet und danach mit
+ * neu gebundenen Parametern wiederverwendet. Die Anweisungen gehören dem Cache und werden
+ * beim Zerstören oder Neuverbinden automatisch freigegeben.
+ *
+ * Geht die Verbindung verloren, baut execute() sie neu auf, verwirft die alten Anweisungen und
+ * wiederholt den Aufruf einmal. Die Anweisungen werden dabei transparent neu vorbereitet.
+ *
+ * Eine Session ist nicht threadsicher, der Aufrufer muss die Zugriffe serialisieren.
+ */
+class MySQLSession
+{
+public:
+    /* Funktion, die eine neue Verbindung aufbaut. Die Session übernimmt den Besitz */
+    using ConnectionFactory = std::function<sql::Connection*()>;
+
+    explicit MySQLSession(ConnectionFactory factory);
+    ~MySQLSession();
+
+    MySQLSession(MySQLSession const&) = delete;
+    void operator=(MySQLSession const&) = delete;
+
+    /* Baut die Verbindung auf, wirft sql::SQLException bei einem Fehler */
+    void open();
+
+    /* Gibt alle Anweisungen frei und schließt die Verbindung */
+    void close();
+
+    /* Gibt die vorbereitete Anweisung für den Text zurück, bereitet sie beim ersten Aufruf vor */
+    sql::PreparedStatement& prepare(const std::string& query);
+
+    /* Zugriff auf die Verbindung, z.B. für Transaktionen */
+    sql::Connection& connection();
+
+    /* Führt die Funktion aus und wiederholt sie einmal nach einem Neuverbinden, wenn die Verbindung verloren ging */
+    template<typename Func>
+    void execute(Func&& func)
+    {
+        try
+        {
+            func(*this);
+        }
+        catch (const sql::SQLException& e)
+        {
+            if (!isConnectionLost(e))
+                throw;
+
+            reconnect();
+            func(*this);
+        }
+    }
+
+    /* Gibt True zurück wenn der Fehler auf eine verlorene Verbindung hinweist */
+    static bool isConnectionLost(const sql::SQLException& e);
+
+    /* Gibt True zurück wenn ein späterer Versuch Erfolg haben kann (Verbindung, Überlast, Sperren) */
+    static bool isTransient(const sql::SQLException& e);
+
+private:
+    void reconnect();
+
+    ConnectionFactory m_factory;
+    std::unique_ptr<sql::Connection> m_connection;
+    std::unordered_map<std::string, std::unique_ptr<sql::PreparedStatement>> m_statements;    ///< Wird vor der Verbindung freigegeben.
+};
@@ -0,0 +1,330 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "NodeDataWriter.hpp"
+#include "TelemetrySpool.hpp"
+#include "../Logging/Logger.hpp"
+
+/**
+ * Konstruktor für den NodeDataWriter.
+ *
+ * @param config Einstellungen für Anzahl der Threads, Warteschlangengröße und Schwellwerte.
+ * @param handler Funktion, die die gesammelten Messwerte schreibt.
+ */
+NodeDataWriter::NodeDataWriter(NodeDataWriterConfig const& config, BatchHandler handler) :
+    m_config(config),
+    m_handler(std::move(handler))
+{
+    m_config.workerCount = std::max<size_t>(m_config.workerCount, 1);
+    m_config.batchSize = std::max<size_t>(m_config.batchSize, 1);
+    m_laneCapacity = std::max<size_t>(m_config.queueCapacity / m_config.workerCount, 1);
+    m_laneHighWater = std::clamp<size_t>(m_config.spoolHighWater / m_config.workerCount, 1, m_laneCapacity);
+
+    for (size_t i = 0; i < m_config.workerCount; ++i)
+        m_lanes.push_back(std::make_unique<Lane>());
+}
+
+/**
+ * Destruktor, stellt sicher, dass alle Schreib-Threads beendet sind.
+ */
+NodeDataWriter::~NodeDataWriter()
+{
+    stop();
+}
+
+/**
+ * Startet die Schreib-Threads.
+ * Ist ein Spool konfiguriert, wird er geöffnet und der Thread zum Übertragen des Spools gestartet.
+ * Messwerte, die beim letzten Lauf im Spool verblieben sind, werden dabei ebenfalls übertragen.
+ */
+void NodeDataWriter::start()
+{
+    if (!m_workers.empty())
+        return;
+
+    m_stopping = false;
+
+    if (!m_config.spoolDirectory.empty() && !m_spool)
+    {
+        m_spool = std::make_unique<TelemetrySpool>(m_config.spoolDirectory, m_config.spoolSegmentSize);
+        if (!m_spool->open())
+        {
+            static LogKey& spoolUnavailable = sLog.key("spool_error", LogLevel::Error);
+            sLog.write(spoolUnavailable, "Error: Telemetry spool could not be opened, continuing without spool");
+            m_spool.reset();
+        }
+    }
+
+    if (m_spool)
+    {
+        m_spoolActive = !m_spool->empty();
+        m_replayThread = std::thread(&NodeDataWriter::replayLoop, this);
+    }
+
+    for (size_t i = 0; i < m_lanes.size(); ++i)
+        m_workers.emplace_back(&NodeDataWriter::workerLoop, this, i);
+}
+
+/**
+ * Beendet die Schreib-Threads. Bereits eingereihte Messwerte werden vorher noch geschrieben.
+ * Messwerte im Spool bleiben dort und werden beim nächsten start() übertragen.
+ */
+void NodeDataWriter::stop()
+{
+    m_stopping = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_replayMutex);
+        m_replayWakeup.notify_all();
+    }
+
+    for (auto& lane : m_lanes)
+    {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        lane->notEmpty.notify_all();
+        lane->notFull.notify_all();
+    }
+
+    for (auto& worker : m_workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    m_workers.clear();
+
+    if (m_replayThread.joinable())
+        m_replayThread.join();
+
+    if (m_spool)
+    {
+        m_spool->close();
+        m_spool.reset();
+    }
+}
+
+/**
+ * Reiht einen Messwert zum Schreiben ein.
+ * Ist ein Spool vorhanden, wird der Messwert dort abgelegt, solange der Spool nicht leer ist oder die
+ * Warteschlange spoolHighWater erreicht hat. Ohne Spool blockiert der Aufruf bei voller Warteschlange,
+ * bis wieder Platz frei ist.
+ *
+ * @param record Der einzureihende Messwert.
+ * @return bool Gibt false zurück, wenn der Writer bereits beendet wird.
+ */
+bool NodeDataWriter::enqueue(NodeDataRecord&& record)
+{
+    Lane& lane = *m_lanes[record.node % m_lanes.size()];
+    record.queuedAt = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(lane.mutex);
+
+    if (m_spool && !m_stopping && (m_spoolActive || lane.queue.size() >= m_laneHighWater))
+    {
+        lock.unlock();
+
+        if (m_spool->append(record))
+        {
+            m_spoolActive = true;
+            m_replayWakeup.notify_one();
+            return true;
+        }
+
+        // Spool nicht beschreibbar (z.B. Platte voll), wie ohne Spool einreihen
+        lock.lock();
+    }
+
+    lane.notFull.wait(lock, [&] { return m_stopping || lane.queue.size() < m_laneCapacity; });
+
+    if (m_stopping)
+        return false;
+
+    lane.queue.push_back(std::move(record));
+
+    if (lane.queue.size() == 1 || lane.queue.size() >= m_config.batchSize)
+        lane.notEmpty.notify_one();
+
+    return true;
+}
+
+/**
+ * Reiht mehrere Messwerte desselben Knotens zum Schreiben ein, z.B. aus einer Batch-Nachricht.
+ * Die Messwerte landen zusammenhängend in derselben Warteschlange und werden immer gemeinsam in
+ * einem Aufruf des BatchHandlers geschrieben, auch wenn dieser dadurch mehr als batchSize
+ * Messwerte erhält. Für den Spool gelten dieselben Regeln wie beim einzelnen enqueue().
+ *
+ * @param records Die einzureihenden Messwerte, alle mit demselben Handle.
+ * @return bool Gibt false zurück, wenn der Writer bereits beendet wird.
+ */
+bool NodeDataWriter::enqueue(std::vector<NodeDataRecord>&& records)
+{
+    if (records.empty())
+        return true;
+
+    Lane& lane = *m_lanes[records.front().node % m_lanes.size()];
+
+    auto now = std::chrono::steady_clock::now();
+    for (NodeDataRecord& record : records)
+    {
+        record.queuedAt = now;
+        record.batchContinued = true;
+    }
+    records.back().batchContinued = false;
+
+    std::unique_lock<std::mutex> lock(lane.mutex);
+
+    if (m_spool && !m_stopping && (m_spoolActive || lane.queue.size() >= m_laneHighWater))
+    {
+        lock.unlock();
+
+        if (m_spool->append(records))
+        {
+            m_spoolActive = true;
+            m_replayWakeup.notify_one();
+            return true;
+        }
+
+        lock.lock();
+    }
+
+    // Ein Batch größer als die Warteschlange wird eingereiht, sobald sie leer ist
+    lane.notFull.wait(lock, [&] { return m_stopping || lane.queue.empty() || lane.queue.size() + records.size() <= m_laneCapacity; });
+
+    if (m_stopping)
+        return false;
+
+    std::move(records.begin(), records.end(), std::back_inserter(lane.queue));
+    lane.notEmpty.notify_one();
+
+    return true;
+}
+
+/**
+ * Gibt die Anzahl der aktuell wartenden Messwerte zurück.
+ *
+ * @return size_t Summe über alle Warteschlangen.
+ */
+size_t NodeDataWriter::queueDepth() const
+{
+    size_t depth = 0;
+    for (auto const& lane : m_lanes)
+    {
+        std::lock_guard<std::mutex> lock(lane->mutex);
+        depth += lane->queue.size();
+    }
+    return depth;
+}
+
+/**
+ * Hauptschleife eines Schreib-Threads.
+ * Wartet, bis batchSize Messwerte gesammelt sind oder der älteste Messwert maxBatchAge erreicht hat,
+ * und übergibt die Messwerte dann gesammelt an den BatchHandler.
+ *
+ * @param workerIndex Index des Schreib-Threads und seiner Warteschlange.
+ */
+void NodeDataWriter::workerLoop(size_t workerIndex)
+{
+    Lane& lane = *m_lanes[workerIndex];
+    std::vector<NodeDataRecord> batch;
+    batch.reserve(m_config.batchSize);
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(lane.mutex);
+            lane.notEmpty.wait(lock, [&] { return m_stopping || !lane.queue.empty(); });
+
+            if (lane.queue.empty())
+                break;
+
+            // Warte bis der Batch voll oder der älteste Messwert alt genug ist
+            auto deadline = lane.queue.front().queuedAt + m_config.maxBatchAge;
+            lane.notEmpty.wait_until(lock, deadline, [&] { return m_stopping || lane.queue.size() >= m_config.batchSize; });
+
+            // Messwerte aus derselben Batch-Nachricht werden nicht auf mehrere Batches verteilt
+            size_t count = std::min(lane.queue.size(), m_config.batchSize);
+            while (count < lane.queue.size() && lane.queue[count - 1].batchContinued)
+                ++count;
+            std::move(lane.queue.begin(), lane.queue.begin() + count, std::back_inserter(batch));
+            lane.queue.erase(lane.queue.begin(), lane.queue.begin() + count);
+        }
+
+        lane.notFull.notify_all();
+
+        // Bei einem vorübergehenden Fehler den Batch im Spool ablegen, bis die Datenbank wieder erreichbar ist
+        if (!m_handler(workerIndex, batch) && !spill(batch))
+        {
+            static LogKey& dropped = sLog.key("node_data_dropped", LogLevel::Error);
+            sLog.write(dropped, "Error: Dropped ", batch.size(), " node data records");
+        }
+
+        batch.clear();
+    }
+}
+
+/**
+ * Legt einen nicht geschriebenen Batch im Spool ab und leitet neue Messwerte in den Spool um.
+ *
+ * @param batch Der Batch, der nicht geschrieben werden konnte.
+ * @return bool Gibt false zurück, wenn kein Spool vorhanden ist oder er nicht beschrieben werden konnte.
+ */
+bool NodeDataWriter::spill(std::vector<NodeDataRecord> const& batch)
+{
+    if (!m_spool || !m_spool->append(batch))
+        return false;
+
+    m_spoolActive = true;
+    m_replayWakeup.notify_one();
+    return true;
+}
+
+/**
+ * Hauptschleife des Threads, der den Spool überträgt.
+ * Liest jeweils bis zu batchSize Messwerte ab dem Checkpoint und übergibt sie an den BatchHandler.
+ * Der Checkpoint wird erst nach erfolgreichem Schreiben weitergesetzt. Schlägt das Schreiben fehl,
+ * wird nach spoolRetryInterval erneut versucht. Ist der Spool leer, gehen neue Messwerte wieder
+ * direkt in die Warteschlangen.
+ *
+ * Zwischen den Batches werden neu angehängte Messwerte alle spoolSyncInterval auf die Platte
+ * geschrieben, während die Datenbank nicht erreichbar ist, mit jedem erneuten Versuch. Der Thread ist der einzige, der commit() aufruft, sync() läuft daher nie parallel dazu.
+ */
+void NodeDataWriter::replayLoop()
+{
+    size_t replayIndex = m_config.workerCount;
+    std::vector<NodeDataRecord> batch;
+    batch.reserve(m_config.batchSize);
+
+    auto nextSync = std::chrono::steady_clock::now() + m_config.spoolSyncInterval;
+
+    while (!m_stopping)
+    {
+        if (std::chrono::steady_clock::now() >= nextSync)
+        {
+            m_spool->sync();
+            nextSync = std::chrono::steady_clock::now() + m_config.spoolSyncInterval;
+        }
+
+        if (m_spool->empty())
+        {
+            m_spoolActive = false;
+
+            std::unique_lock<std::mutex> lock(m_replayMutex);
+            m_replayWakeup.wait_for(lock, m_config.spoolRetryInterval, [&] { return m_stopping || m_spoolActive; });
+            continue;
+        }
+
+        batch.clear();
+        SpoolPosition next = m_spool->read(batch, m_config.batchSize);
+
+        if (m_handler(replayIndex, batch))
+        {
+            m_spool->commit(next);
+            continue;
+        }
+
+        // Datenbank weiterhin nicht erreichbar, später erneut versuchen
+        std::unique_lock<std::mutex> lock(m_replayMutex);
+        m_replayWakeup.wait_for(lock, m_config.spoolRetryInterval, [&] { return m_stopping.load(); });
+    }
+}
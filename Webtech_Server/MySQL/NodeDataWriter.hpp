@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "NodeRegistry.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+
+class TelemetrySpool;
+
+/**
+ * Ein einzelner Messwert, der darauf wartet, in die Datenbank geschrieben zu werden.
+ */
+struct NodeDataRecord
+{
+    NodeHandle node;                                  ///< Handle des Knotens, von dem der Messwert stammt.
+    std::string_view id;                              ///< ID des Knotens, verweist auf die unveränderliche ID in der NodeRegistry.
+    NodeData data;                                    ///< Der eigentliche Messwert.
+    std::chrono::steady_clock::time_point queuedAt{}; ///< Zeitpunkt, an dem der Messwert eingereiht wurde.
+    bool batchContinued = false;                      ///< Der nächste Messwert stammt aus derselben Nachricht und wird im selben Batch geschrieben.
+};
+
+/**
+ * Einstellungen für den NodeDataWriter.
+ */
+struct NodeDataWriterConfig
+{
+    size_t workerCount = 1;                                 ///< Anzahl der Schreib-Threads.
+    size_t queueCapacity = 65536;                           ///< Maximale Anzahl wartender Messwerte (über alle Threads).
+    size_t batchSize = 500;                                 ///< Anzahl Messwerte, ab der sofort geschrieben wird.
+    std::chrono::milliseconds maxBatchAge{ 250 };           ///< Maximales Alter des ältesten Messwerts, bevor geschrieben wird.
+
+    std::string spoolDirectory;                             ///< Verzeichnis des TelemetrySpool, leer deaktiviert den Spool.
+    size_t spoolSegmentSize = 64 * 1024 * 1024;             ///< Größe einer Segmentdatei des Spools.
+    size_t spoolHighWater = 49152;                          ///< Ab dieser Anzahl wartender Messwerte wird in den Spool geschrieben.
+    std::chrono::milliseconds spoolRetryInterval{ 1000 };   ///< Wartezeit vor einem erneuten Versuch nach einem Fehler.
+    std::chrono::milliseconds spoolSyncInterval{ 1000 };    ///< Abstand, in dem angehängte Messwerte auf die Platte geschrieben werden, mindestens spoolRetryInterval.
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Entkoppelt das Schreiben der Messwerte vom MQTT-Callback-Thread.
+ *
+ * Der Callback reiht die Messwerte nur in eine begrenzte Warteschlange ein. Ein oder mehrere
+ * Schreib-Threads leeren die Warteschlange und übergeben die Messwerte gesammelt an den
+ * BatchHandler, sobald entweder batchSize erreicht oder der älteste Messwert maxBatchAge alt ist.
+ *
+ * Jeder Schreib-Thread besitzt eine eigene Warteschlange. Die Zuordnung erfolgt über das Handle
+ * des Knotens, sodass die Reihenfolge der Messwerte eines Knotens erhalten bleibt.
+ *
+ * Ist ein spoolDirectory gesetzt, gehen Messwerte bei einem vorübergehenden Datenbankfehler nicht
+ * verloren, sondern werden im TelemetrySpool abgelegt. Solange der Spool nicht leer ist oder die
+ * Warteschlange über spoolHighWater liegt, schreibt enqueue() direkt in den Spool, statt zu
+ * blockieren. Ein eigener Thread überträgt den Spool in Batches, sobald die Datenbank wieder
+ * erreichbar ist. Er ruft den BatchHandler mit workerIndex == workerCount auf und schreibt den
+ * Spool alle spoolSyncInterval (bzw. spoolRetryInterval, falls größer) auf die Platte, sodass ein
+ * Systemabsturz höchstens die Messwerte dieses Zeitraums kostet.
+ */
+class NodeDataWriter
+{
+public:
+    /* Wird auf dem Schreib-Thread mit dessen Index und den gesammelten Messwerten aufgerufen.
+       Gibt false zurück, wenn der Batch wegen eines vorübergehenden Fehlers später erneut geschrieben werden soll */
+    using BatchHandler = std::function<bool(size_t workerIndex, std::vector<NodeDataRecord>& batch)>;
+
+    NodeDataWriter(NodeDataWriterConfig const& config, BatchHandler handler);
+    ~NodeDataWriter();
+
+    NodeDataWriter(NodeDataWriter const&) = delete;
+    void operator=(NodeDataWriter const&) = delete;
+
+    /* Startet die Schreib-Threads */
+    void start();
+
+    /* Schreibt alle noch wartenden Messwerte und beendet die Schreib-Threads */
+    void stop();
+
+    /* Reiht einen Messwert ein, blockiert solange die Warteschlange voll ist */
+    bool enqueue(NodeDataRecord&& record);
+
+    /* Reiht mehrere Messwerte eines Knotens ein, die gemeinsam an den BatchHandler übergeben werden */
+    bool enqueue(std::vector<NodeDataRecord>&& records);
+
+    /* Anzahl der aktuell wartenden Messwerte */
+    size_t queueDepth() const;
+
+    /* Anzahl unterschiedlicher workerIndex-Werte, mit denen der BatchHandler aufgerufen wird */
+    size_t handlerCount() const { return m_config.workerCount + (m_config.spoolDirectory.empty() ? 0 : 1); }
+
+    /* Gibt True zurück solange Messwerte in den Spool umgeleitet werden */
+    bool isSpooling() const { return m_spoolActive; }
+
+private:
+    /**
+     * Warteschlange eines einzelnen Schreib-Threads.
+     */
+    struct Lane
+    {
+        mutable std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<NodeDataRecord> queue;
+    };
+
+    void workerLoop(size_t workerIndex);
+    void replayLoop();
+    bool spill(std::vector<NodeDataRecord> const& batch);
+
+    NodeDataWriterConfig m_config;
+    BatchHandler m_handler;
+    size_t m_laneCapacity;
+    size_t m_laneHighWater;
+    std::vector<std::unique_ptr<Lane>> m_lanes;
+    std::vector<std::thread> m_workers;
+    std::atomic<bool> m_stopping{ false };
+
+    std::unique_ptr<TelemetrySpool> m_spool;        ///< nullptr wenn kein Spool konfiguriert oder er nicht geöffnet werden konnte.
+    std::atomic<bool> m_spoolActive{ false };       ///< Neue Messwerte gehen in den Spool, bis er wieder leer ist.
+    std::thread m_replayThread;
+    std::mutex m_replayMutex;
+    std::condition_variable m_replayWakeup;
+};
@@ -0,0 +1,243 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "NodeRegistry.hpp"
+
+/**
+ * Konstruktor, legt die Shards mit leeren Hashtabellen an.
+ *
+ * @param shardCount Anzahl der Shards, auf die die Knoten verteilt werden.
+ */
+NodeRegistry::NodeRegistry(size_t shardCount)
+{
+    shardCount = std::max<size_t>(shardCount, 1);
+
+    for (size_t i = 0; i < shardCount; ++i)
+    {
+        m_shards.push_back(std::make_unique<Shard>());
+        m_shards.back()->slots.resize(64);
+    }
+}
+
+/**
+ * Berechnet den Hashwert einer Knoten-ID (FNV-1a).
+ *
+ * @param id Die Knoten-ID.
+ * @return uint64_t Der Hashwert.
+ */
+uint64_t NodeRegistry::hashId(std::string_view id)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : id)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Sucht den Slot zu einer Knoten-ID mittels linearem Sondieren.
+ * Der Shard muss vom Aufrufer gesperrt sein.
+ *
+ * @param shard Der Shard, in dem gesucht wird.
+ * @param id Die gesuchte Knoten-ID.
+ * @param hash Der Hashwert der Knoten-ID.
+ * @return size_t Index des Slots mit dem Knoten oder des ersten leeren Slots.
+ */
+size_t NodeRegistry::findSlot(Shard const& shard, std::string_view id, uint64_t hash) const
+{
+    size_t mask = shard.slots.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask)
+    {
+        const Slot& slot = shard.slots[index];
+        if (slot.index == EmptySlot)
+            return index;
+
+        if (slot.index != DeletedSlot && slot.hash == hash && shard.nodes[slot.index].id == id)
+            return index;
+    }
+}
+
+/**
+ * Sucht einen Knoten anhand seiner ID.
+ *
+ * @param id ID des Knotens.
+ * @return NodeHandle Handle des Knotens oder InvalidNodeHandle, wenn er nicht existiert.
+ */
+NodeHandle NodeRegistry::find(std::string_view id) const
+{
+    uint64_t hash = hashId(id);
+    size_t shardIndex = shardOfHash(hash);
+    Shard const& shard = *m_shards[shardIndex];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    NodeHandle local = shard.slots[findSlot(shard, id, hash)].index;
+
+    return (local == EmptySlot) ? InvalidNodeHandle : makeHandle(shardIndex, local);
+}
+
+/**
+ * Fügt einen Knoten mit der gegebenen ID hinzu.
+ * Der neue Knoten ist weder online noch erlaubt, lastSeen wird auf die aktuelle Zeit gesetzt.
+ *
+ * @param id ID des Knotens.
+ * @param inserted Wird auf true gesetzt, wenn der Knoten neu angelegt wurde (optional).
+ * @return NodeHandle Handle des neuen oder bereits existierenden Knotens.
+ */
+NodeHandle NodeRegistry::insert(std::string_view id, bool* inserted)
+{
+    uint64_t hash = hashId(id);
+    size_t shardIndex = shardOfHash(hash);
+    Shard& shard = *m_shards[shardIndex];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return insertLocked(shard, shardIndex, id, hash, inserted);
+}
+
+/**
+ * Fügt einen aus der Datenbank geladenen Knoten hinzu, mit nur einer Sperre des Shards.
+ * Der Knoten ist danach offline, allowed und lastSeen werden aus der Datenbank übernommen.
+ *
+ * @param id ID des Knotens.
+ * @param allowed Erlaubnis-Status aus der Datenbank.
+ * @param lastSeen Zeitpunkt der letzten Meldung aus der Datenbank.
+ * @return NodeHandle Handle des Knotens.
+ */
+NodeHandle NodeRegistry::load(std::string_view id, bool allowed, time_t lastSeen)
+{
+    uint64_t hash = hashId(id);
+    size_t shardIndex = shardOfHash(hash);
+    Shard& shard = *m_shards[shardIndex];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    NodeHandle handle = insertLocked(shard, shardIndex, id, hash, nullptr);
+
+    Node& node = shard.nodes[handle / m_shards.size()];
+    node.allowed = allowed;
+    node.lastSeen = lastSeen;
+    node.online = false;
+    return handle;
+}
+
+/**
+ * Fügt einen Knoten in einen Shard ein. Der Shard muss vom Aufrufer gesperrt sein.
+ *
+ * @param shard Der Shard, in den eingefügt wird.
+ * @param shardIndex Index des Shards.
+ * @param id ID des Knotens.
+ * @param hash Hashwert der ID.
+ * @param inserted Wird auf true gesetzt, wenn der Knoten neu angelegt wurde (optional).
+ * @return NodeHandle Handle des neuen oder bereits existierenden Knotens.
+ */
+NodeHandle NodeRegistry::insertLocked(Shard& shard, size_t shardIndex, std::string_view id, uint64_t hash, bool* inserted)
+{
+    size_t index = findSlot(shard, id, hash);
+
+    if (shard.slots[index].index != EmptySlot)
+    {
+        if (inserted)
+            *inserted = false;
+        return makeHandle(shardIndex, shard.slots[index].index);
+    }
+
+    // Tabelle höchstens zu 70% füllen, damit die Sondierungsketten kurz bleiben
+    if ((shard.used + 1) * 10 > shard.slots.size() * 7)
+    {
+        rehash(shard, shard.slots.size() * 2);
+        index = findSlot(shard, id, hash);
+    }
+
+    NodeHandle local = static_cast<NodeHandle>(shard.nodes.size());
+
+    Node& node = shard.nodes.emplace_back();
+    node.id = id;
+    node.lastSeen = std::time(nullptr);
+    node.lastSeenDirty = false;
+    node.offlineTimeout = DefaultNodeOfflineTimeout;
+    node.offlineDeadline = {};
+    node.allowed = false;
+    node.online = false;
+    shard.alive.push_back(true);
+
+    shard.slots[index] = Slot{ hash, local };
+    ++shard.used;
+    ++shard.count;
+
+    if (inserted)
+        *inserted = true;
+    return makeHandle(shardIndex, local);
+}
+
+/**
+ * Entfernt einen Knoten. Das Handle wird nicht wiederverwendet.
+ * Die ID bleibt im Speicher, damit bereits ausgegebene std::string_view gültig bleiben.
+ *
+ * @param handle Handle des zu entfernenden Knotens.
+ * @return bool Gibt true zurück, wenn der Knoten entfernt wurde.
+ */
+bool NodeRegistry::remove(NodeHandle handle)
+{
+    if (handle == InvalidNodeHandle)
+        return false;
+
+    Shard& shard = *m_shards[shardOf(handle)];
+    size_t local = handle / m_shards.size();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (local >= shard.nodes.size() || !shard.alive[local])
+        return false;
+
+    Node& node = shard.nodes[local];
+    size_t index = findSlot(shard, node.id, hashId(node.id));
+
+    shard.slots[index].index = DeletedSlot;
+    shard.alive[local] = false;
+    --shard.count;
+    return true;
+}
+
+/**
+ * Gibt die Anzahl der existierenden Knoten über alle Shards zurück.
+ *
+ * @return size_t Anzahl der Knoten.
+ */
+size_t NodeRegistry::size() const
+{
+    size_t count = 0;
+    for (auto const& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        count += shard->count;
+    }
+    return count;
+}
+
+/**
+ * Baut die Hashtabelle eines Shards mit neuer Größe auf. Gelöschte Einträge werden dabei entfernt.
+ * Der Shard muss vom Aufrufer gesperrt sein.
+ *
+ * @param shard Der neu aufzubauende Shard.
+ * @param capacity Neue Anzahl an Slots (Zweierpotenz).
+ */
+void NodeRegistry::rehash(Shard& shard, size_t capacity)
+{
+    std::vector<Slot> oldSlots(capacity);
+    oldSlots.swap(shard.slots);
+
+    size_t mask = shard.slots.size() - 1;
+    for (const Slot& slot : oldSlots)
+    {
+        if (slot.index == EmptySlot || slot.index == DeletedSlot)
+            continue;
+
+        size_t index = slot.hash & mask;
+        while (shard.slots[index].index != EmptySlot)
+            index = (index + 1) & mask;
+
+        shard.slots[index] = slot;
+    }
+
+    shard.used = shard.count;
+}
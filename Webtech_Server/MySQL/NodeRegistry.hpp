@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+#include <deque>
+#include <limits>
+#include <string_view>
+
+/**
+ * Struktur zur Speicherung von Daten eines Knotens.
+ */
+struct NodeData
+{
+    float temperature = 0.0f;
+    uint32_t pressure = 0;
+    float altitude = 0.0f;
+    uint32_t humidity = 0;
+    uint32_t lux = 0;
+    uint16_t sound = 0;
+    time_t timeStamp = 0;
+};
+
+/**
+ * Struktur zur Repräsentation eines Knotens.
+ */
+struct Node
+{
+    std::string id;
+    time_t lastSeen;
+    bool lastSeenDirty;     ///< lastSeen wurde geändert, aber noch nicht in die Datenbank geschrieben.
+    std::chrono::seconds offlineTimeout;    ///< Zeit ohne Meldung, nach der der Knoten als offline gilt.
+    std::chrono::steady_clock::time_point offlineDeadline;  ///< Frist aus der letzten Meldung, der Offline-Timer wird erst bei seinem Ablauf nachgezogen.
+    bool allowed;
+    bool online;
+
+    // Last Data Received
+    NodeData data;
+};
+
+/**
+ * Handle eines Knotens in der NodeRegistry.
+ * Bleibt für die gesamte Laufzeit gültig und wird nach dem Entfernen eines Knotens nicht wiederverwendet.
+ * Der Shard eines Knotens ergibt sich aus handle % shardCount, der Index innerhalb des Shards aus handle / shardCount.
+ */
+using NodeHandle = uint32_t;
+
+/* Ungültiges Handle, wird zurückgegeben wenn ein Knoten nicht gefunden wurde */
+constexpr NodeHandle InvalidNodeHandle = std::numeric_limits<NodeHandle>::max();
+
+/* Standardanzahl der Shards, auf die die Knoten verteilt werden */
+constexpr size_t DefaultNodeShardCount = 8;
+
+/* Standardzeit ohne Meldung, nach der ein Knoten als offline gilt */
+constexpr std::chrono::seconds DefaultNodeOfflineTimeout{ 60 };
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Virtueller Container, der das Abbild der Nodes-Tabelle darstellt.
+ *
+ * Die Knoten-IDs werden auf fortlaufende Handles abgebildet. Die Suche erfolgt über eine
+ * Hashtabelle mit offener Adressierung (lineares Sondieren) direkt mit std::string_view,
+ * sodass für eine Suche kein std::string angelegt werden muss.
+ *
+ * Die Knoten sind anhand des Hashwerts ihrer ID auf mehrere Shards verteilt. Jeder Shard besitzt
+ * einen eigenen Mutex, sodass Threads, die Knoten in verschiedenen Shards bearbeiten, sich nicht
+ * gegenseitig blockieren. Auf einen Knoten wird ausschließlich über visit() bzw. forEach()
+ * zugegriffen, die den Shard für die Dauer des Zugriffs sperren.
+ *
+ * Die ID eines Knotens wird nach dem Anlegen nie verändert und auch beim Entfernen nicht
+ * freigegeben. Ein std::string_view auf Node::id bleibt daher so lange gültig wie die Registry.
+ */
+class NodeRegistry
+{
+public:
+    explicit NodeRegistry(size_t shardCount = DefaultNodeShardCount);
+
+    NodeRegistry(NodeRegistry const&) = delete;
+    void operator=(NodeRegistry const&) = delete;
+
+    /* Sucht einen Knoten anhand seiner ID, gibt InvalidNodeHandle zurück wenn er nicht existiert */
+    NodeHandle find(std::string_view id) const;
+
+    /* Fügt einen Knoten hinzu, existiert er bereits wird sein Handle zurückgegeben */
+    NodeHandle insert(std::string_view id, bool* inserted = nullptr);
+
+    /* Fügt einen aus der Datenbank geladenen Knoten offline hinzu bzw. übernimmt allowed und lastSeen */
+    NodeHandle load(std::string_view id, bool allowed, time_t lastSeen);
+
+    /* Entfernt einen Knoten, sein Handle wird danach ungültig */
+    bool remove(NodeHandle handle);
+
+    /* Ruft die Funktion mit dem Knoten auf, während sein Shard gesperrt ist. Gibt false zurück wenn er nicht existiert */
+    template<typename Func>
+    bool visit(NodeHandle handle, Func&& func)
+    {
+        if (handle == InvalidNodeHandle)
+            return false;
+
+        Shard& shard = *m_shards[shardOf(handle)];
+        size_t local = handle / m_shards.size();
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (local >= shard.nodes.size() || !shard.alive[local])
+            return false;
+
+        func(shard.nodes[local]);
+        return true;
+    }
+
+    /* Ruft die Funktion für jeden existierenden Knoten mit dessen Handle auf, Shard für Shard gesperrt */
+    template<typename Func>
+    void forEach(Func&& func)
+    {
+        for (size_t shardIndex = 0; shardIndex < m_shards.size(); ++shardIndex)
+            forEachInShard(shardIndex, func);
+    }
+
+    /* Ruft die Funktion für jeden existierenden Knoten eines Shards auf */
+    template<typename Func>
+    void forEachInShard(size_t shardIndex, Func&& func)
+    {
+        Shard& shard = *m_shards[shardIndex];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        for (size_t local = 0; local < shard.nodes.size(); ++local)
+        {
+            if (shard.alive[local])
+                func(makeHandle(shardIndex, local), shard.nodes[local]);
+        }
+    }
+
+    /* Anzahl der existierenden Knoten */
+    size_t size() const;
+
+    /* Anzahl der Shards */
+    size_t shardCount() const { return m_shards.size(); }
+
+    /* Shard, in dem der Knoten mit gegebenem Handle liegt */
+    size_t shardOf(NodeHandle handle) const { return handle % m_shards.size(); }
+
+    /* Shard, in dem der Knoten mit gegebener ID liegt bzw. liegen würde */
+    size_t shardOf(std::string_view id) const { return shardOfHash(hashId(id)); }
+
+private:
+    /**
+     * Eintrag der Hashtabelle.
+     */
+    struct Slot
+    {
+        uint64_t hash = 0;
+        NodeHandle index = EmptySlot;   ///< Lokaler Index des Knotens innerhalb des Shards.
+    };
+
+    /**
+     * Ein Teil der Knoten mit eigener Hashtabelle und eigenem Mutex.
+     */
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;        ///< Hashtabelle, Größe ist immer eine Zweierpotenz.
+        std::deque<Node> nodes;         ///< Knoten, indiziert über den lokalen Index. Referenzen bleiben beim Wachsen gültig.
+        std::vector<bool> alive;        ///< Markiert, ob der Knoten zum lokalen Index noch existiert.
+        size_t count = 0;               ///< Anzahl existierender Knoten.
+        size_t used = 0;                ///< Anzahl belegter Slots inklusive gelöschter Einträge.
+    };
+
+    static constexpr NodeHandle EmptySlot = InvalidNodeHandle;
+    static constexpr NodeHandle DeletedSlot = InvalidNodeHandle - 1;
+
+    static uint64_t hashId(std::string_view id);
+    size_t shardOfHash(uint64_t hash) const { return (hash >> 32) % m_shards.size(); }
+    NodeHandle makeHandle(size_t shardIndex, size_t local) const { return static_cast<NodeHandle>(local * m_shards.size() + shardIndex); }
+
+    size_t findSlot(Shard const& shard, std::string_view id, uint64_t hash) const;
+    NodeHandle insertLocked(Shard& shard, size_t shardIndex, std::string_view id, uint64_t hash, bool* inserted);
+    void rehash(Shard& shard, size_t capacity);
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
@@ -0,0 +1,555 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "TelemetrySpool.hpp"
+#include "../Logging/Logger.hpp"
+
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr char SegmentMagic[8] = { 'W', 'T', 'S', 'P', 'O', 'O', 'L', '1' };
+    constexpr size_t SegmentHeaderSize = 16;    ///< Magic und Segmentnummer.
+    constexpr size_t RecordHeaderSize = 8;      ///< Länge der Nutzdaten und Prüfsumme.
+
+    /* Größe der Messwertfelder eines Eintrags hinter der ID */
+    constexpr size_t RecordDataSize = sizeof(float) + sizeof(uint32_t) + sizeof(float) + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + sizeof(int64_t);
+
+    /**
+     * Schlüssel für die Fehler des Spools. Bei einer vollen Platte scheitert jeder Checkpoint,
+     * die Meldungen werden daher begrenzt.
+     */
+    LogKey& spoolError()
+    {
+        static LogKey& key = sLog.key("spool_error", LogLevel::Error);
+        return key;
+    }
+
+    /**
+     * Prüfsumme der Nutzdaten eines Eintrags (FNV-1a, 32 Bit).
+     */
+    uint32_t checksum(const char* data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * Gesamtgröße eines Eintrags inklusive Kopf, auf 8 Byte aufgerundet.
+     */
+    size_t recordSize(size_t payloadSize)
+    {
+        return (RecordHeaderSize + payloadSize + 7) & ~size_t(7);
+    }
+
+    template<typename T>
+    char* put(char* it, T value)
+    {
+        std::memcpy(it, &value, sizeof(T));
+        return it + sizeof(T);
+    }
+
+    template<typename T>
+    const char* get(const char* it, T& value)
+    {
+        std::memcpy(&value, it, sizeof(T));
+        return it + sizeof(T);
+    }
+
+    /**
+     * Liest den Eintrag an der gegebenen Position.
+     *
+     * @return size_t Größe des Eintrags oder 0, wenn an der Position kein gültiger Eintrag steht.
+     */
+    size_t decodeRecord(const char* data, size_t offset, size_t limit, NodeDataRecord* record)
+    {
+        if (offset + RecordHeaderSize > limit)
+            return 0;
+
+        uint32_t payloadSize = 0, sum = 0;
+        get(get(data + offset, payloadSize), sum);
+
+        if (payloadSize < sizeof(uint16_t) + RecordDataSize || offset + recordSize(payloadSize) > limit)
+            return 0;
+
+        const char* payload = data + offset + RecordHeaderSize;
+        if (checksum(payload, payloadSize) != sum)
+            return 0;
+
+        uint16_t idLength = 0;
+        const char* it = get(payload, idLength);
+        if (sizeof(uint16_t) + idLength + RecordDataSize != payloadSize)
+            return 0;
+
+        if (record)
+        {
+            int64_t timeStamp = 0;
+            record->node = InvalidNodeHandle;
+            record->id = std::string_view(it, idLength);
+            it += idLength;
+            it = get(it, record->data.temperature);
+            it = get(it, record->data.pressure);
+            it = get(it, record->data.altitude);
+            it = get(it, record->data.humidity);
+            it = get(it, record->data.lux);
+            it = get(it, record->data.sound);
+            get(it, timeStamp);
+            record->data.timeStamp = static_cast<time_t>(timeStamp);
+        }
+
+        return recordSize(payloadSize);
+    }
+}
+
+/**
+ * Konstruktor für den TelemetrySpool. Die Segmente werden erst mit open() eingeblendet.
+ *
+ * @param directory Verzeichnis für Segmente und Checkpoint, wird bei Bedarf angelegt.
+ * @param segmentSize Größe einer Segmentdatei in Byte.
+ */
+TelemetrySpool::TelemetrySpool(std::string directory, size_t segmentSize) :
+    m_directory(std::move(directory)),
+    m_segmentSize(std::max<size_t>(segmentSize, 64 * 1024))
+{
+}
+
+/**
+ * Destruktor, schreibt und schließt alle Segmente.
+ */
+TelemetrySpool::~TelemetrySpool()
+{
+    close();
+}
+
+/**
+ * Öffnet den Spool. Vorhandene Segmente werden eingeblendet und bis zum letzten vollständigen
+ * Eintrag gelesen, der Lesezeiger wird aus dem Checkpoint übernommen.
+ *
+ * @return bool Gibt false zurück, wenn das Verzeichnis oder ein Segment nicht geöffnet werden konnte.
+ */
+bool TelemetrySpool::open()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    if (ec)
+    {
+        sLog.write(spoolError(), "Spool Error: Cannot create directory ", m_directory, ": ", ec.message());
+        return false;
+    }
+
+    // Vorhandene Segmente einblenden
+    for (const auto& entry : std::filesystem::directory_iterator(m_directory, ec))
+    {
+        unsigned int index = 0;
+        std::string name = entry.path().filename().string();
+        if (std::sscanf(name.c_str(), "segment-%08u.spool", &index) == 1 && !mapSegment(index, false))
+            return false;
+    }
+
+    // Checkpoint laden, fehlt er, beginnt das Lesen am Anfang des ältesten Segments
+    m_checkpoint = SpoolPosition{};
+    int fd = ::open(checkpointPath().c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        SpoolPosition stored;
+        if (::read(fd, &stored, sizeof(stored)) == sizeof(stored))
+            m_checkpoint = stored;
+        ::close(fd);
+    }
+
+    if (m_segments.empty() && !mapSegment(m_checkpoint.segment, true))
+        return false;
+
+    // Den Checkpoint auf ein vorhandenes Segment und dessen gültigen Bereich begrenzen
+    auto it = m_segments.lower_bound(m_checkpoint.segment);
+    if (it == m_segments.end())
+    {
+        it = std::prev(m_segments.end());
+        m_checkpoint = SpoolPosition{ it->first, it->second.end };
+    }
+    else if (it->first != m_checkpoint.segment || m_checkpoint.offset < SegmentHeaderSize)
+        m_checkpoint = SpoolPosition{ it->first, SegmentHeaderSize };
+    else
+        m_checkpoint.offset = std::min<uint64_t>(m_checkpoint.offset, it->second.end);
+
+    // Die vorhandenen Einträge wurden von der Platte gelesen
+    auto last = std::prev(m_segments.end());
+    m_synced = SpoolPosition{ last->first, last->second.end };
+
+    return true;
+}
+
+/**
+ * Schreibt alle eingeblendeten Segmente auf die Platte und gibt sie frei.
+ */
+void TelemetrySpool::close()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& [index, segment] : m_segments)
+        unmapSegment(segment);
+
+    m_segments.clear();
+}
+
+/**
+ * Blendet ein Segment ein. Ein bestehendes Segment wird bis zum letzten gültigen Eintrag gelesen.
+ * m_mutex muss gesperrt sein.
+ *
+ * @param index Nummer des Segments.
+ * @param create Legt das Segment neu an, statt ein bestehendes zu öffnen.
+ * @return bool Gibt false zurück, wenn das Segment nicht eingeblendet werden konnte.
+ */
+bool TelemetrySpool::mapSegment(uint32_t index, bool create)
+{
+    std::string path = segmentPath(index);
+    int fd = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+    if (fd < 0)
+    {
+        sLog.write(spoolError(), "Spool Error: Cannot open ", path, ": ", std::strerror(errno));
+        return false;
+    }
+
+    size_t size = m_segmentSize;
+    if (create)
+    {
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            sLog.write(spoolError(), "Spool Error: Cannot allocate ", path, ": ", std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+    }
+    else
+    {
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < SegmentHeaderSize)
+        {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+    }
+
+    void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        sLog.write(spoolError(), "Spool Error: Cannot map ", path, ": ", std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    Segment segment;
+    segment.fd = fd;
+    segment.data = static_cast<char*>(data);
+    segment.size = size;
+    segment.end = SegmentHeaderSize;
+
+    if (create)
+    {
+        std::memcpy(segment.data, SegmentMagic, sizeof(SegmentMagic));
+        put(segment.data + sizeof(SegmentMagic), index);
+    }
+    else
+    {
+        if (std::memcmp(segment.data, SegmentMagic, sizeof(SegmentMagic)) != 0)
+        {
+            sLog.write(spoolError(), "Spool Error: ", path, " is not a spool segment");
+            unmapSegment(segment);
+            return false;
+        }
+
+        // Bis zum ersten leeren oder unvollständigen Eintrag lesen
+        while (size_t length = decodeRecord(segment.data, segment.end, segment.size, nullptr))
+            segment.end += length;
+    }
+
+    m_segments[index] = segment;
+    return true;
+}
+
+/**
+ * Schreibt ein Segment zurück und gibt es frei.
+ *
+ * @param segment Das freizugebende Segment.
+ */
+void TelemetrySpool::unmapSegment(Segment& segment)
+{
+    if (segment.data)
+    {
+        ::msync(segment.data, segment.size, MS_SYNC);
+        ::munmap(segment.data, segment.size);
+        segment.data = nullptr;
+    }
+
+    if (segment.fd >= 0)
+    {
+        ::close(segment.fd);
+        segment.fd = -1;
+    }
+}
+
+/**
+ * Hängt einen Messwert an das aktuelle Segment an.
+ *
+ * @param record Der Messwert.
+ * @return bool Gibt false zurück, wenn der Messwert nicht geschrieben werden konnte.
+ */
+bool TelemetrySpool::append(const NodeDataRecord& record)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return appendLocked(record);
+}
+
+/**
+ * Hängt mehrere Messwerte an.
+ *
+ * @param records Die Messwerte.
+ * @return bool Gibt false zurück, wenn mindestens ein Messwert nicht geschrieben werden konnte.
+ */
+bool TelemetrySpool::append(const std::vector<NodeDataRecord>& records)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const NodeDataRecord& record : records)
+    {
+        if (!appendLocked(record))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Schreibt einen Eintrag. Passt er nicht mehr in das aktuelle Segment, wird ein neues angelegt.
+ * m_mutex muss gesperrt sein.
+ *
+ * @param record Der Messwert.
+ * @return bool Gibt false zurück, wenn der Messwert nicht geschrieben werden konnte.
+ */
+bool TelemetrySpool::appendLocked(const NodeDataRecord& record)
+{
+    if (m_segments.empty() || record.id.size() > std::numeric_limits<uint16_t>::max())
+        return false;
+
+    size_t payloadSize = sizeof(uint16_t) + record.id.size() + RecordDataSize;
+    size_t size = recordSize(payloadSize);
+    if (SegmentHeaderSize + size > m_segmentSize)
+        return false;
+
+    auto last = std::prev(m_segments.end());
+    if (last->second.end + size > last->second.size)
+    {
+        ::msync(last->second.data, last->second.size, MS_ASYNC);
+        if (!mapSegment(last->first + 1, true))
+            return false;
+        last = std::prev(m_segments.end());
+    }
+
+    Segment& segment = last->second;
+    char* payload = segment.data + segment.end + RecordHeaderSize;
+
+    // Nutzdaten zuerst, Länge und Prüfsumme zuletzt, damit ein halb geschriebener Eintrag ungültig bleibt
+    char* it = put(payload, static_cast<uint16_t>(record.id.size()));
+    std::memcpy(it, record.id.data(), record.id.size());
+    it += record.id.size();
+    it = put(it, record.data.temperature);
+    it = put(it, record.data.pressure);
+    it = put(it, record.data.altitude);
+    it = put(it, record.data.humidity);
+    it = put(it, record.data.lux);
+    it = put(it, record.data.sound);
+    put(it, static_cast<int64_t>(record.data.timeStamp));
+
+    put(segment.data + segment.end + sizeof(uint32_t), checksum(payload, payloadSize));
+    put(segment.data + segment.end, static_cast<uint32_t>(payloadSize));
+
+    segment.end += size;
+    return true;
+}
+
+/**
+ * Liest ab dem Checkpoint bis zu maxRecords Messwerte, ohne den Checkpoint zu verändern.
+ * Die IDs der gelesenen Messwerte verweisen direkt in das eingeblendete Segment.
+ *
+ * @param records Vektor, an den die gelesenen Messwerte angehängt werden.
+ * @param maxRecords Maximale Anzahl zu lesender Messwerte.
+ * @return SpoolPosition Position hinter dem letzten gelesenen Messwert, für commit().
+ */
+SpoolPosition TelemetrySpool::read(std::vector<NodeDataRecord>& records, size_t maxRecords)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    SpoolPosition position = m_checkpoint;
+    size_t count = 0;
+
+    for (auto it = m_segments.find(position.segment); it != m_segments.end() && count < maxRecords; )
+    {
+        const Segment& segment = it->second;
+
+        if (position.offset < segment.end)
+        {
+            NodeDataRecord record{};
+            size_t length = decodeRecord(segment.data, position.offset, segment.end, &record);
+            if (length == 0)
+                break;
+
+            records.push_back(record);
+            position.offset += length;
+            ++count;
+            continue;
+        }
+
+        // Segment vollständig gelesen, weiter im nächsten sofern vorhanden
+        if (++it == m_segments.end())
+            break;
+
+        position = SpoolPosition{ it->first, SegmentHeaderSize };
+    }
+
+    return position;
+}
+
+/**
+ * Übernimmt die Position als neuen Checkpoint und löscht alle Segmente davor.
+ *
+ * @param position Von read() zurückgegebene Position.
+ */
+void TelemetrySpool::commit(SpoolPosition position)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_checkpoint = position;
+    writeCheckpoint(position);
+
+    // Vollständig gelesene Segmente entfernen, das aktuelle Segment bleibt erhalten
+    while (m_segments.size() > 1 && m_segments.begin()->first < position.segment)
+    {
+        auto first = m_segments.begin();
+        unmapSegment(first->second);
+        std::filesystem::remove(segmentPath(first->first));
+        m_segments.erase(first);
+    }
+}
+
+/**
+ * Prüft, ob noch ungelesene Messwerte im Spool liegen.
+ *
+ * @return bool Gibt true zurück, wenn der Checkpoint am Ende des letzten Segments steht.
+ */
+bool TelemetrySpool::empty() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_segments.empty())
+        return true;
+
+    auto last = std::prev(m_segments.end());
+    return m_checkpoint.segment == last->first && m_checkpoint.offset >= last->second.end;
+}
+
+/**
+ * Schreibt die seit dem letzten Aufruf angehängten Einträge mit MS_SYNC auf die Platte.
+ *
+ * Unter m_mutex werden nur die zu schreibenden Bereiche bestimmt, das Schreiben selbst läuft ohne
+ * Sperre, damit append() auf den MQTT-Threads nicht auf die Platte wartet. Die Segmente bleiben dabei
+ * eingeblendet, solange commit() und close() nicht gleichzeitig laufen.
+ *
+ * @return bool Gibt false zurück, wenn ein Bereich nicht geschrieben werden konnte. Er wird beim nächsten Aufruf erneut geschrieben.
+ */
+bool TelemetrySpool::sync()
+{
+    static const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+    std::vector<std::pair<char*, size_t>> ranges;
+    SpoolPosition target;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_segments.empty())
+            return true;
+
+        for (auto it = m_segments.lower_bound(m_synced.segment); it != m_segments.end(); ++it)
+        {
+            const Segment& segment = it->second;
+            size_t from = it->first == m_synced.segment ? static_cast<size_t>(m_synced.offset) : 0;
+            if (from >= segment.end)
+                continue;
+
+            // msync() verlangt eine an der Seitengröße ausgerichtete Adresse
+            size_t start = from - from % pageSize;
+            ranges.emplace_back(segment.data + start, segment.end - start);
+        }
+
+        auto last = std::prev(m_segments.end());
+        target = SpoolPosition{ last->first, last->second.end };
+    }
+
+    for (auto [data, size] : ranges)
+    {
+        if (::msync(data, size, MS_SYNC) != 0)
+        {
+            sLog.write(spoolError(), "Spool Error: Cannot sync segment: ", std::strerror(errno));
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_synced = target;
+    return true;
+}
+
+/**
+ * Schreibt den Checkpoint atomar über eine temporäre Datei und rename().
+ * m_mutex muss gesperrt sein.
+ *
+ * @param position Der zu schreibende Checkpoint.
+ */
+void TelemetrySpool::writeCheckpoint(SpoolPosition position)
+{
+    std::string path = checkpointPath();
+    std::string tempPath = path + ".tmp";
+
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        sLog.write(spoolError(), "Spool Error: Cannot write checkpoint: ", std::strerror(errno));
+        return;
+    }
+
+    bool written = ::write(fd, &position, sizeof(position)) == sizeof(position) && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!written || ::rename(tempPath.c_str(), path.c_str()) != 0)
+        sLog.write(spoolError(), "Spool Error: Cannot write checkpoint: ", std::strerror(errno));
+}
+
+/**
+ * Pfad der Segmentdatei mit der gegebenen Nummer.
+ */
+std::string TelemetrySpool::segmentPath(uint32_t index) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%08u.spool", index);
+    return m_directory + "/" + name;
+}
+
+/**
+ * Pfad der Checkpoint-Datei.
+ */
+std::string TelemetrySpool::checkpointPath() const
+{
+    return m_directory + "/checkpoint";
+}
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "NodeDataWriter.hpp"
+
+#include <map>
+
+/**
+ * Position im Spool, bestehend aus Segmentnummer und Byte-Offset innerhalb des Segments.
+ */
+struct SpoolPosition
+{
+    uint32_t segment = 0;
+    uint64_t offset = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Lokaler, nur anhängender Zwischenspeicher für Messwerte, die (noch) nicht in die Datenbank
+ * geschrieben werden konnten.
+ *
+ * Die Messwerte werden in Segmentdateien fester Größe abgelegt, die per mmap eingeblendet sind.
+ * Jeder Eintrag trägt Länge und Prüfsumme, sodass ein nach einem Absturz unvollständig
+ * geschriebener Eintrag beim Öffnen erkannt und verworfen wird.
+ *
+ * Der Lesezeiger wird erst mit commit() als Checkpoint auf die Platte geschrieben, nachdem die
+ * gelesenen Messwerte erfolgreich in die Datenbank übernommen wurden. Ein Absturz zwischen
+ * Schreiben und commit() führt zu einer erneuten Übertragung derselben Messwerte; die
+ * Anweisungen in node_data und node_data_history sind dafür idempotent. Vollständig gelesene
+ * Segmente werden beim commit() gelöscht.
+ *
+ * Angehängte Einträge liegen zunächst nur im Page Cache und überstehen damit einen Absturz des
+ * Prozesses, nicht aber einen des Systems. sync() schreibt die seit dem letzten Aufruf angehängten
+ * Einträge auf die Platte; der NodeDataWriter ruft es in festen Abständen auf.
+ *
+ * Alle Methoden sind threadsicher.
+ */
+class TelemetrySpool
+{
+public:
+    TelemetrySpool(std::string directory, size_t segmentSize);
+    ~TelemetrySpool();
+
+    TelemetrySpool(TelemetrySpool const&) = delete;
+    void operator=(TelemetrySpool const&) = delete;
+
+    /* Öffnet das Verzeichnis, blendet vorhandene Segmente ein und lädt den Checkpoint */
+    bool open();
+
+    /* Schreibt alle Segmente auf die Platte und gibt sie frei */
+    void close();
+
+    /* Hängt einen Messwert an, gibt false zurück wenn er nicht geschrieben werden konnte */
+    bool append(const NodeDataRecord& record);
+
+    /* Hängt mehrere Messwerte an */
+    bool append(const std::vector<NodeDataRecord>& records);
+
+    /* Liest ab dem Checkpoint bis zu maxRecords Messwerte. Die IDs verweisen in den Spool und bleiben bis zum nächsten commit() gültig */
+    SpoolPosition read(std::vector<NodeDataRecord>& records, size_t maxRecords);
+
+    /* Setzt den Checkpoint auf die von read() zurückgegebene Position */
+    void commit(SpoolPosition position);
+
+    /* Gibt True zurück wenn alle Messwerte bis zum Checkpoint gelesen wurden */
+    bool empty() const;
+
+    /* Schreibt die seit dem letzten Aufruf angehängten Einträge auf die Platte und wartet darauf.
+       Nicht parallel zu commit() oder close() aufrufen, da diese Segmente freigeben */
+    bool sync();
+
+private:
+    /**
+     * Ein eingeblendetes Segment.
+     */
+    struct Segment
+    {
+        int fd = -1;
+        char* data = nullptr;
+        size_t size = 0;
+        size_t end = 0;         ///< Ende des letzten vollständigen Eintrags.
+    };
+
+    std::string segmentPath(uint32_t index) const;
+    std::string checkpointPath() const;
+
+    bool mapSegment(uint32_t index, bool create);
+    void unmapSegment(Segment& segment);
+    bool appendLocked(const NodeDataRecord& record);
+    void writeCheckpoint(SpoolPosition position);
+
+    std::string m_directory;
+    size_t m_segmentSize;
+
+    mutable std::mutex m_mutex;
+    std::map<uint32_t, Segment> m_segments;     ///< Nach Segmentnummer sortiert, das letzte wird beschrieben.
+    SpoolPosition m_checkpoint;
+    SpoolPosition m_synced;                     ///< Bis hierhin stehen die angehängten Einträge sicher auf der Platte.
+};
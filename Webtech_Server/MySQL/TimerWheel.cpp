@@ -0,0 +1,189 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "TimerWheel.hpp"
+
+/**
+ * Konstruktor für das TimerWheel. Der erste Tick beginnt mit der Erstellung.
+ *
+ * @param tick Auflösung des Rads, Timer laufen höchstens um diese Dauer zu spät ab.
+ */
+TimerWheel::TimerWheel(Clock::duration tick) :
+    m_tick(std::max<Clock::duration>(tick, std::chrono::milliseconds(1))),
+    m_start(Clock::now())
+{
+}
+
+/**
+ * Rechnet einen Zeitpunkt in einen Tick um, aufgerundet damit ein Timer nie zu früh abläuft.
+ *
+ * @param time Der Zeitpunkt.
+ * @return uint64_t Der zugehörige Tick.
+ */
+uint64_t TimerWheel::tickOf(Clock::time_point time) const
+{
+    if (time <= m_start)
+        return 0;
+
+    return static_cast<uint64_t>((time - m_start + m_tick - Clock::duration(1)) / m_tick);
+}
+
+/**
+ * Sortiert einen Eintrag in das Fach für den gegebenen Tick ein.
+ * Der Tick darf nicht vor m_currentTick liegen. m_mutex muss gesperrt sein.
+ *
+ * @param item Der Eintrag.
+ * @param tick Tick, an dem der Eintrag fällig wird.
+ */
+void TimerWheel::place(Item item, uint64_t tick)
+{
+    uint64_t delta = tick - m_currentTick;
+
+    for (size_t level = 0; level < Levels; ++level)
+    {
+        if (delta < (uint64_t(1) << (SlotBits * (level + 1))))
+        {
+            m_levels[level][(tick >> (SlotBits * level)) & (SlotsPerLevel - 1)].push_back(item);
+            return;
+        }
+    }
+
+    // Weiter als das Rad reicht: im letzten Fach der obersten Ebene ablegen, beim Fälligwerden neu einsortieren
+    uint64_t maxTick = m_currentTick + (uint64_t(1) << (SlotBits * Levels)) - 1;
+    m_entries[item.handle].wheelTick = maxTick;
+    m_levels[Levels - 1][(maxTick >> (SlotBits * (Levels - 1))) & (SlotsPerLevel - 1)].push_back(item);
+}
+
+/**
+ * Prüft, ob ein Eintrag in einem Fach noch zum aktuellen Timer des Knotens gehört.
+ * m_mutex muss gesperrt sein.
+ */
+bool TimerWheel::isCurrent(Item const& item) const
+{
+    const Entry& entry = m_entries[item.handle];
+    return entry.armed && entry.generation == item.generation;
+}
+
+/**
+ * Zieht den Timer eines Knotens auf. Läuft bereits ein Timer mit früherer oder gleicher Frist,
+ * wird nur die Frist gespeichert, sonst wird der Timer neu einsortiert.
+ *
+ * @param handle Handle des Knotens.
+ * @param deadline Zeitpunkt, an dem der Timer abläuft.
+ */
+void TimerWheel::schedule(NodeHandle handle, Clock::time_point deadline)
+{
+    if (handle == InvalidNodeHandle)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (handle >= m_entries.size())
+        m_entries.resize(std::max<size_t>(handle + 1, m_entries.size() * 2));
+
+    // Das Fach des aktuellen Ticks wurde bereits abgearbeitet
+    uint64_t tick = std::max(tickOf(deadline), m_currentTick + 1);
+    Entry& entry = m_entries[handle];
+
+    if (entry.armed && tick >= entry.wheelTick)
+    {
+        entry.deadlineTick = tick;
+        return;
+    }
+
+    entry.armed = true;
+    entry.deadlineTick = tick;
+    entry.wheelTick = tick;
+    ++entry.generation;
+    place(Item{ handle, entry.generation }, tick);
+}
+
+/**
+ * Entfernt den Timer eines Knotens. Der Eintrag im Fach wird beim Erreichen verworfen.
+ *
+ * @param handle Handle des Knotens.
+ */
+void TimerWheel::cancel(NodeHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (handle < m_entries.size() && m_entries[handle].armed)
+    {
+        m_entries[handle].armed = false;
+        ++m_entries[handle].generation;
+    }
+}
+
+/**
+ * Gibt zurück, ob für den Knoten ein Timer läuft.
+ *
+ * @param handle Handle des Knotens.
+ * @return bool Gibt true zurück, wenn der Timer aufgezogen und noch nicht abgelaufen ist.
+ */
+bool TimerWheel::isArmed(NodeHandle handle) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return handle < m_entries.size() && m_entries[handle].armed;
+}
+
+/**
+ * Schaltet das Rad Tick für Tick bis zum gegebenen Zeitpunkt weiter.
+ * Bei jedem Tick werden fällige Fächer höherer Ebenen nach unten verschoben und anschließend
+ * das Fach der Ebene 0 abgearbeitet. Timer, deren Frist inzwischen verlängert wurde, werden
+ * an der neuen Frist wieder einsortiert.
+ *
+ * @param now Aktueller Zeitpunkt.
+ * @param expired Vektor, an den die Handles der abgelaufenen Timer angehängt werden.
+ */
+void TimerWheel::advance(Clock::time_point now, std::vector<NodeHandle>& expired)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Nur vollständig vergangene Ticks abarbeiten, damit kein Timer zu früh abläuft
+    uint64_t target = (now > m_start) ? static_cast<uint64_t>((now - m_start) / m_tick) : 0;
+    Slot pending;
+
+    while (m_currentTick < target)
+    {
+        ++m_currentTick;
+
+        // Fächer höherer Ebenen verteilen, sobald ihr Zeitraum beginnt
+        for (size_t level = 1; level < Levels; ++level)
+        {
+            if ((m_currentTick & ((uint64_t(1) << (SlotBits * level)) - 1)) != 0)
+                break;
+
+            pending.clear();
+            pending.swap(m_levels[level][(m_currentTick >> (SlotBits * level)) & (SlotsPerLevel - 1)]);
+
+            for (const Item& item : pending)
+            {
+                if (isCurrent(item))
+                    place(item, std::max(m_entries[item.handle].wheelTick, m_currentTick));
+            }
+        }
+
+        pending.clear();
+        pending.swap(m_levels[0][m_currentTick & (SlotsPerLevel - 1)]);
+
+        for (const Item& item : pending)
+        {
+            if (!isCurrent(item))
+                continue;
+
+            Entry& entry = m_entries[item.handle];
+            if (entry.deadlineTick <= m_currentTick)
+            {
+                entry.armed = false;
+                expired.push_back(item.handle);
+            }
+            else
+            {
+                // Frist wurde zwischenzeitlich verlängert
+                entry.wheelTick = entry.deadlineTick;
+                place(item, entry.deadlineTick);
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "NodeRegistry.hpp"
+
+#include <array>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Hierarchisches Timer-Rad für Zeitüberschreitungen pro Knoten.
+ *
+ * Jeder Knoten besitzt höchstens einen Timer. Das Rad besteht aus mehreren Ebenen mit je
+ * SlotsPerLevel Fächern, Ebene 0 hat die Auflösung eines Ticks, jede weitere Ebene die
+ * SlotsPerLevel-fache. Timer in höheren Ebenen werden beim Erreichen ihres Fachs in die
+ * darunterliegende Ebene verschoben, sodass advance() nur die tatsächlich fälligen Timer anfasst.
+ *
+ * Ein erneutes schedule() mit späterer Frist verschiebt den Timer nicht, sondern speichert nur
+ * die neue Frist. Erst wenn das Fach fällig wird, wird der Timer an der neuen Frist wieder
+ * einsortiert. Dadurch kostet das Verlängern nur eine Zuweisung.
+ *
+ * Alle Methoden sind threadsicher.
+ */
+class TimerWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t SlotBits = 6;
+    static constexpr size_t SlotsPerLevel = size_t(1) << SlotBits;
+    static constexpr size_t Levels = 4;
+
+    explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(250));
+
+    TimerWheel(TimerWheel const&) = delete;
+    void operator=(TimerWheel const&) = delete;
+
+    /* Zieht den Timer des Knotens auf die gegebene Frist auf bzw. neu auf */
+    void schedule(NodeHandle handle, Clock::time_point deadline);
+
+    /* Entfernt den Timer des Knotens */
+    void cancel(NodeHandle handle);
+
+    /* Gibt True zurück wenn für den Knoten ein Timer läuft */
+    bool isArmed(NodeHandle handle) const;
+
+    /* Schaltet das Rad bis now weiter und hängt die Handles der abgelaufenen Timer an expired an */
+    void advance(Clock::time_point now, std::vector<NodeHandle>& expired);
+
+    /* Auflösung des Rads */
+    Clock::duration tick() const { return m_tick; }
+
+private:
+    /**
+     * Zustand des Timers eines Knotens.
+     */
+    struct Entry
+    {
+        uint64_t deadlineTick = 0;      ///< Tatsächliche Frist.
+        uint64_t wheelTick = 0;         ///< Tick, an dem der Timer im Rad einsortiert ist.
+        uint32_t generation = 0;        ///< Wird bei jedem Einsortieren erhöht, ältere Einträge in den Fächern sind ungültig.
+        bool armed = false;
+    };
+
+    /**
+     * Eintrag in einem Fach des Rads.
+     */
+    struct Item
+    {
+        NodeHandle handle;
+        uint32_t generation;
+    };
+
+    using Slot = std::vector<Item>;
+
+    uint64_t tickOf(Clock::time_point time) const;
+    void place(Item item, uint64_t tick);
+    bool isCurrent(Item const& item) const;
+
+    Clock::duration m_tick;
+    Clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    uint64_t m_currentTick = 0;
+    std::vector<Entry> m_entries;                                           ///< Indiziert über das Handle.
+    std::array<std::array<Slot, SlotsPerLevel>, Levels> m_levels;
+};
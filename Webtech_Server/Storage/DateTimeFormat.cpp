@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "DateTimeFormat.hpp"
+
+namespace
+{
+    /**
+     * Zuletzt formatierte Stunde eines Threads. Innerhalb der Stunde ändern sich nur Minuten und
+     * Sekunden, die ohne localtime_r() aus dem Abstand zum Stundenbeginn berechnet werden.
+     */
+    struct HourCache
+    {
+        time_t hourStart = 0;       ///< Beginn der lokalen Stunde als Unix-Zeit.
+        time_t validFrom = 1;       ///< Bereich, für den prefix gilt; anfangs leer.
+        time_t validUntil = 0;
+        char prefix[14];            ///< "YYYY-MM-DD HH:"
+    };
+
+    thread_local HourCache t_hourCache;
+
+    void writeTwoDigits(char* out, unsigned value)
+    {
+        out[0] = static_cast<char>('0' + value / 10);
+        out[1] = static_cast<char>('0' + value % 10);
+    }
+}
+
+/**
+ * Wandelt einen Zeitpunkt in lokale Zeit um. Im Gegensatz zu std::localtime wird kein gemeinsamer
+ * statischer Puffer verwendet, der Aufruf ist daher aus mehreren Threads möglich.
+ *
+ * @param time Der Zeitpunkt.
+ * @return std::tm Die lokale Zeit.
+ */
+std::tm toLocalTime(time_t time)
+{
+    std::tm tm{};
+    localtime_r(&time, &tm);
+    return tm;
+}
+
+/**
+ * Formatiert einen Zeitpunkt als "YYYY-MM-DD HH:MM:SS" in lokaler Zeit, wie es MySQL für DATETIME erwartet.
+ *
+ * localtime_r() liest die Zeitzone und sperrt dabei intern, daher wird je Thread die zuletzt
+ * formatierte Stunde zwischengespeichert und nur beim Wechsel der Stunde neu berechnet. Liegt in
+ * der Stunde eine Zeitumstellung, gilt der Zwischenspeicher nur für die angefragte Sekunde.
+ *
+ * @param time Der Zeitpunkt.
+ * @param buffer Erhält den Text mit abschließender Null.
+ */
+void formatLocalDateTime(time_t time, char (&buffer)[DateTimeBufferSize])
+{
+    HourCache& cache = t_hourCache;
+
+    if (time < cache.validFrom || time >= cache.validUntil)
+    {
+        const std::tm tm = toLocalTime(time);
+        cache.hourStart = time - (tm.tm_min * 60 + tm.tm_sec);
+
+        // Die Stunde nur als Ganzes übernehmen, wenn der Versatz zu UTC bis zu ihrem Ende gleich bleibt
+        const std::tm last = toLocalTime(cache.hourStart + 3599);
+        if (last.tm_gmtoff == tm.tm_gmtoff && last.tm_hour == tm.tm_hour)
+        {
+            cache.validFrom = cache.hourStart;
+            cache.validUntil = cache.hourStart + 3600;
+        }
+        else
+        {
+            cache.validFrom = time;
+            cache.validUntil = time + 1;
+        }
+
+        char prefix[32];
+        std::snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour);
+        std::memcpy(cache.prefix, prefix, sizeof(cache.prefix));
+    }
+
+    const unsigned secondsInHour = static_cast<unsigned>(time - cache.hourStart);
+
+    std::memcpy(buffer, cache.prefix, sizeof(cache.prefix));
+    writeTwoDigits(buffer + 14, secondsInHour / 60);
+    buffer[16] = ':';
+    writeTwoDigits(buffer + 17, secondsInHour % 60);
+    buffer[19] = '\0';
+}
@@ -0,0 +1,18 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+/**
+ * Größe des Puffers für "YYYY-MM-DD HH:MM:SS" inklusive abschließender Null.
+ */
+static constexpr size_t DateTimeBufferSize = 20;
+
+/* Threadsichere Variante von std::localtime */
+std::tm toLocalTime(time_t time);
+
+/* Formatiert den Zeitpunkt als "YYYY-MM-DD HH:MM:SS" in lokaler Zeit, threadsicher und ohne Sperre */
+void formatLocalDateTime(time_t time, char (&buffer)[DateTimeBufferSize]);
@@ -0,0 +1,266 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "MemoryBackend.hpp"
+#include "../MySQL/NodeDataWriter.hpp"
+
+/**
+ * Gibt die Status-Spalte eines Knotens zurück.
+ *
+ * @param row Die Zeile des Knotens.
+ * @param column "online" oder "allowed".
+ * @return bool* Zeiger auf die Spalte oder nullptr, wenn die Spalte unbekannt ist.
+ */
+bool* MemoryBackend::statusColumn(NodeRow& row, const std::string& column)
+{
+    if (column == "online")
+        return &row.online;
+    if (column == "allowed")
+        return &row.allowed;
+
+    std::cerr << "Error: Unknown node status column '" << column << "'" << std::endl;
+    return nullptr;
+}
+
+/**
+ * Lädt alle Knoten in die Registry und setzt sie offline. Wartende Audit-Einträge werden verworfen.
+ *
+ * @param registry Die Registry, in die die Knoten geladen werden.
+ * @return bool Immer true.
+ */
+bool MemoryBackend::loadNodes(NodeRegistry& registry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_audit.clear();
+
+    for (auto& [id, row] : m_nodes)
+    {
+        registry.load(id, row.allowed, row.lastSeen);
+        row.online = false;
+    }
+
+    std::cout << "Loaded " << m_nodes.size() << " Nodes" << std::endl;
+    return true;
+}
+
+/**
+ * Legt einen Knoten an, ein vorhandener Knoten bleibt unverändert.
+ *
+ * @param id ID des Knotens.
+ * @return bool Immer true.
+ */
+bool MemoryBackend::upsertNode(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nodes.try_emplace(id);
+    return true;
+}
+
+/**
+ * Löscht einen Knoten und seinen letzten Messwert.
+ *
+ * @param id ID des Knotens.
+ * @return bool Immer true, auch wenn der Knoten nicht existiert hat.
+ */
+bool MemoryBackend::deleteNode(const std::string& id)
+{
+    {
+        DataStripe& stripe = stripeFor(id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.latest.erase(id);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_nodes.erase(id);
+    return true;
+}
+
+/**
+ * Setzt eine Status-Spalte eines Knotens.
+ *
+ * @param id ID des Knotens.
+ * @param column "online" oder "allowed".
+ * @param status Neuer Statuswert.
+ */
+void MemoryBackend::updateNodeStatus(const std::string& id, const std::string& column, bool status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_nodes.find(id);
+    if (it == m_nodes.end())
+        return;
+
+    if (bool* value = statusColumn(it->second, column))
+        *value = status;
+}
+
+/**
+ * Setzt eine Status-Spalte mehrerer Knoten.
+ *
+ * @param ids IDs der Knoten.
+ * @param column "online" oder "allowed".
+ * @param status Neuer Statuswert.
+ */
+void MemoryBackend::updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (std::string_view id : ids)
+    {
+        auto it = m_nodes.find(id);
+        if (it == m_nodes.end())
+            continue;
+
+        if (bool* value = statusColumn(it->second, column))
+            *value = status;
+    }
+}
+
+/**
+ * Setzt eine Status-Spalte aller Knoten.
+ *
+ * @param column "online" oder "allowed".
+ * @param status Neuer Statuswert.
+ */
+void MemoryBackend::updateAllNodesStatus(const std::string& column, bool status)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& [id, row] : m_nodes)
+    {
+        if (bool* value = statusColumn(row, column))
+            *value = status;
+    }
+}
+
+/**
+ * Übernimmt lastSeen mehrerer Knoten. Gelöschte Knoten werden nicht neu angelegt.
+ *
+ * @param entries Die geänderten Knoten mit ihrem lastSeen.
+ * @return bool Immer true.
+ */
+bool MemoryBackend::updateLastSeen(const std::vector<LastSeenEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const LastSeenEntry& entry : entries)
+    {
+        auto it = m_nodes.find(entry.id);
+        if (it != m_nodes.end())
+            it->second.lastSeen = entry.lastSeen;
+    }
+
+    return true;
+}
+
+/**
+ * Zählt die Messwerte als Zeilen der Historie und ersetzt den letzten Messwert je Knoten,
+ * sofern der neue Messwert nicht älter ist (wie node_data in MySQL).
+ *
+ * @param writerIndex Index des Schreib-Threads, wird nicht benötigt.
+ * @param batch Die zu schreibenden Messwerte.
+ * @return AppendResult Immer Committed.
+ */
+AppendResult MemoryBackend::appendNodeData(size_t /*writerIndex*/, std::vector<NodeDataRecord>& batch)
+{
+    for (const NodeDataRecord& record : batch)
+    {
+        DataStripe& stripe = stripeFor(record.id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+
+        auto it = stripe.latest.find(record.id);
+        if (it == stripe.latest.end())
+            stripe.latest.emplace(std::string(record.id), record.data);
+        else if (record.data.timeStamp >= it->second.timeStamp)
+            it->second = record.data;
+    }
+
+    m_historyRows.fetch_add(batch.size(), std::memory_order_relaxed);
+    return AppendResult::Committed;
+}
+
+/**
+ * Gibt die hinterlegten Audit-Einträge zurück und entfernt sie.
+ *
+ * @param entries Erhält die Einträge in der Reihenfolge, in der sie hinterlegt wurden.
+ * @return bool Immer true.
+ */
+bool MemoryBackend::fetchAudit(std::vector<AuditEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    entries = std::move(m_audit);
+    m_audit.clear();
+
+    // Die Webseite ändert die Freigabe in der Tabelle selbst, bevor sie den Eintrag hinterlegt
+    for (const AuditEntry& entry : entries)
+    {
+        auto it = m_nodes.find(entry.nodeId);
+        if (it != m_nodes.end())
+            it->second.allowed = entry.allowed;
+    }
+
+    return true;
+}
+
+/**
+ * Hinterlegt eine Änderung der Freigabe, wie es die Webseite über die Tabelle audit tut.
+ *
+ * @param nodeId ID des Knotens.
+ * @param allowed Neue Freigabe.
+ */
+void MemoryBackend::addAuditEntry(std::string nodeId, bool allowed)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_audit.push_back(AuditEntry{ std::move(nodeId), allowed });
+}
+
+/**
+ * Liest die Zeile eines Knotens.
+ *
+ * @param id ID des Knotens.
+ * @param row Erhält die Zeile.
+ * @return bool Gibt false zurück, wenn der Knoten nicht existiert.
+ */
+bool MemoryBackend::getNode(std::string_view id, NodeRow& row) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_nodes.find(id);
+    if (it == m_nodes.end())
+        return false;
+
+    row = it->second;
+    return true;
+}
+
+/**
+ * Liest den letzten Messwert eines Knotens.
+ *
+ * @param id ID des Knotens.
+ * @param data Erhält den Messwert.
+ * @return bool Gibt false zurück, wenn für den Knoten noch kein Messwert geschrieben wurde.
+ */
+bool MemoryBackend::getNodeData(std::string_view id, NodeData& data) const
+{
+    DataStripe& stripe = stripeFor(id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    auto it = stripe.latest.find(id);
+    if (it == stripe.latest.end())
+        return false;
+
+    data = it->second;
+    return true;
+}
+
+/**
+ * Gibt die Anzahl der Knoten zurück.
+ */
+size_t MemoryBackend::nodeCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nodes.size();
+}
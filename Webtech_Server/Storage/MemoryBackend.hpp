@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "StorageBackend.hpp"
+
+#include <array>
+#include <atomic>
+#include <unordered_map>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Speicherung nur im Arbeitsspeicher, ohne Datenbank.
+ *
+ * Gedacht für Benchmarks und Versuche ohne MySQL-Server: Knoten, Status und der letzte Messwert
+ * je Knoten werden in Hash-Tabellen gehalten, von der Historie wird nur die Anzahl der Zeilen
+ * gezählt. Nach dem Beenden ist alles verloren.
+ *
+ * Die Knoten-Tabelle ist mit einem Mutex geschützt, die letzten Messwerte sind nach der ID auf
+ * Streifen mit eigenem Mutex verteilt, damit mehrere Schreib-Threads parallel arbeiten können.
+ */
+class MemoryBackend : public StorageBackend
+{
+public:
+    /**
+     * Eine Zeile der Knoten-Tabelle.
+     */
+    struct NodeRow
+    {
+        bool allowed = false;
+        bool online = false;
+        time_t lastSeen = 0;
+    };
+
+    MemoryBackend() = default;
+
+    const char* name() const override { return "memory"; }
+
+    bool open() override { return true; }
+    bool openWriters(size_t, size_t) override { return true; }
+    void closeWriters() override { }
+
+    bool loadNodes(NodeRegistry& registry) override;
+    bool upsertNode(const std::string& id) override;
+    bool deleteNode(const std::string& id) override;
+
+    void updateNodeStatus(const std::string& id, const std::string& column, bool status) override;
+    void updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status) override;
+    void updateAllNodesStatus(const std::string& column, bool status) override;
+    bool updateLastSeen(const std::vector<LastSeenEntry>& entries) override;
+
+    AppendResult appendNodeData(size_t writerIndex, std::vector<NodeDataRecord>& batch) override;
+    bool fetchAudit(std::vector<AuditEntry>& entries) override;
+
+    /* Hinterlegt eine Änderung der Freigabe wie die Webseite, wird mit dem nächsten fetchAudit() gelesen */
+    void addAuditEntry(std::string nodeId, bool allowed);
+
+    /* Liest die Zeile eines Knotens, false wenn er nicht existiert */
+    bool getNode(std::string_view id, NodeRow& row) const;
+
+    /* Liest den letzten Messwert eines Knotens, false wenn noch keiner geschrieben wurde */
+    bool getNodeData(std::string_view id, NodeData& data) const;
+
+    /* Anzahl der Knoten */
+    size_t nodeCount() const;
+
+    /* Anzahl der bisher angehängten Zeilen der Historie */
+    uint64_t historyRows() const { return m_historyRows.load(std::memory_order_relaxed); }
+
+private:
+    /**
+     * Hash für std::string und std::string_view, damit ohne Kopie der ID gesucht werden kann.
+     */
+    struct IdHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view id) const { return std::hash<std::string_view>{}(id); }
+    };
+
+    template<typename T>
+    using IdMap = std::unordered_map<std::string, T, IdHash, std::equal_to<>>;
+
+    /**
+     * Ein Streifen der letzten Messwerte.
+     */
+    struct DataStripe
+    {
+        mutable std::mutex mutex;
+        IdMap<NodeData> latest;
+    };
+
+    static constexpr size_t DataStripeCount = 16;
+
+    /* Gibt die Status-Spalte des Knotens zurück, nullptr bei unbekannter Spalte */
+    static bool* statusColumn(NodeRow& row, const std::string& column);
+
+    DataStripe& stripeFor(std::string_view id) const { return m_dataStripes[IdHash{}(id) % DataStripeCount]; }
+
+    mutable std::mutex m_mutex;     ///< Schützt m_nodes und m_audit.
+    IdMap<NodeRow> m_nodes;
+    std::vector<AuditEntry> m_audit;
+
+    mutable std::array<DataStripe, DataStripeCount> m_dataStripes;
+    std::atomic<uint64_t> m_historyRows{ 0 };
+};
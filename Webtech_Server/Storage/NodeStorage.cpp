@@ -0,0 +1,785 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "NodeStorage.hpp"
+#include "../Metrics/Metrics.hpp"
+#include "../Metrics/IngestLatency.hpp"
+#include "../Logging/Logger.hpp"
+
+namespace
+{
+    /**
+     * Histogramm für die Laufzeit einer Anweisung, inklusive Wiederholungen nach Verbindungsabbrüchen.
+     *
+     * @param statement Kurzname der Anweisung, wird als Label ausgegeben.
+     */
+    Histogram& statementLatency(const char* statement)
+    {
+        return sMetrics.histogram("webtech_db_statement_seconds", "Time spent executing database statements", { { "statement", statement } });
+    }
+}
+
+/**
+ * Standard-Konstruktor initialisiert die Mitgliedsvariablen für NodeStorage.
+ */
+NodeStorage::NodeStorage()
+{
+    for (size_t i = 0; i < mNodeRegistry.shardCount(); ++i)
+        m_shardMutexes.push_back(std::make_unique<std::mutex>());
+}
+
+/**
+ * Destruktor, der für das Freigeben von zugewiesenen Ressourcen verantwortlich ist.
+ */
+NodeStorage::~NodeStorage()
+{
+    disconnect();
+}
+
+/**
+ * Öffnet das Backend, lädt alle Knoten und startet die Schreib-Threads für die Messwerte.
+ *
+ * @return bool Gibt true zurück, wenn das Backend geöffnet werden konnte, sonst false.
+ */
+bool NodeStorage::connect()
+{
+    if (!m_backend)
+    {
+        std::cerr << "Error: No storage backend configured" << std::endl;
+        return false;
+    }
+
+    if (!m_backend->open())
+        return false;
+
+    m_connected = true;
+
+    // Lädt alle Knoten aus der Datenbank
+    fetchAllNodesFromDatabase();
+
+    // Legt die Historientabelle samt Partitionen an, bevor die ersten Messwerte geschrieben werden
+    maintainNodeDataHistory();
+
+    // Messwerte, die nicht geschrieben werden können, landen im Spool aus setWriterConfig() statt verloren zu gehen
+    m_nodeDataWriter = std::make_unique<NodeDataWriter>(m_writerConfig,
+        [this](size_t workerIndex, std::vector<NodeDataRecord>& batch)
+        {
+            return writeNodeDataBatch(workerIndex, batch);
+        });
+
+    // Startet die Schreib-Threads für die Messwerte, jeder mit eigener Verbindung
+    if (!m_backend->openWriters(m_nodeDataWriter->handlerCount(), m_writerConfig.batchSize))
+    {
+        m_nodeDataWriter.reset();
+        return false;
+    }
+
+    m_nodeDataWriter->start();
+
+    // Werden beim Abruf von /metrics bestimmt. Der MetricsServer muss vor disconnect() beendet werden,
+    // da der NodeDataWriter dort freigegeben wird
+    sMetrics.gaugeCallback("webtech_writer_queue_depth", "Readings waiting in the NodeDataWriter lanes",
+        [this] { return static_cast<double>(m_nodeDataWriter->queueDepth()); });
+    sMetrics.gaugeCallback("webtech_spool_active", "1 while new readings are diverted to the telemetry spool",
+        [this] { return m_nodeDataWriter->isSpooling() ? 1.0 : 0.0; });
+    sMetrics.gaugeCallback("webtech_nodes_online", "Nodes currently marked online",
+        [this] { return static_cast<double>(m_onlineNodes.load(std::memory_order_relaxed)); });
+    sMetrics.gaugeCallback("webtech_nodes_registered", "Nodes held in the NodeRegistry",
+        [this] { return static_cast<double>(mNodeRegistry.size()); });
+
+    std::cout << "Storage: using " << m_backend->name() << " backend" << std::endl;
+    return true;
+}
+
+/**
+ * Schreibt alle noch wartenden Messwerte in das Backend und beendet die Schreib-Threads.
+ */
+void NodeStorage::disconnect()
+{
+    if (m_nodeDataWriter)
+    {
+        m_nodeDataWriter->stop();
+        m_nodeDataWriter.reset();
+    }
+
+    if (m_backend)
+        m_backend->closeWriters();
+}
+
+/**
+ * Fügt einen Knoten zur Datenbank hinzu oder aktualisiert ihn, wenn er bereits existiert.
+ *
+ * @param id ID des hinzuzufügenden oder zu aktualisierenden Knotens.
+ * @return NodeHandle Handle des Knotens oder InvalidNodeHandle, wenn das Schreiben fehlgeschlagen ist.
+ */
+NodeHandle NodeStorage::addNode(std::string id)
+{
+    std::lock_guard<std::mutex> lock(*m_shardMutexes[mNodeRegistry.shardOf(id)]);
+
+    if (!m_connected)
+        return InvalidNodeHandle;
+
+    static Histogram& latency = statementLatency("add_node");
+    ScopedLatency timer(latency);
+
+    if (!m_backend->upsertNode(id))
+        return InvalidNodeHandle;
+
+    return addNodeToContainer(id);
+}
+
+/**
+ * Entfernt einen Knoten aus der Datenbank.
+ *
+ * @param id ID des zu löschenden Knotens.
+ */
+void NodeStorage::deleteNode(std::string id)
+{
+    std::lock_guard<std::mutex> lock(*m_shardMutexes[mNodeRegistry.shardOf(id)]);
+
+    if (!m_connected)
+        return;
+
+    if (m_backend->deleteNode(id))
+        removeNodeFromContainer(id);
+}
+
+/**
+ * Aktualisiert die Daten eines Knotens in der Datenbank.
+ * Der Messwert wird nur eingereiht und anschließend vom NodeDataWriter gesammelt geschrieben.
+ *
+ * @param node Handle des zu aktualisierenden Knotens.
+ * @param data NodeData Struktur mit den zu aktualisierenden Daten für den Knoten.
+ */
+void NodeStorage::updateNodeData(NodeHandle node, NodeData data, bool forceData)
+{
+    // Setzt den Zeitstempel für den letzten Update-Vorgang
+    setLastSeen(node);
+
+    bool allowed = false;
+    std::string_view id;
+
+    if (mNodeRegistry.visit(node, [&](Node& it) { allowed = it.allowed; id = it.id; }))
+    {
+        if (allowed || forceData)
+        {
+            // Reiht den Messwert für die Schreib-Threads ein, das Schreiben erfolgt gesammelt
+            if (m_nodeDataWriter)
+                m_nodeDataWriter->enqueue(NodeDataRecord{ node, id, data });
+        }
+        else
+        {
+            static LogKey& notAllowed = sLog.key("node_not_allowed", LogLevel::Error);
+            sLog.write(notAllowed, "Error: Node ", id, " Not Allowed to Save Data");
+        }
+    }
+    else
+    {
+        static LogKey& notFound = sLog.key("node_not_found", LogLevel::Error);
+        sLog.write(notFound, "Error: Node with handle ", node, " not found in container.");
+    }
+}
+
+/**
+ * Aktualisiert die Daten eines Knotens mit mehreren Messwerten, z.B. aus einer Batch-Nachricht
+ * oder nach einem Verbindungsabbruch des Knotens. Die Messwerte werden zusammen eingereiht und in
+ * einem Durchlauf des NodeDataWriter geschrieben.
+ *
+ * @param node Handle des zu aktualisierenden Knotens.
+ * @param readings Die Messwerte in der Reihenfolge ihrer Aufnahme.
+ */
+void NodeStorage::updateNodeData(NodeHandle node, const std::vector<NodeData>& readings, bool forceData)
+{
+    if (readings.empty())
+        return;
+
+    // Setzt den Zeitstempel für den letzten Update-Vorgang
+    setLastSeen(node);
+
+    bool allowed = false;
+    std::string_view id;
+
+    if (mNodeRegistry.visit(node, [&](Node& it) { allowed = it.allowed; id = it.id; }))
+    {
+        if (allowed || forceData)
+        {
+            if (m_nodeDataWriter)
+            {
+                std::vector<NodeDataRecord> records;
+                records.reserve(readings.size());
+                for (const NodeData& data : readings)
+                    records.push_back(NodeDataRecord{ node, id, data });
+
+                m_nodeDataWriter->enqueue(std::move(records));
+            }
+        }
+        else
+        {
+            static LogKey& notAllowed = sLog.key("node_not_allowed", LogLevel::Error);
+            sLog.write(notAllowed, "Error: Node ", id, " Not Allowed to Save Data");
+        }
+    }
+    else
+    {
+        static LogKey& notFound = sLog.key("node_not_found", LogLevel::Error);
+        sLog.write(notFound, "Error: Node with handle ", node, " not found in container.");
+    }
+}
+
+/**
+ * Übergibt die gesammelten Messwerte an das Backend und erfasst danach Anzahl und Latenz.
+ * Wird auf dem jeweiligen Schreib-Thread aufgerufen. Verworfene Batches werden nur in
+ * webtech_db_node_data_dropped_total gezählt, nicht als geschriebene Zeilen.
+ *
+ * @param workerIndex Index des Schreib-Threads, bestimmt die verwendete Verbindung.
+ * @param batch Die zu schreibenden Messwerte.
+ * @return bool Gibt false zurück, wenn die Datenbank vorübergehend nicht erreichbar ist und der Batch erneut geschrieben werden soll.
+ */
+bool NodeStorage::writeNodeDataBatch(size_t workerIndex, std::vector<NodeDataRecord>& batch)
+{
+    if (batch.empty())
+        return true;
+
+    static Histogram& latency = statementLatency("node_data_batch");
+    static Counter& rows = sMetrics.counter("webtech_db_node_data_rows_total", "Readings written to node_data");
+    static Counter& dropped = sMetrics.counter("webtech_db_node_data_dropped_total", "Readings dropped after a permanent database error");
+
+    auto start = std::chrono::steady_clock::now();
+    AppendResult result = m_backend->appendNodeData(workerIndex, batch);
+
+    if (result == AppendResult::Retry)
+        return false;
+
+    if (result == AppendResult::Dropped)
+    {
+        dropped.inc(batch.size());
+        return true;
+    }
+
+    latency.observe(std::chrono::steady_clock::now() - start);
+    rows.inc(batch.size());
+
+    // Messwerte aus dem Spool tragen keinen Zeitpunkt des Einreihens
+    auto committedAt = std::chrono::steady_clock::now();
+    auto committedAtSystem = std::chrono::system_clock::now();
+    for (const NodeDataRecord& record : batch)
+    {
+        if (record.queuedAt != std::chrono::steady_clock::time_point{})
+            sIngestLatency.parsedToCommitted.observe(committedAt - record.queuedAt);
+        sIngestLatency.observeNodeTime(record.data.timeStamp, committedAtSystem);
+    }
+
+    return true;
+}
+
+/**
+ * Aktualisiert den Status einer spezifischen Spalte für einen Knoten in der Datenbank.
+ *
+ * @param id ID des Knotens.
+ * @param column Name der zu aktualisierenden Spalte.
+ * @param status Neuer Statuswert.
+ */
+void NodeStorage::updateNodeStatusInDB(const std::string& id, const std::string& column, bool status)
+{
+    std::lock_guard<std::mutex> lock(*m_shardMutexes[mNodeRegistry.shardOf(id)]);
+
+    if (!m_connected)
+        return;
+
+    static Histogram& latency = statementLatency("node_status");
+    ScopedLatency timer(latency);
+
+    m_backend->updateNodeStatus(id, column, status);
+}
+
+/**
+ * Aktualisiert den Status mehrerer Knoten in der Datenbank, z.B. der in monitorLastSeen() abgelaufenen.
+ * Der Aufrufer muss den Shard der Knoten gesperrt halten, damit die Reihenfolge zu setNodeStatus() erhalten bleibt.
+ *
+ * @param ids IDs der Knoten.
+ * @param column Name der zu aktualisierenden Spalte.
+ * @param status Neuer Statuswert.
+ */
+void NodeStorage::updateNodesStatusInDB(const std::vector<std::string_view>& ids, const std::string& column, bool status)
+{
+    if (!m_connected || ids.empty())
+        return;
+
+    static Histogram& latency = statementLatency("node_status_bulk");
+    ScopedLatency timer(latency);
+
+    m_backend->updateNodesStatus(ids, column, status);
+}
+
+/**
+ * Aktualisiert den Status aller Knoten in der Datenbank.
+ *
+ * @param column Name der zu aktualisierenden Spalte.
+ * @param status Neuer Statuswert.
+ */
+void NodeStorage::updateAllNodesStatusInDB(const std::string& column, bool status)
+{
+    if (!m_connected)
+        return;
+
+    static Histogram& latency = statementLatency("node_status_bulk");
+    ScopedLatency timer(latency);
+
+    m_backend->updateAllNodesStatus(column, status);
+}
+
+/**
+ * Setzt alle Knoten auf offline. Im Speicher werden die Flags Shard für Shard zurückgesetzt und
+ * die Offline-Timer entfernt, in der Datenbank genügt eine einzige Anweisung.
+ *
+ * @param saveToDB Flag, um zu bestimmen, ob der Status in der Datenbank gespeichert werden soll.
+ */
+void NodeStorage::setAllNodesOffline(bool saveToDB)
+{
+    mNodeRegistry.forEach([&](NodeHandle handle, Node& node)
+        {
+            if (node.online)
+            {
+                node.online = false;
+                m_onlineNodes.fetch_sub(1, std::memory_order_relaxed);
+            }
+            m_offlineTimers.cancel(handle);
+        });
+
+    if (saveToDB)
+        updateAllNodesStatusInDB("online", false);
+}
+
+/**
+ * Aktualisiert den Status eines Knotens anhand der angegebenen Parameter.
+ * Der Shard bleibt bis nach dem Schreiben gesperrt, damit Statusänderungen in derselben
+ * Reihenfolge in der Datenbank landen, in der sie im Speicher erfolgt sind.
+ *
+ * @param node Handle des Knotens.
+ * @param status Neuer Statuswert.
+ * @param isOnlineUpdate Flag, um zu bestimmen, ob es sich um ein Online-Update handelt.
+ * @param saveToDB Flag, um zu bestimmen, ob der Status in der Datenbank gespeichert werden soll.
+ */
+void NodeStorage::setNodeStatus(NodeHandle node, bool status, bool isOnlineUpdate, bool saveToDB)
+{
+    static LogKey& notFound = sLog.key("node_not_found", LogLevel::Error);
+
+    if (node == InvalidNodeHandle)
+    {
+        sLog.write(notFound, "Error: Given Node Not Existant");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(*m_shardMutexes[mNodeRegistry.shardOf(node)]);
+
+    bool changed = false;
+    std::string id;
+    TimerWheel::Clock::time_point offlineDeadline;
+
+    bool found = mNodeRegistry.visit(node, [&](Node& it)
+        {
+            bool& current = isOnlineUpdate ? it.online : it.allowed;
+            if (current != status)
+            {
+                current = status;
+                changed = true;
+                id = it.id;
+
+                // Wer online geht, gilt als gerade gesehen
+                if (isOnlineUpdate && status)
+                    it.offlineDeadline = TimerWheel::Clock::now() + it.offlineTimeout;
+
+                if (isOnlineUpdate)
+                    m_onlineNodes.fetch_add(status ? 1 : -1, std::memory_order_relaxed);
+            }
+            offlineDeadline = it.offlineDeadline;
+        });
+
+    if (!found)
+    {
+        sLog.write(notFound, "Error: Node with handle ", node, " not found in container.");
+        return;
+    }
+
+    // Ein Node, der online ist, hat immer einen laufenden Timer
+    if (isOnlineUpdate && changed)
+    {
+        if (status)
+        {
+            if (!m_offlineTimers.isArmed(node))
+                m_offlineTimers.schedule(node, offlineDeadline);
+        }
+        else
+            m_offlineTimers.cancel(node);
+    }
+
+    if (!changed)
+        return;
+
+    static Histogram& latency = statementLatency("node_status");
+
+    // Aktualisiere Online-Status
+    if (isOnlineUpdate)
+    {
+        static LogKey& online = sLog.key("node_online", LogLevel::Info);
+        sLog.write(online, "Node with id: ", id, " has gone ", status ? "Online" : "Offline");
+
+        if (saveToDB && m_connected)
+        {
+            ScopedLatency timer(latency);
+            m_backend->updateNodeStatus(id, "online", status);
+        }
+    }
+    // Aktualisiere Erlaubnis-Status
+    else
+    {
+        static LogKey& allowed = sLog.key("node_allowed", LogLevel::Info);
+        sLog.write(allowed, "Node with id: ", id, " is now ", status ? "Allowed" : "NotAllowed");
+
+        if (saveToDB && m_connected)
+        {
+            ScopedLatency timer(latency);
+            m_backend->updateNodeStatus(id, "allowed", status);
+        }
+    }
+}
+
+/**
+ * Aktualisiert den Status eines Knotens anhand seiner ID.
+ *
+ * @param id ID des Knotens.
+ * @param status Neuer Statuswert.
+ * @param isOnlineUpdate Flag, um zu bestimmen, ob es sich um ein Online-Update handelt.
+ * @param saveToDB Flag, um zu bestimmen, ob der Status in der Datenbank gespeichert werden soll.
+ */
+void NodeStorage::setNodeStatus(std::string_view id, bool status, bool isOnlineUpdate, bool saveToDB)
+{
+    setNodeStatus(findNode(id), status, isOnlineUpdate, saveToDB);
+}
+
+/**
+ * Setzt den Online-Status eines Knotens in der Datenbank.
+ *
+ * @param node Handle des Knotens.
+ * @param online Boolean, der den Online-Status angibt.
+ * @param saveToDB Flag, um zu bestimmen, ob der Status in der Datenbank gespeichert werden soll.
+ */
+void NodeStorage::setNodeOnline(NodeHandle node, bool online, bool saveToDB)
+{
+    setNodeStatus(node, online, true, saveToDB);
+}
+
+/**
+ * Setzt den Online-Status eines Knotens anhand seiner ID.
+ *
+ * @param id ID des Knotens.
+ * @param online Boolean, der den Online-Status angibt.
+ * @param saveToDB Flag, um zu bestimmen, ob der Status in der Datenbank gespeichert werden soll.
+ */
+void NodeStorage::setNodeOnline(std::string_view id, bool online, bool saveToDB)
+{
+    setNodeStatus(findNode(id), online, true, saveToDB);
+}
+
+/**
+ * Setzt den aktiven Status eines Knotens in der Datenbank.
+ *
+ * @param id ID des Knotens.
+ * @param active Boolean, der den aktiven Status angibt.
+ * @param saveToDB Flag, um zu bestimmen, ob der Status in der Datenbank gespeichert werden soll.
+ */
+void NodeStorage::setNodeActive(std::string_view id, bool active, bool saveToDB)
+{
+    setNodeStatus(findNode(id), active, false, saveToDB);
+}
+
+/**
+ * Überprüft, ob einem Knoten die Berechtigung erteilt wurde (ob er erlaubt ist).
+ *
+ * @param node Handle des Knotens.
+ * @return bool Gibt true zurück, wenn der Knoten erlaubt ist, sonst false.
+ */
+bool NodeStorage::isAllowed(NodeHandle node)
+{
+    bool allowed = false;
+    if (mNodeRegistry.visit(node, [&](const Node& it) { allowed = it.allowed; }))
+    {
+        return allowed;
+    }
+    else
+    {
+        // Optional: Fehlerbehandlung, wenn der Knoten nicht im Container gefunden wurde
+        static LogKey& notFound = sLog.key("node_not_found", LogLevel::Error);
+        sLog.write(notFound, "Error: Node with handle ", node, " not found in container.");
+        return false; // Default-Wert oder werfen Sie eine Ausnahme, je nach Anwendungslogik
+    }
+}
+
+/**
+ * Überprüft periodisch und verarbeitet die Audit-Tabelle, um Knoten zu aktivieren oder zu deaktivieren.
+ */
+void NodeStorage::pollAuditTable()
+{
+    if (!m_connected)
+        return;
+
+    std::vector<AuditEntry> entries;
+
+    {
+        static Histogram& latency = statementLatency("audit_poll");
+        ScopedLatency timer(latency);
+
+        if (!m_backend->fetchAudit(entries))
+            return;
+    }
+
+    // Aktiviere oder deaktiviere die Knoten, die Webseite hat die Datenbank bereits geändert
+    for (const AuditEntry& entry : entries)
+        setNodeActive(entry.nodeId, entry.allowed, false);
+}
+
+/**
+ * Lädt alle Knoten aus dem Backend und speichert sie in der mNodeRegistry.
+ * Alle Knoten starten offline, ihre Offline-Zeit kommt aus setOfflineConfig().
+ *
+ * @return bool Gibt true zurück, wenn das Laden erfolgreich war, andernfalls false.
+ */
+bool NodeStorage::fetchAllNodesFromDatabase()
+{
+    if (!m_connected)
+        return false;
+
+    if (!m_backend->loadNodes(mNodeRegistry))
+        return false;
+
+    // Die Registry legt jeden Knoten mit DefaultNodeOfflineTimeout an, die Zeiten aus setOfflineConfig() übernehmen
+    if (m_offlineConfig.timeout != DefaultNodeOfflineTimeout || !m_offlineConfig.overrides.empty())
+        mNodeRegistry.forEach([this](NodeHandle, Node& node) { node.offlineTimeout = m_offlineConfig.timeoutOf(node.id); });
+
+    return true;
+}
+
+/**
+ * Fügt einen neuen Knoten zur mNodeRegistry hinzu, wenn er nicht bereits existiert.
+ * Ein neuer Knoten erhält seine Offline-Zeit aus setOfflineConfig().
+ *
+ * @param id ID des hinzuzufügenden Knotens.
+ * @return NodeHandle Handle des neuen oder bereits vorhandenen Knotens.
+ */
+NodeHandle NodeStorage::addNodeToContainer(std::string_view id)
+{
+    bool inserted = false;
+    NodeHandle node = mNodeRegistry.insert(id, &inserted);
+
+    if (inserted)
+        setOfflineTimeout(node, m_offlineConfig.timeoutOf(id));
+
+    return node;
+}
+
+/**
+ * Aktualisiert das "lastSeen"-Datum eines Knotens im Container.
+ * Der Knoten wird nur als geändert markiert, das Schreiben in die Datenbank übernimmt flushLastSeen().
+ *
+ * Die neue Offline-Frist wird nur am Knoten gespeichert, während sein Shard ohnehin gesperrt ist.
+ * Das TimerWheel mit seinem gemeinsamen Mutex wird bei einer Meldung nicht angefasst, erst
+ * monitorLastSeen() zieht den Timer beim Ablauf bis zu dieser Frist nach.
+ *
+ * @param node Handle des Knotens, dessen Datum aktualisiert werden soll.
+ */
+void NodeStorage::setLastSeen(NodeHandle node)
+{
+    time_t lastSeen = std::time(nullptr);
+    TimerWheel::Clock::time_point now = TimerWheel::Clock::now();
+
+    mNodeRegistry.visit(node, [&](Node& it)
+        {
+            it.lastSeen = lastSeen;
+            it.lastSeenDirty = true;
+            it.offlineDeadline = now + it.offlineTimeout;
+        });
+}
+
+/**
+ * Setzt die Zeit, nach der ein Knoten ohne Meldung als offline gilt.
+ * Die Frist läuft ab jetzt mit der neuen Zeit, ein laufender Timer wird bei einer kürzeren Zeit vorgezogen.
+ *
+ * @param node Handle des Knotens.
+ * @param timeout Zeit ohne Meldung bis offline.
+ */
+void NodeStorage::setOfflineTimeout(NodeHandle node, std::chrono::seconds timeout)
+{
+    TimerWheel::Clock::time_point deadline = TimerWheel::Clock::now() + timeout;
+
+    bool found = mNodeRegistry.visit(node, [&](Node& it)
+        {
+            it.offlineTimeout = timeout;
+            it.offlineDeadline = deadline;
+        });
+
+    if (found && m_offlineTimers.isArmed(node))
+        m_offlineTimers.schedule(node, deadline);
+}
+
+/**
+ * Schreibt die "lastSeen"-Daten aller seit dem letzten Aufruf gesehenen Knoten in die Datenbank.
+ * Die geänderten Knoten werden Shard für Shard gesammelt und mit einem Aufruf des Backends je Shard geschrieben.
+ * Schlägt das Schreiben fehl, werden die Knoten erneut markiert und beim nächsten Aufruf geschrieben.
+ */
+void NodeStorage::flushLastSeen()
+{
+    if (!m_connected)
+        return;
+
+    std::vector<NodeHandle> handles;
+    std::vector<LastSeenEntry> pending;
+
+    for (size_t shardIndex = 0; shardIndex < mNodeRegistry.shardCount(); ++shardIndex)
+    {
+        // Sammelt die geänderten Knoten und setzt ihre Markierung zurück
+        handles.clear();
+        pending.clear();
+        mNodeRegistry.forEachInShard(shardIndex, [&](NodeHandle handle, Node& node)
+            {
+                if (node.lastSeenDirty)
+                {
+                    handles.push_back(handle);
+                    pending.push_back(LastSeenEntry{ node.id, node.lastSeen });
+                    node.lastSeenDirty = false;
+                }
+            });
+
+        if (pending.empty())
+            continue;
+
+        static Histogram& latency = statementLatency("last_seen_flush");
+        ScopedLatency timer(latency);
+
+        if (!m_backend->updateLastSeen(pending))
+        {
+            for (NodeHandle handle : handles)
+                mNodeRegistry.visit(handle, [](Node& it) { it.lastSeenDirty = true; });
+        }
+    }
+}
+
+/**
+ * Wartung der Historie über das Backend, läuft höchstens einmal pro maintenanceInterval.
+ * Weitere Aufrufe kehren sofort zurück.
+ */
+void NodeStorage::maintainNodeDataHistory()
+{
+    if (!m_connected)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_maintenanceMutex);
+
+        auto now = std::chrono::steady_clock::now();
+        if (m_lastHistoryMaintenance != std::chrono::steady_clock::time_point{} &&
+            now - m_lastHistoryMaintenance < m_historyConfig.maintenanceInterval)
+            return;
+
+        m_lastHistoryMaintenance = now;
+    }
+
+    static Histogram& latency = statementLatency("history_maintenance");
+    ScopedLatency timer(latency);
+
+    m_backend->maintainHistory(m_historyConfig);
+}
+
+/**
+ * Entfernt einen Knoten aus der mNodeRegistry.
+ *
+ * @param id ID des zu entfernenden Knotens.
+ */
+void NodeStorage::removeNodeFromContainer(std::string_view id)
+{
+    NodeHandle node = mNodeRegistry.find(id);
+
+    mNodeRegistry.visit(node, [&](Node& it)
+        {
+            if (it.online)
+            {
+                it.online = false;
+                m_onlineNodes.fetch_sub(1, std::memory_order_relaxed);
+            }
+        });
+
+    m_offlineTimers.cancel(node);
+    mNodeRegistry.remove(node);
+}
+
+/**
+ * Überwacht den Online-Status der Knoten über das TimerWheel.
+ * Jeder Knoten, der online ist, besitzt einen Timer. Es werden nur die Knoten angefasst, deren
+ * Timer abgelaufen ist. Hat ein Knoten seit dem Aufziehen gemeldet, liegt seine Node::offlineDeadline
+ * später und der Timer wird bis dorthin neu aufgezogen, sonst wird er als offline markiert.
+ *
+ * Die abgelaufenen Knoten werden nach Shard gruppiert und je Shard mit einer Anweisung in die
+ * Datenbank geschrieben. Der Shard bleibt dabei wie in setNodeStatus() bis nach dem Schreiben
+ * gesperrt, damit eine gleichzeitige Online-Meldung nicht überschrieben wird.
+ *
+ * @param now Aktueller Zeitpunkt, die Benchmarks stellen die Uhr damit selbst weiter.
+ */
+void NodeStorage::monitorLastSeen(TimerWheel::Clock::time_point now)
+{
+    std::vector<NodeHandle> expired;
+    m_offlineTimers.advance(now, expired);
+
+    if (expired.empty())
+        return;
+
+    std::ranges::sort(expired, {}, [this](NodeHandle handle) { return mNodeRegistry.shardOf(handle); });
+
+    static LogKey& online = sLog.key("node_online", LogLevel::Info);
+    std::vector<std::string_view> ids;
+
+    for (auto begin = expired.begin(); begin != expired.end();)
+    {
+        const size_t shardIndex = mNodeRegistry.shardOf(*begin);
+        auto end = std::find_if(begin, expired.end(), [&](NodeHandle handle) { return mNodeRegistry.shardOf(handle) != shardIndex; });
+
+        std::lock_guard<std::mutex> lock(*m_shardMutexes[shardIndex]);
+
+        ids.clear();
+        for (; begin != end; ++begin)
+        {
+            NodeHandle handle = *begin;
+
+            // Der Node ist seit dem Ablauf offline und wieder online gegangen, dabei wurde ein neuer Timer aufgezogen
+            if (m_offlineTimers.isArmed(handle))
+                continue;
+
+            TimerWheel::Clock::time_point deadline{};
+            mNodeRegistry.visit(handle, [&](Node& node)
+                {
+                    if (!node.online)
+                        return;
+
+                    // Meldungen seit dem Aufziehen haben nur die Frist verlängert
+                    if (node.offlineDeadline > now)
+                    {
+                        deadline = node.offlineDeadline;
+                        return;
+                    }
+
+                    node.online = false;
+                    m_onlineNodes.fetch_sub(1, std::memory_order_relaxed);
+
+                    // Die ID bleibt gültig, solange der Shard gesperrt ist
+                    ids.push_back(node.id);
+                });
+
+            if (deadline != TimerWheel::Clock::time_point{})
+                m_offlineTimers.schedule(handle, deadline);
+        }
+
+        for (std::string_view id : ids)
+            sLog.write(online, "Node with id: ", id, " has gone Offline");
+
+        updateNodesStatusInDB(ids, "online", false);
+    }
+}
@@ -0,0 +1,186 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+
+#include "StorageBackend.hpp"
+#include "../MySQL/NodeRegistry.hpp"
+#include "../MySQL/TimerWheel.hpp"
+#include "../MySQL/NodeDataWriter.hpp"
+
+#include <atomic>
+#include <map>
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Zeit ohne Meldung, nach der ein Knoten als offline gilt, global und für einzelne Knoten.
+ */
+struct NodeOfflineConfig
+{
+    std::chrono::seconds timeout{ DefaultNodeOfflineTimeout };          ///< Gilt für alle Knoten ohne eigenen Eintrag.
+    std::map<std::string, std::chrono::seconds, std::less<>> overrides; ///< Abweichende Zeit je Knoten-ID.
+
+    /* Gibt die Zeit für den Knoten mit der ID zurück */
+    std::chrono::seconds timeoutOf(std::string_view id) const
+    {
+        auto it = overrides.find(id);
+        return it != overrides.end() ? it->second : timeout;
+    }
+};
+
+/**
+ * Klasse zur Verwaltung der Knoten und ihrer Messwerte.
+ *
+ * Diese Klasse wird als Singleton implementiert, sodass sie global über ein Makro
+ * zugänglich ist. Die Knoten werden im Speicher gehalten, das dauerhafte Speichern übernimmt
+ * das mit setup() übergebene StorageBackend (MySQL, SQLite oder nur im Speicher).
+ *
+ * Die Methoden sind threadsicher. Die Knoten sind in der NodeRegistry auf Shards verteilt, jeder
+ * Shard besitzt einen eigenen Mutex, sodass die Listener-Threads und der Haupt-Thread parallel
+ * arbeiten können, solange sie Knoten in verschiedenen Shards bearbeiten.
+ *
+ * Messwerte werden über den NodeDataWriter gesammelt und gebündelt an das Backend übergeben.
+ */
+class NodeStorage
+{
+private:
+    NodeStorage();
+    ~NodeStorage();
+
+    // Verhindern von Kopieren und Verschieben des Singleton-Objekts
+    NodeStorage(NodeStorage&&) = delete;
+    NodeStorage(NodeStorage const&) = delete;
+    void operator=(NodeStorage&&) = delete;
+    void operator=(NodeStorage const&) = delete;
+
+public:
+
+    static NodeStorage& getInstance()
+    {
+        static NodeStorage instance;
+        return instance;
+    }
+
+    /* Backend für das dauerhafte Speichern übernehmen, muss vor connect() aufgerufen werden */
+    void setup(std::unique_ptr<StorageBackend> backend) { m_backend = std::move(backend); }
+
+    /* Einstellungen für die Historientabelle übernehmen, muss vor connect() aufgerufen werden */
+    void setHistoryConfig(NodeHistoryConfig const& config) { m_historyConfig = config; }
+
+    /* Einstellungen für den NodeDataWriter und den Spool übernehmen, muss vor connect() aufgerufen werden */
+    void setWriterConfig(NodeDataWriterConfig const& config) { m_writerConfig = config; }
+
+    /* Offline-Zeiten der Knoten übernehmen, muss vor connect() aufgerufen werden */
+    void setOfflineConfig(NodeOfflineConfig const& config) { m_offlineConfig = config; }
+
+    /* Verbindung zum Backend aufbauen, die Knoten laden und die Schreib-Threads starten */
+    bool connect();
+
+    /* Schreibt alle wartenden Messwerte und trennt die Verbindungen der Schreib-Threads */
+    void disconnect();
+
+    /* Polling der Audit Datenbank tabelle um änderungen der Webseite zu aktuallisieren */
+    void pollAuditTable();
+
+    /* Alle Einträge aus der Nodes Datenbank Lesen */
+    bool fetchAllNodesFromDatabase();
+
+    /* Aktuallisieren des Node Status in der Datenbank */
+    void updateNodeStatusInDB(const std::string& id, const std::string& column, bool status);
+
+    /* Aktuallisieren des Status mehrerer Nodes eines Shards in der Datenbank, mit einer Anweisung je Block */
+    void updateNodesStatusInDB(const std::vector<std::string_view>& ids, const std::string& column, bool status);
+
+    /* Aktuallisieren des Status aller Nodes in der Datenbank mit einer einzigen Anweisung */
+    void updateAllNodesStatusInDB(const std::string& column, bool status);
+
+    /* Setzt alle Nodes im Speicher und in der Datenbank auf Offline, z.B. beim Beenden */
+    void setAllNodesOffline(bool saveToDB = true);
+
+    /* Globale Funktion zum ändern des Online/Accepted Status */
+    void setNodeStatus(NodeHandle node, bool status, bool isOnlineUpdate, bool saveToDB = true);
+    void setNodeStatus(std::string_view id, bool status, bool isOnlineUpdate, bool saveToDB = true);
+
+    /* Fügt einen Node mit gegebener Id hinzu */
+    NodeHandle addNode(std::string id);
+
+    /* Löscht einen Node mit gegebener Id */
+    void deleteNode(std::string id);
+
+    /* Aktuallisiert Node Daten für den gegebenen Node */
+    void updateNodeData(NodeHandle node, NodeData data, bool forceData = false);
+
+    /* Aktuallisiert Node Daten mit mehreren Messwerten aus einer Batch-Nachricht, sie werden gemeinsam geschrieben */
+    void updateNodeData(NodeHandle node, const std::vector<NodeData>& readings, bool forceData = false);
+
+    /* Übergibt gesammelte Messwerte an das Backend (läuft auf dem Schreib-Thread), false bei vorübergehendem Fehler */
+    bool writeNodeDataBatch(size_t workerIndex, std::vector<NodeDataRecord>& batch);
+
+    /* Setze gegebenen Node zum Status Online */
+    void setNodeOnline(NodeHandle node, bool online, bool saveToDB = true);
+    void setNodeOnline(std::string_view id, bool online, bool saveToDB = true);
+
+    /* Setze gegebenen Node zum Status Active */
+    void setNodeActive(std::string_view id, bool active, bool saveToDB = true);
+
+    /* Sucht den Node mit gegebener Id, gibt InvalidNodeHandle zurück wenn er nicht exestiert */
+    NodeHandle findNode(std::string_view id) const { return mNodeRegistry.find(id); }
+
+    /* Gibt True zurück wenn der Eintrag exestiert */
+    bool isNodeInDatabase(std::string_view id) const { return findNode(id) != InvalidNodeHandle; }
+
+    /* Gibt True zurück wenn der Node Allowed ist Updates in die Datenbank zu schrieben */
+    bool isAllowed(NodeHandle node);
+
+    /* Fügt einen Node in den Virtuellen Container der das Abbild der Nodes Tabelle darstellt */
+    NodeHandle addNodeToContainer(std::string_view id);
+
+    /* Setze die Uhrzeit und Datum für den Node an dem er Updates gesendet hatt und verlängert seine Offline-Frist (nur im Speicher) */
+    void setLastSeen(NodeHandle node);
+
+    /* Setzt die Zeit ohne Meldung, nach der der Node als offline gilt */
+    void setOfflineTimeout(NodeHandle node, std::chrono::seconds timeout);
+
+    /* Schreibt alle seit dem letzten Aufruf geänderten lastSeen Daten gesammelt in die Datenbank */
+    void flushLastSeen();
+
+    /* Legt künftige Tagespartitionen der Historie an und löscht abgelaufene, höchstens einmal pro Intervall */
+    void maintainNodeDataHistory();
+
+    /* Entfernt einen Node vom Virtuellen Container */
+    void removeNodeFromContainer(std::string_view id);
+
+    /* Setzt alle Nodes offline, deren Timer bis now abgelaufen ist, sollte etwa jede Sekunde aufgerufen werden */
+    void monitorLastSeen(TimerWheel::Clock::time_point now = TimerWheel::Clock::now());
+
+    /* Getter für den Container */
+    NodeRegistry& getNodeRegistry() { return mNodeRegistry; }
+
+    /* Getter für die Offline-Timer, z.B. um in den Benchmarks Fristen zu setzen */
+    TimerWheel& getOfflineTimers() { return m_offlineTimers; }
+
+    /* Getter für das Backend, nullptr solange setup() nicht aufgerufen wurde */
+    StorageBackend* getBackend() { return m_backend.get(); }
+
+private:
+    NodeRegistry mNodeRegistry;
+    TimerWheel m_offlineTimers;     ///< Ein Timer pro Node, der online ist. Meldungen verlängern nur Node::offlineDeadline, monitorLastSeen() zieht den Timer nach.
+    std::atomic<int64_t> m_onlineNodes{ 0 };    ///< Anzahl der Knoten mit online = true, nur für die Metriken.
+    std::vector<std::unique_ptr<std::mutex>> m_shardMutexes;   ///< Hält die Reihenfolge der Statusänderungen je Shard bis ins Backend ein.
+    std::mutex m_maintenanceMutex;  ///< Schützt m_lastHistoryMaintenance.
+    std::unique_ptr<StorageBackend> m_backend;
+    std::atomic<bool> m_connected{ false };     ///< Gesetzt, sobald connect() das Backend geöffnet hat.
+    std::unique_ptr<NodeDataWriter> m_nodeDataWriter;
+
+    NodeHistoryConfig m_historyConfig;
+    NodeDataWriterConfig m_writerConfig;
+    NodeOfflineConfig m_offlineConfig;
+    std::chrono::steady_clock::time_point m_lastHistoryMaintenance;    ///< Geschützt durch m_maintenanceMutex.
+};
+
+// Makro, um den Singleton-Instance der NodeStorage-Klasse zu erhalten.
+#define sStorage NodeStorage::getInstance()
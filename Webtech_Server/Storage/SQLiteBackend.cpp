@@ -0,0 +1,610 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#include "SQLiteBackend.hpp"
+#include "../MySQL/NodeDataWriter.hpp"
+#include "../Logging/Logger.hpp"
+
+#include <sqlite3.h>
+
+namespace
+{
+    /**
+     * Schema der Datenbank, entspricht den Tabellen in MySQL mit Zeitstempeln als Unix-Zeit.
+     */
+    constexpr const char* Schema =
+        "CREATE TABLE IF NOT EXISTS nodes ("
+        "id TEXT PRIMARY KEY, "
+        "allowed INTEGER NOT NULL DEFAULT 0, "
+        "online INTEGER NOT NULL DEFAULT 0, "
+        "lastSeen INTEGER);"
+        "CREATE TABLE IF NOT EXISTS node_data ("
+        "id TEXT PRIMARY KEY, "
+        "timestamp INTEGER NOT NULL, "
+        "temperature REAL, "
+        "pressure INTEGER, "
+        "altitude REAL, "
+        "humidity INTEGER, "
+        "lux INTEGER, "
+        "sound INTEGER);"
+        "CREATE TABLE IF NOT EXISTS node_data_history ("
+        "id TEXT NOT NULL, "
+        "timestamp INTEGER NOT NULL, "
+        "temperature REAL, "
+        "pressure INTEGER, "
+        "altitude REAL, "
+        "humidity INTEGER, "
+        "lux INTEGER, "
+        "sound INTEGER, "
+        "PRIMARY KEY (id, timestamp)) WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS node_data_history_timestamp ON node_data_history (timestamp);"
+        "CREATE TABLE IF NOT EXISTS audit ("
+        "node_id TEXT NOT NULL, "
+        "allowed_value INTEGER NOT NULL);";
+
+    /**
+     * Bindet einen Messwert an die Parameter 1 bis 8 einer Anweisung.
+     *
+     * @param stmt Die vorbereitete Anweisung.
+     * @param record Der Messwert.
+     */
+    void bindNodeDataRow(sqlite3_stmt* stmt, const NodeDataRecord& record)
+    {
+        sqlite3_bind_text(stmt, 1, record.id.data(), static_cast<int>(record.id.size()), SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(record.data.timeStamp));
+        sqlite3_bind_double(stmt, 3, record.data.temperature);
+        sqlite3_bind_int64(stmt, 4, record.data.pressure);
+        sqlite3_bind_double(stmt, 5, record.data.altitude);
+        sqlite3_bind_int64(stmt, 6, record.data.humidity);
+        sqlite3_bind_int64(stmt, 7, record.data.lux);
+        sqlite3_bind_int64(stmt, 8, record.data.sound);
+    }
+}
+
+/**
+ * Konstruktor für das SQLiteBackend. Die Datei wird erst mit open() geöffnet.
+ *
+ * @param path Pfad der Datenbankdatei, wird beim Öffnen angelegt, falls sie nicht existiert.
+ */
+SQLiteBackend::SQLiteBackend(std::string path) :
+    m_path(std::move(path))
+{
+}
+
+/**
+ * Destruktor, gibt die Anweisungen frei und schließt die Datei.
+ */
+SQLiteBackend::~SQLiteBackend()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    close();
+}
+
+/**
+ * Öffnet die Datenbankdatei und legt die Tabellen an.
+ *
+ * @return bool Gibt false zurück, wenn die Datei nicht geöffnet oder das Schema nicht angelegt werden konnte.
+ */
+bool SQLiteBackend::open()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    close();
+
+    int rc = sqlite3_open_v2(m_path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        printError(rc, "open");
+        close();
+        return false;
+    }
+
+    // Wartet bei einer Sperre durch einen anderen Prozess, statt sofort mit SQLITE_BUSY abzubrechen
+    sqlite3_busy_timeout(m_db, 5000);
+
+    if (!execute("PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", "open") || !execute(Schema, "open"))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Gibt alle Anweisungen frei und schließt die Datei. Der Mutex muss gesperrt sein.
+ */
+void SQLiteBackend::close()
+{
+    for (auto& [sql, stmt] : m_statements)
+        sqlite3_finalize(stmt);
+    m_statements.clear();
+
+    if (m_db)
+    {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+}
+
+/**
+ * Führt Anweisungen ohne Parameter aus. Der Mutex muss gesperrt sein.
+ *
+ * @param sql Eine oder mehrere durch Semikolon getrennte Anweisungen.
+ * @param context Name der aufrufenden Methode für die Fehlermeldung.
+ * @return bool Gibt false zurück, wenn eine Anweisung fehlgeschlagen ist.
+ */
+bool SQLiteBackend::execute(const char* sql, const char* context)
+{
+    char* message = nullptr;
+    int rc = sqlite3_exec(m_db, sql, nullptr, nullptr, &message);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "SQLite Error in " << context << ": " << (message ? message : sqlite3_errstr(rc)) << std::endl;
+        sqlite3_free(message);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Gibt die vorbereitete Anweisung für den Text zurück. Jede Anweisung wird nur einmal vorbereitet
+ * und danach mit neu gebundenen Parametern wiederverwendet. Der Mutex muss gesperrt sein.
+ *
+ * @param sql Text der Anweisung.
+ * @param context Name der aufrufenden Methode für die Fehlermeldung.
+ * @return sqlite3_stmt* Die Anweisung oder nullptr, wenn sie nicht vorbereitet werden konnte.
+ */
+sqlite3_stmt* SQLiteBackend::prepare(const std::string& sql, const char* context)
+{
+    auto it = m_statements.find(sql);
+    if (it != m_statements.end())
+        return it->second;
+
+    sqlite3_stmt* stmt = nullptr;
+    int rc = sqlite3_prepare_v3(m_db, sql.c_str(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        printError(rc, context);
+        return nullptr;
+    }
+
+    m_statements.emplace(sql, stmt);
+    return stmt;
+}
+
+/**
+ * Führt eine Anweisung ohne Ergebniszeilen aus und setzt sie für die nächste Verwendung zurück.
+ *
+ * @param stmt Die Anweisung mit gebundenen Parametern.
+ * @return int SQLITE_DONE bei Erfolg, sonst der Fehlercode.
+ */
+int SQLiteBackend::step(sqlite3_stmt* stmt)
+{
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return rc;
+}
+
+/**
+ * Gibt den letzten Fehler der Verbindung aus. Ist die Datei gesperrt oder die Platte voll, scheitert
+ * jeder Batch erneut, die Meldungen sind daher begrenzt.
+ *
+ * @param rc Der Fehlercode.
+ * @param context Name der aufrufenden Methode.
+ */
+void SQLiteBackend::printError(int rc, const char* context)
+{
+    static LogKey& sqliteError = sLog.key("sqlite_error", LogLevel::Error);
+    sLog.write(sqliteError, "SQLite Error in ", context, ": ", m_db ? sqlite3_errmsg(m_db) : sqlite3_errstr(rc), " (Error Code: ", rc, ")");
+}
+
+/**
+ * Prüft, ob eine Spalte eine der Status-Spalten ist. Der Name wird in die Anweisung eingesetzt.
+ *
+ * @param column Name der Spalte.
+ * @return bool Gibt true für "online" und "allowed" zurück.
+ */
+bool SQLiteBackend::isStatusColumn(const std::string& column)
+{
+    if (column == "online" || column == "allowed")
+        return true;
+
+    std::cerr << "Error: Unknown node status column '" << column << "'" << std::endl;
+    return false;
+}
+
+/**
+ * Prüft, ob ein Fehler vorübergehend ist und ein späterer Versuch Erfolg haben kann.
+ *
+ * @param rc Der Fehlercode.
+ * @return bool Gibt true zurück bei Sperren, voller Platte und Ein-/Ausgabefehlern.
+ */
+bool SQLiteBackend::isTransient(int rc)
+{
+    switch (rc & 0xff)
+    {
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:
+        case SQLITE_FULL:
+        case SQLITE_IOERR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Lädt alle Knoten in die Registry, setzt sie in der Datenbank offline und verwirft die Audit-Einträge.
+ *
+ * @param registry Die Registry, in die die Knoten geladen werden.
+ * @return bool Gibt true zurück, wenn das Laden erfolgreich war, andernfalls false.
+ */
+bool SQLiteBackend::loadNodes(NodeRegistry& registry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_db || !execute("BEGIN", "loadNodes"))
+        return false;
+
+    sqlite3_stmt* selectStmt = prepare("SELECT id, allowed, lastSeen FROM nodes", "loadNodes");
+    if (!selectStmt)
+    {
+        execute("ROLLBACK", "loadNodes");
+        return false;
+    }
+
+    size_t loaded = 0;
+    int rc;
+    while ((rc = sqlite3_step(selectStmt)) == SQLITE_ROW)
+    {
+        std::string_view id(reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 0)), static_cast<size_t>(sqlite3_column_bytes(selectStmt, 0)));
+        registry.load(id, sqlite3_column_int(selectStmt, 1) != 0, static_cast<time_t>(sqlite3_column_int64(selectStmt, 2)));
+        ++loaded;
+    }
+    sqlite3_reset(selectStmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        printError(rc, "loadNodes");
+        execute("ROLLBACK", "loadNodes");
+        return false;
+    }
+
+    // Setzt den Online-Status aller Knoten mit einer Anweisung auf false
+    if (!execute("UPDATE nodes SET online = 0 WHERE online <> 0", "loadNodes"))
+    {
+        execute("ROLLBACK", "loadNodes");
+        return false;
+    }
+
+    int reset = sqlite3_changes(m_db);
+
+    // Löscht den aktuellen Audit-Verlauf
+    if (!execute("DELETE FROM audit; COMMIT", "loadNodes"))
+    {
+        execute("ROLLBACK", "loadNodes");
+        return false;
+    }
+
+    std::cout << "Loaded " << loaded << " Nodes, " << reset << " set Offline" << std::endl;
+    return true;
+}
+
+/**
+ * Legt einen Knoten an, ein vorhandener Knoten bleibt unverändert.
+ *
+ * @param id ID des Knotens.
+ * @return bool Gibt false zurück, wenn das Schreiben fehlgeschlagen ist.
+ */
+bool SQLiteBackend::upsertNode(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    sqlite3_stmt* stmt = m_db ? prepare("INSERT OR IGNORE INTO nodes (id) VALUES (?)", "addNode") : nullptr;
+    if (!stmt)
+        return false;
+
+    sqlite3_bind_text(stmt, 1, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+    int rc = step(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        printError(rc, "addNode");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Löscht einen Knoten und seinen letzten Messwert in einer Transaktion.
+ *
+ * @param id ID des Knotens.
+ * @return bool Gibt false zurück, wenn das Löschen fehlgeschlagen ist.
+ */
+bool SQLiteBackend::deleteNode(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_db || !execute("BEGIN", "deleteNode"))
+        return false;
+
+    int rc = SQLITE_DONE;
+    for (const char* sql : { "DELETE FROM node_data WHERE id = ?", "DELETE FROM nodes WHERE id = ?" })
+    {
+        sqlite3_stmt* stmt = prepare(sql, "deleteNode");
+        if (!stmt)
+        {
+            rc = SQLITE_ERROR;
+            break;
+        }
+
+        sqlite3_bind_text(stmt, 1, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+        if ((rc = step(stmt)) != SQLITE_DONE)
+        {
+            printError(rc, "deleteNode");
+            break;
+        }
+    }
+
+    if (rc != SQLITE_DONE)
+    {
+        execute("ROLLBACK", "deleteNode");
+        return false;
+    }
+
+    return execute("COMMIT", "deleteNode");
+}
+
+/**
+ * Setzt eine Status-Spalte eines Knotens.
+ *
+ * @param id ID des Knotens.
+ * @param column "online" oder "allowed".
+ * @param status Neuer Statuswert.
+ */
+void SQLiteBackend::updateNodeStatus(const std::string& id, const std::string& column, bool status)
+{
+    if (!isStatusColumn(column))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    sqlite3_stmt* stmt = m_db ? prepare("UPDATE nodes SET " + column + " = ? WHERE id = ?", "updateNodeStatusInDB") : nullptr;
+    if (!stmt)
+        return;
+
+    sqlite3_bind_int(stmt, 1, status);
+    sqlite3_bind_text(stmt, 2, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+
+    int rc = step(stmt);
+    if (rc != SQLITE_DONE)
+        printError(rc, "updateNodeStatusInDB");
+}
+
+/**
+ * Setzt eine Status-Spalte mehrerer Knoten in einer Transaktion.
+ *
+ * @param ids IDs der Knoten.
+ * @param column "online" oder "allowed".
+ * @param status Neuer Statuswert.
+ */
+void SQLiteBackend::updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status)
+{
+    if (!isStatusColumn(column))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    sqlite3_stmt* stmt = m_db ? prepare("UPDATE nodes SET " + column + " = ? WHERE id = ?", "updateNodesStatusInDB") : nullptr;
+    if (!stmt || !execute("BEGIN", "updateNodesStatusInDB"))
+        return;
+
+    for (std::string_view id : ids)
+    {
+        sqlite3_bind_int(stmt, 1, status);
+        sqlite3_bind_text(stmt, 2, id.data(), static_cast<int>(id.size()), SQLITE_STATIC);
+
+        int rc = step(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            printError(rc, "updateNodesStatusInDB");
+            execute("ROLLBACK", "updateNodesStatusInDB");
+            return;
+        }
+    }
+
+    execute("COMMIT", "updateNodesStatusInDB");
+}
+
+/**
+ * Setzt eine Status-Spalte aller Knoten mit einer Anweisung.
+ *
+ * @param column "online" oder "allowed".
+ * @param status Neuer Statuswert.
+ */
+void SQLiteBackend::updateAllNodesStatus(const std::string& column, bool status)
+{
+    if (!isStatusColumn(column))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    sqlite3_stmt* stmt = m_db ? prepare("UPDATE nodes SET " + column + " = ? WHERE " + column + " <> ?", "updateAllNodesStatusInDB") : nullptr;
+    if (!stmt)
+        return;
+
+    sqlite3_bind_int(stmt, 1, status);
+    sqlite3_bind_int(stmt, 2, status);
+
+    int rc = step(stmt);
+    if (rc != SQLITE_DONE)
+        printError(rc, "updateAllNodesStatusInDB");
+}
+
+/**
+ * Schreibt lastSeen mehrerer Knoten in einer Transaktion. Gelöschte Knoten werden nicht neu angelegt.
+ *
+ * @param entries Die geänderten Knoten mit ihrem lastSeen.
+ * @return bool Gibt false zurück, wenn das Schreiben fehlgeschlagen ist.
+ */
+bool SQLiteBackend::updateLastSeen(const std::vector<LastSeenEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    sqlite3_stmt* stmt = m_db ? prepare("UPDATE nodes SET lastSeen = ? WHERE id = ?", "flushLastSeen") : nullptr;
+    if (!stmt || !execute("BEGIN", "flushLastSeen"))
+        return false;
+
+    for (const LastSeenEntry& entry : entries)
+    {
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(entry.lastSeen));
+        sqlite3_bind_text(stmt, 2, entry.id.data(), static_cast<int>(entry.id.size()), SQLITE_STATIC);
+
+        int rc = step(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            printError(rc, "flushLastSeen");
+            execute("ROLLBACK", "flushLastSeen");
+            return false;
+        }
+    }
+
+    return execute("COMMIT", "flushLastSeen");
+}
+
+/**
+ * Schreibt die gesammelten Messwerte in einer Transaktion. Jeder Messwert wird an node_data_history
+ * angehängt und ersetzt den letzten Wert in node_data, sofern er nicht älter ist.
+ *
+ * @param writerIndex Index des Schreib-Threads, alle teilen sich die Verbindung.
+ * @param batch Die zu schreibenden Messwerte.
+ * @return AppendResult Retry, wenn die Datei vorübergehend gesperrt ist oder die Anweisungen nicht vorbereitet werden konnten, Dropped bei anderen Fehlern.
+ */
+AppendResult SQLiteBackend::appendNodeData(size_t /*writerIndex*/, std::vector<NodeDataRecord>& batch)
+{
+    if (batch.empty())
+        return AppendResult::Committed;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_db)
+        return AppendResult::Retry;
+
+    // Doppelte Messwerte (gleicher Knoten, gleiche Sekunde) werden in der Historie verworfen
+    sqlite3_stmt* historyStmt = prepare(
+        "INSERT OR IGNORE INTO node_data_history (id, timestamp, temperature, pressure, altitude, humidity, lux, sound) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?)", "writeNodeDataBatch");
+
+    // Ältere Messwerte, z.B. aus dem Spool, überschreiben einen neueren Wert nicht
+    sqlite3_stmt* updateDataStmt = prepare(
+        "INSERT INTO node_data (id, timestamp, temperature, pressure, altitude, humidity, lux, sound) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?) "
+        "ON CONFLICT (id) DO UPDATE SET "
+        "timestamp = excluded.timestamp, temperature = excluded.temperature, pressure = excluded.pressure, "
+        "altitude = excluded.altitude, humidity = excluded.humidity, lux = excluded.lux, sound = excluded.sound "
+        "WHERE excluded.timestamp >= node_data.timestamp", "writeNodeDataBatch");
+
+    // Der Fehler wurde bereits ausgegeben, der Batch wird wiederholt bzw. landet im Spool
+    if (!historyStmt || !updateDataStmt)
+        return AppendResult::Retry;
+
+    int rc = sqlite3_exec(m_db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        printError(rc, "writeNodeDataBatch");
+        return isTransient(rc) ? AppendResult::Retry : AppendResult::Dropped;
+    }
+
+    for (const NodeDataRecord& record : batch)
+    {
+        bindNodeDataRow(historyStmt, record);
+        if ((rc = step(historyStmt)) != SQLITE_DONE)
+            break;
+
+        bindNodeDataRow(updateDataStmt, record);
+        if ((rc = step(updateDataStmt)) != SQLITE_DONE)
+            break;
+    }
+
+    if (rc == SQLITE_DONE)
+        rc = sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, nullptr);
+
+    if (rc != SQLITE_OK && rc != SQLITE_DONE)
+    {
+        printError(rc, "writeNodeDataBatch");
+        sqlite3_exec(m_db, "ROLLBACK", nullptr, nullptr, nullptr);
+
+        // Andere Fehler würden bei jeder Wiederholung erneut auftreten, der Batch wird verworfen
+        return isTransient(rc) ? AppendResult::Retry : AppendResult::Dropped;
+    }
+
+    return AppendResult::Committed;
+}
+
+/**
+ * Liest die Audit-Tabelle und löscht die gelesenen Einträge in einer Transaktion.
+ *
+ * @param entries Erhält die Einträge in der Reihenfolge, in der sie hinterlegt wurden.
+ * @return bool Gibt false zurück, wenn die Tabelle nicht gelesen werden konnte.
+ */
+bool SQLiteBackend::fetchAudit(std::vector<AuditEntry>& entries)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    entries.clear();
+
+    sqlite3_stmt* selectStmt = m_db ? prepare("SELECT rowid, node_id, allowed_value FROM audit ORDER BY rowid", "pollAuditTable") : nullptr;
+    sqlite3_stmt* deleteStmt = m_db ? prepare("DELETE FROM audit WHERE rowid <= ?", "pollAuditTable") : nullptr;
+    if (!selectStmt || !deleteStmt || !execute("BEGIN", "pollAuditTable"))
+        return false;
+
+    sqlite3_int64 lastRow = 0;
+    int rc;
+    while ((rc = sqlite3_step(selectStmt)) == SQLITE_ROW)
+    {
+        lastRow = sqlite3_column_int64(selectStmt, 0);
+        entries.push_back(AuditEntry{ std::string(reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 1)), static_cast<size_t>(sqlite3_column_bytes(selectStmt, 1))),
+                                      sqlite3_column_int(selectStmt, 2) != 0 });
+    }
+    sqlite3_reset(selectStmt);
+
+    if (rc == SQLITE_DONE && !entries.empty())
+    {
+        sqlite3_bind_int64(deleteStmt, 1, lastRow);
+        rc = step(deleteStmt);
+    }
+
+    if (rc != SQLITE_DONE)
+    {
+        printError(rc, "pollAuditTable");
+        execute("ROLLBACK", "pollAuditTable");
+        entries.clear();
+        return false;
+    }
+
+    return execute("COMMIT", "pollAuditTable");
+}
+
+/**
+ * Entfernt Messwerte aus der Historie, die älter als retentionDays sind.
+ *
+ * @param config Aufbewahrungsdauer der Historie, partitionsAhead wird nicht benötigt.
+ */
+void SQLiteBackend::maintainHistory(NodeHistoryConfig const& config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    sqlite3_stmt* stmt = m_db ? prepare("DELETE FROM node_data_history WHERE timestamp < ?", "maintainNodeDataHistory") : nullptr;
+    if (!stmt)
+        return;
+
+    const time_t oldest = std::time(nullptr) - static_cast<time_t>(config.retentionDays) * 24 * 60 * 60;
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(oldest));
+
+    int rc = step(stmt);
+    if (rc != SQLITE_DONE)
+        printError(rc, "maintainNodeDataHistory");
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "StorageBackend.hpp"
+
+#include <unordered_map>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Speicherung in einer SQLite-Datei, für einzelne Rechner ohne MySQL-Server.
+ *
+ * Die Tabellen entsprechen denen der MySQL-Datenbank und werden beim Öffnen angelegt. Zeitstempel
+ * werden als Unix-Zeit in INTEGER-Spalten gespeichert. Abgelaufene Historie wird mit einem DELETE
+ * über den Index auf timestamp entfernt, da SQLite keine Partitionen kennt.
+ *
+ * SQLite erlaubt nur einen schreibenden Zugriff gleichzeitig, daher teilen sich alle Aufrufe eine
+ * Verbindung, die mit einem Mutex geschützt ist. Die Datei läuft im WAL-Modus, sodass lesende
+ * Zugriffe von außen (z.B. eine Webseite) das Schreiben nicht blockieren. Jeder Batch an Messwerten
+ * wird in einer Transaktion geschrieben.
+ */
+class SQLiteBackend : public StorageBackend
+{
+public:
+    explicit SQLiteBackend(std::string path);
+    ~SQLiteBackend() override;
+
+    SQLiteBackend(SQLiteBackend const&) = delete;
+    void operator=(SQLiteBackend const&) = delete;
+
+    const char* name() const override { return "sqlite"; }
+
+    bool open() override;
+    bool openWriters(size_t, size_t) override { return m_db != nullptr; }
+    void closeWriters() override { }
+
+    bool loadNodes(NodeRegistry& registry) override;
+    bool upsertNode(const std::string& id) override;
+    bool deleteNode(const std::string& id) override;
+
+    void updateNodeStatus(const std::string& id, const std::string& column, bool status) override;
+    void updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status) override;
+    void updateAllNodesStatus(const std::string& column, bool status) override;
+    bool updateLastSeen(const std::vector<LastSeenEntry>& entries) override;
+
+    AppendResult appendNodeData(size_t writerIndex, std::vector<NodeDataRecord>& batch) override;
+    bool fetchAudit(std::vector<AuditEntry>& entries) override;
+    void maintainHistory(NodeHistoryConfig const& config) override;
+
+private:
+    /* Gibt alle Anweisungen frei und schließt die Datei */
+    void close();
+
+    /* Führt eine oder mehrere Anweisungen ohne Parameter aus, gibt den Fehler aus und false zurück, wenn das nicht möglich ist */
+    bool execute(const char* sql, const char* context);
+
+    /* Gibt die vorbereitete Anweisung für den Text zurück, bereitet sie beim ersten Aufruf vor, nullptr bei einem Fehler */
+    sqlite3_stmt* prepare(const std::string& sql, const char* context);
+
+    /* Führt eine vorbereitete Anweisung bis zum Ende aus und setzt sie zurück, gibt den Fehlercode zurück */
+    int step(sqlite3_stmt* stmt);
+
+    /* Gibt den letzten Fehler der Verbindung aus */
+    void printError(int rc, const char* context);
+
+    /* Gibt True zurück wenn die Spalte eine der Status-Spalten ist, sonst wird ein Fehler ausgegeben */
+    static bool isStatusColumn(const std::string& column);
+
+    /* Gibt True zurück wenn ein späterer Versuch Erfolg haben kann (gesperrt, Platte voll, Ein-/Ausgabefehler) */
+    static bool isTransient(int rc);
+
+    std::string m_path;
+    std::mutex m_mutex;                 ///< Serialisiert alle Zugriffe auf die Verbindung.
+    sqlite3* m_db = nullptr;
+    std::unordered_map<std::string, sqlite3_stmt*> m_statements;    ///< Wird vor der Verbindung freigegeben.
+};
@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+#pragma once
+
+#include "../../Webtech_Server.h"
+#include "../MySQL/NodeRegistry.hpp"
+
+struct NodeDataRecord;
+
+/**
+ * Einstellungen für die Historientabelle node_data_history.
+ */
+struct NodeHistoryConfig
+{
+    int retentionDays = 30;                                 ///< Tagespartitionen, die älter sind, werden gelöscht.
+    int partitionsAhead = 3;                                ///< Anzahl der im Voraus angelegten Tagespartitionen.
+    std::chrono::seconds maintenanceInterval{ 3600 };       ///< Mindestabstand zwischen zwei Wartungsläufen.
+};
+
+/**
+ * Eine Änderung der Freigabe eines Knotens, die die Webseite in der Tabelle audit hinterlegt hat.
+ */
+struct AuditEntry
+{
+    std::string nodeId;
+    bool allowed = false;
+};
+
+/**
+ * lastSeen eines Knotens, das seit dem letzten flushLastSeen() geändert wurde.
+ */
+struct LastSeenEntry
+{
+    std::string_view id;            ///< Verweist auf die unveränderliche ID in der NodeRegistry.
+    time_t lastSeen;
+};
+
+/**
+ * Ergebnis von StorageBackend::appendNodeData().
+ */
+enum class AppendResult
+{
+    Committed,      ///< Alle Messwerte des Batches sind geschrieben.
+    Retry,          ///< Vorübergehender Fehler, der Batch wird wiederholt bzw. im Spool abgelegt.
+    Dropped         ///< Dauerhafter Fehler, der bei jeder Wiederholung erneut auftreten würde, der Batch ist verworfen.
+};
+
+///////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Schnittstelle für die dauerhafte Speicherung der Knoten und Messwerte.
+ *
+ * NodeStorage hält die Knoten im Speicher und ruft das Backend nur für das Schreiben und Laden
+ * auf. Die Implementierungen sind MySQLBackend für den Betrieb mit der Webseite, SQLiteBackend
+ * für einzelne Rechner ohne MySQL-Server und MemoryBackend für Benchmarks.
+ *
+ * Alle Methoden müssen threadsicher sein. Aufrufe für denselben Knoten müssen in der Reihenfolge
+ * wirksam werden, in der sie erfolgen, NodeStorage serialisiert sie über die Shards der
+ * NodeRegistry. appendNodeData() wird je writerIndex nur von einem Thread gleichzeitig aufgerufen.
+ *
+ * Fehler werden im Backend ausgegeben, die Methoden werfen keine Ausnahmen.
+ */
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() = default;
+
+    /* Kurzname für die Ausgabe, z.B. "mysql" */
+    virtual const char* name() const = 0;
+
+    /* Baut die Verbindungen für Knoten, Status und Audit auf */
+    virtual bool open() = 0;
+
+    /* Baut writerCount Verbindungen für appendNodeData() auf, ein Batch umfasst höchstens batchSize Messwerte */
+    virtual bool openWriters(size_t writerCount, size_t batchSize) = 0;
+
+    /* Trennt die Verbindungen der Schreib-Threads, nachdem der NodeDataWriter beendet wurde */
+    virtual void closeWriters() = 0;
+
+    /* Lädt alle Knoten in die Registry, setzt sie in der Datenbank offline und verwirft die Audit-Einträge */
+    virtual bool loadNodes(NodeRegistry& registry) = 0;
+
+    /* Legt einen Knoten an, ein bereits vorhandener Knoten bleibt unverändert */
+    virtual bool upsertNode(const std::string& id) = 0;
+
+    /* Löscht einen Knoten samt seinem letzten Messwert */
+    virtual bool deleteNode(const std::string& id) = 0;
+
+    /* Setzt die Spalte "online" oder "allowed" eines Knotens */
+    virtual void updateNodeStatus(const std::string& id, const std::string& column, bool status) = 0;
+
+    /* Setzt die Spalte "online" oder "allowed" mehrerer Knoten */
+    virtual void updateNodesStatus(const std::vector<std::string_view>& ids, const std::string& column, bool status) = 0;
+
+    /* Setzt die Spalte "online" oder "allowed" aller Knoten */
+    virtual void updateAllNodesStatus(const std::string& column, bool status) = 0;
+
+    /* Schreibt lastSeen mehrerer Knoten, false wenn das Schreiben fehlgeschlagen ist */
+    virtual bool updateLastSeen(const std::vector<LastSeenEntry>& entries) = 0;
+
+    /* Hängt die Messwerte an die Historie an und ersetzt den letzten Wert je Knoten */
+    virtual AppendResult appendNodeData(size_t writerIndex, std::vector<NodeDataRecord>& batch) = 0;
+
+    /* Liest die wartenden Audit-Einträge und entfernt sie, false wenn das Lesen fehlgeschlagen ist */
+    virtual bool fetchAudit(std::vector<AuditEntry>& entries) = 0;
+
+    /* Legt künftige Partitionen der Historie an und entfernt abgelaufene Messwerte */
+    virtual void maintainHistory(NodeHistoryConfig const& /*config*/) { }
+};
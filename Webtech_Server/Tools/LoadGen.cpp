@@ -0,0 +1,421 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+// Lastgenerator für Durchsatztests gegen einen lokalen Broker (z.B. mosquitto).
+//
+// Simuliert N virtuelle Knoten. Jeder Knoten meldet sich auf "client/accepted" mit seiner ID an und
+// sendet danach Messwerte auf "Nodes/{ID}/Data" im Schema, das ClientsListener liest. Jeder Knoten
+// sendet mit der eingestellten Rate, der Abstand zwischen zwei Messwerten wird um den Jitter variiert.
+//
+// Ausgegeben werden die erreichte Senderate und, über den Metrik-Endpunkt des Servers, die Rate der
+// empfangenen und in node_data geschriebenen Messwerte. Messwerte werden nur geschrieben, wenn die
+// Knoten in der Datenbank freigegeben sind, die Empfangsrate ist davon unabhängig.
+
+#include "../Webtech_Server.h"
+
+#include <atomic>
+#include <iomanip>
+#include <queue>
+#include <random>
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+    /**
+     * Einstellungen des Lastgenerators, über die Kommandozeile setzbar.
+     */
+    struct LoadGenOptions
+    {
+        std::string broker = "localhost:1883";      ///< Adresse des Brokers.
+        std::string metrics = "localhost:9464";     ///< Adresse des Metrik-Endpunkts des Servers, leer deaktiviert das Auslesen.
+        std::string prefix = "LG";                  ///< Präfix der Knoten-IDs, damit sich mehrere Generatoren nicht überschneiden.
+        size_t nodes = 100;                         ///< Anzahl der virtuellen Knoten.
+        size_t clients = 4;                         ///< Anzahl der MQTT-Verbindungen, auf die die Knoten verteilt werden.
+        double rate = 1.0;                          ///< Messwerte pro Sekunde und Knoten.
+        double jitter = 0.2;                        ///< Abweichung des Abstands als Anteil, 0.2 = ±20 %.
+        int qos = 0;                                ///< QoS der Messwerte.
+        std::chrono::seconds duration{ 60 };        ///< Laufzeit, 0 = bis Ctrl+C.
+        std::chrono::seconds reportInterval{ 5 };   ///< Abstand der Zwischenberichte.
+    };
+
+    std::atomic<bool> shouldExit{ false };
+
+    std::atomic<uint64_t> published{ 0 };          ///< Erfolgreich an die Bibliothek übergebene Messwerte.
+    std::atomic<uint64_t> publishFailures{ 0 };    ///< Von der Bibliothek abgelehnte Messwerte.
+
+    void signalHandler(int)
+    {
+        shouldExit = true;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Usage: Webtech_LoadGen [options]\n"
+                     "  --broker HOST:PORT     MQTT broker (default localhost:1883)\n"
+                     "  --metrics HOST:PORT    server metrics endpoint, empty to disable (default localhost:9464)\n"
+                     "  --nodes N              virtual nodes (default 100)\n"
+                     "  --rate R               readings per second and node (default 1)\n"
+                     "  --jitter J             interval jitter as fraction, 0.2 = +-20% (default 0.2)\n"
+                     "  --clients C            MQTT connections (default 4)\n"
+                     "  --duration S           run time in seconds, 0 = until Ctrl+C (default 60)\n"
+                     "  --report S             report interval in seconds (default 5)\n"
+                     "  --qos Q                QoS of the readings (default 0)\n"
+                     "  --prefix P             node id prefix (default LG)\n";
+    }
+
+    /**
+     * Liest die Kommandozeile. Gibt false zurück, wenn eine Option unbekannt oder ungültig ist.
+     */
+    bool parseOptions(int argc, char* argv[], LoadGenOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view name = argv[i];
+            if (name == "--help" || name == "-h")
+                return false;
+
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Missing value for " << name << std::endl;
+                return false;
+            }
+
+            const char* value = argv[++i];
+            try
+            {
+                if (name == "--broker")
+                    options.broker = value;
+                else if (name == "--metrics")
+                    options.metrics = value;
+                else if (name == "--prefix")
+                    options.prefix = value;
+                else if (name == "--nodes")
+                    options.nodes = std::stoul(value);
+                else if (name == "--clients")
+                    options.clients = std::max<size_t>(1, std::stoul(value));
+                else if (name == "--rate")
+                    options.rate = std::stod(value);
+                else if (name == "--jitter")
+                    options.jitter = std::clamp(std::stod(value), 0.0, 1.0);
+                else if (name == "--qos")
+                    options.qos = std::clamp(std::stoi(value), 0, 2);
+                else if (name == "--duration")
+                    options.duration = std::chrono::seconds(std::stoul(value));
+                else if (name == "--report")
+                    options.reportInterval = std::chrono::seconds(std::max<unsigned long>(1, std::stoul(value)));
+                else
+                {
+                    std::cerr << "Error: Unknown option " << name << std::endl;
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "Error: Invalid value '" << value << "' for " << name << std::endl;
+                return false;
+            }
+        }
+
+        return options.nodes > 0 && options.rate > 0.0;
+    }
+
+    /**
+     * Ruft eine Seite per HTTP/1.0 ab und gibt den Inhalt ohne Header zurück, leer bei einem Fehler.
+     */
+    std::string httpGet(const std::string& address, const char* path)
+    {
+        size_t colon = address.rfind(':');
+        std::string host = address.substr(0, colon);
+        std::string port = colon == std::string::npos ? "80" : address.substr(colon + 1);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* result = nullptr;
+        if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+            return std::string();
+
+        int fd = -1;
+        for (addrinfo* it = result; it && fd < 0; it = it->ai_next)
+        {
+            fd = ::socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+            if (fd >= 0 && ::connect(fd, it->ai_addr, it->ai_addrlen) != 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        ::freeaddrinfo(result);
+
+        if (fd < 0)
+            return std::string();
+
+        timeval timeout{ 2, 0 };
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string request = std::string("GET ") + path + " HTTP/1.0\r\nHost: " + host + "\r\n\r\n";
+        ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+        std::string response;
+        char buffer[4096];
+        ssize_t n;
+        while ((n = ::recv(fd, buffer, sizeof(buffer), 0)) > 0)
+            response.append(buffer, static_cast<size_t>(n));
+        ::close(fd);
+
+        size_t body = response.find("\r\n\r\n");
+        if (!response.starts_with("HTTP/1.1 200") || body == std::string::npos)
+            return std::string();
+
+        return response.substr(body + 4);
+    }
+
+    /**
+     * Zählerstände des Servers, gelesen aus /metrics.
+     */
+    struct ServerCounters
+    {
+        bool valid = false;
+        double received = 0.0;      ///< webtech_mqtt_messages_received_total{topic="Data"}
+        double committed = 0.0;     ///< webtech_db_node_data_rows_total
+    };
+
+    /**
+     * Liest die Zählerstände aus der Ausgabe des Metrik-Endpunkts.
+     */
+    ServerCounters scrapeServer(const std::string& address)
+    {
+        ServerCounters counters;
+        if (address.empty())
+            return counters;
+
+        std::string text = httpGet(address, "/metrics");
+        if (text.empty())
+            return counters;
+
+        std::istringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.starts_with("webtech_mqtt_messages_received_total{topic=\"Data\"} "))
+                counters.received = std::strtod(line.c_str() + line.rfind(' ') + 1, nullptr);
+            else if (line.starts_with("webtech_db_node_data_rows_total "))
+                counters.committed = std::strtod(line.c_str() + line.rfind(' ') + 1, nullptr);
+        }
+
+        counters.valid = true;
+        return counters;
+    }
+
+    /**
+     * Eine MQTT-Verbindung mit den ihr zugeteilten virtuellen Knoten.
+     * Läuft auf einem eigenen Thread und sendet die Messwerte der Knoten zu ihren geplanten Zeitpunkten.
+     */
+    class Publisher
+    {
+    public:
+        Publisher(const LoadGenOptions& options, size_t index, std::vector<std::string> ids) :
+            m_options(options),
+            m_ids(std::move(ids)),
+            m_client(options.broker, "webtech-loadgen-" + std::to_string(::getpid()) + "-" + std::to_string(index)),
+            m_random(static_cast<uint32_t>(index * 7919 + 1))
+        {
+        }
+
+        /* Verbindet, meldet alle Knoten an und sendet bis shouldExit gesetzt ist */
+        void run()
+        {
+            try
+            {
+                mqtt::connect_options connOpts;
+                connOpts.set_keep_alive_interval(20);
+                connOpts.set_clean_session(true);
+                m_client.connect(connOpts)->wait();
+
+                // Anmeldung wie ein echter Knoten, der Server legt die Knoten dabei an
+                for (const std::string& id : m_ids)
+                {
+                    std::string announce = "{\"id\":\"" + id + "\"}";
+                    m_client.publish("client/accepted", announce.data(), announce.size(), 1, false)->wait();
+                }
+            }
+            catch (const mqtt::exception& exc)
+            {
+                std::cerr << "Error: Publisher could not connect to " << m_options.broker << ": " << exc.what() << std::endl;
+                shouldExit = true;
+                return;
+            }
+
+            // Erster Messwert jedes Knotens zufällig innerhalb eines Intervalls, damit nicht alle gleichzeitig senden
+            const auto interval = std::chrono::duration<double>(1.0 / m_options.rate);
+            const auto start = std::chrono::steady_clock::now();
+            std::uniform_real_distribution<double> offset(0.0, 1.0);
+            for (size_t i = 0; i < m_ids.size(); ++i)
+                m_schedule.push({ start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * offset(m_random)), i });
+
+            std::uniform_real_distribution<double> jitter(-m_options.jitter, m_options.jitter);
+            std::string topic;
+            char payload[160];
+
+            while (!shouldExit)
+            {
+                auto [due, node] = m_schedule.top();
+                auto now = std::chrono::steady_clock::now();
+
+                if (due > now)
+                {
+                    // Kurz schlafen, damit shouldExit zeitnah bemerkt wird
+                    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, std::chrono::milliseconds(100)));
+                    continue;
+                }
+
+                m_schedule.pop();
+
+                topic.assign("Nodes/").append(m_ids[node]).append("/Data");
+                int length = formatReading(payload, sizeof(payload));
+
+                try
+                {
+                    m_client.publish(topic, payload, static_cast<size_t>(length), m_options.qos, false);
+                    published.fetch_add(1, std::memory_order_relaxed);
+                }
+                catch (const mqtt::exception&)
+                {
+                    publishFailures.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                // Ausgehend vom geplanten Zeitpunkt, damit sich Verzögerungen nicht aufsummieren
+                auto next = due + std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval * (1.0 + jitter(m_random)));
+                m_schedule.push({ next, node });
+            }
+
+            try
+            {
+                m_client.disconnect()->wait();
+            }
+            catch (const mqtt::exception& exc)
+            {
+                std::cerr << "Error: Publisher could not disconnect: " << exc.what() << std::endl;
+            }
+        }
+
+    private:
+        /* Schreibt einen Messwert im Schema von TelemetryParser mit plausiblen Zufallswerten */
+        int formatReading(char* buffer, size_t size)
+        {
+            std::uniform_real_distribution<float> temperature(15.0f, 30.0f);
+            std::uniform_int_distribution<uint32_t> pressure(98000, 104000);
+            std::uniform_real_distribution<float> altitude(300.0f, 500.0f);
+            std::uniform_int_distribution<uint32_t> humidity(20, 80);
+            std::uniform_int_distribution<uint32_t> lux(0, 1000);
+            std::uniform_int_distribution<uint32_t> sound(20, 90);
+
+            return std::snprintf(buffer, size, "{\"temp\":%.2f,\"pres\":%u,\"alt\":%.2f,\"hum\":%u,\"lux\":%u,\"soun\":%u,\"time\":%lld}",
+                temperature(m_random), pressure(m_random), altitude(m_random), humidity(m_random), lux(m_random), sound(m_random),
+                static_cast<long long>(std::time(nullptr)));
+        }
+
+        using Scheduled = std::pair<std::chrono::steady_clock::time_point, size_t>;
+
+        const LoadGenOptions& m_options;
+        std::vector<std::string> m_ids;
+        mqtt::async_client m_client;
+        std::minstd_rand m_random;
+        std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> m_schedule;   ///< Nächster Messwert je Knoten, frühester zuerst.
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    LoadGenOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // Knoten-IDs in der Form der echten Knoten (12 Hex-Zeichen), reihum auf die Verbindungen verteilt
+    std::vector<std::vector<std::string>> ids(std::min(options.clients, options.nodes));
+    char buffer[32];
+    for (size_t i = 0; i < options.nodes; ++i)
+    {
+        std::snprintf(buffer, sizeof(buffer), "%s%010zX", options.prefix.c_str(), i);
+        ids[i % ids.size()].emplace_back(buffer);
+    }
+
+    std::vector<std::unique_ptr<Publisher>> publishers;
+    for (size_t i = 0; i < ids.size(); ++i)
+        publishers.push_back(std::make_unique<Publisher>(options, i, std::move(ids[i])));
+
+    std::cerr << "LoadGen: " << options.nodes << " node(s) at " << options.rate << "/s each (target " << options.nodes * options.rate
+              << "/s) over " << publishers.size() << " connection(s) to " << options.broker << std::endl;
+
+    ServerCounters first = scrapeServer(options.metrics);
+    if (!options.metrics.empty() && !first.valid)
+        std::cerr << "Warning: Metrics endpoint " << options.metrics << " not reachable, reporting publish rate only" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (auto& publisher : publishers)
+        threads.emplace_back(&Publisher::run, publisher.get());
+
+    // Zwischenberichte, Raten jeweils über das letzte Intervall
+    ServerCounters last = first;
+    uint64_t lastPublished = 0;
+    auto lastReport = start;
+    auto nextReport = start + options.reportInterval;
+
+    while (!shouldExit)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        auto now = std::chrono::steady_clock::now();
+        if (options.duration.count() != 0 && now - start >= options.duration)
+            shouldExit = true;
+
+        if (now < nextReport && !shouldExit)
+            continue;
+
+        double seconds = std::chrono::duration<double>(now - lastReport).count();
+        uint64_t total = published.load();
+        ServerCounters current = scrapeServer(options.metrics);
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[" << std::chrono::duration<double>(now - start).count() << "s] published " << (total - lastPublished) / seconds << "/s";
+        if (current.valid && last.valid)
+            std::cout << ", received " << (current.received - last.received) / seconds << "/s"
+                      << ", committed " << (current.committed - last.committed) / seconds << "/s";
+        std::cout << ", failures " << publishFailures.load() << std::endl;
+
+        lastPublished = total;
+        lastReport = now;
+        if (current.valid)
+            last = current;
+        nextReport = now + options.reportInterval;
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    // Der Server arbeitet nach dem Ende noch seine Warteschlangen ab, kurz warten für den Endstand
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    ServerCounters finalCounters = scrapeServer(options.metrics);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Total: published " << published.load() << " (" << published.load() / seconds << "/s), failures " << publishFailures.load() << std::endl;
+    if (finalCounters.valid && first.valid)
+        std::cout << "Server: received " << finalCounters.received - first.received << " (" << (finalCounters.received - first.received) / seconds << "/s)"
+                  << ", committed " << finalCounters.committed - first.committed << " (" << (finalCounters.committed - first.committed) / seconds << "/s)" << std::endl;
+
+    return 0;
+}
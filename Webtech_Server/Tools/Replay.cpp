@@ -0,0 +1,255 @@
+/*
+Copyright (c) 2023-2023 Webtech Projekt
+*/
+
+// Spielt eine mit WEBTECH_MQTT_CAPTURE aufgezeichnete Datei wieder an einen Broker ab.
+//
+// Die Nachrichten werden in der aufgezeichneten Reihenfolge gesendet, die Abstände zwischen ihnen
+// werden mit --speed skaliert: 1 entspricht der Aufnahme, 10 spielt zehnmal so schnell ab und 0 sendet
+// ohne Pause so schnell wie möglich. Bei mehreren Verbindungen wird jedes Topic immer über dieselbe
+// Verbindung gesendet, damit die Reihenfolge der Nachrichten eines Knotens erhalten bleibt.
+//
+// Die Nachrichten werden ohne Retained-Flag gesendet, damit der Broker nach dem Abspielen keine
+// Nachrichten der Aufnahme mehr ausliefert.
+
+#include "../Webtech_Server.h"
+#include "../MQTT/BaseClasses/MessageCapture.hpp"
+
+#include <atomic>
+#include <iomanip>
+
+#include <unistd.h>
+
+namespace
+{
+    /**
+     * Einstellungen des Replay-Tools, über die Kommandozeile setzbar.
+     */
+    struct ReplayOptions
+    {
+        std::string file;                           ///< Pfad der Aufzeichnung.
+        std::string broker = "localhost:1883";      ///< Adresse des Brokers.
+        double speed = 1.0;                         ///< Faktor der Abspielgeschwindigkeit, 0 = so schnell wie möglich.
+        size_t clients = 1;                         ///< Anzahl der MQTT-Verbindungen, auf die die Topics verteilt werden.
+        int qos = -1;                               ///< QoS beim Senden, -1 = wie aufgezeichnet.
+        size_t loops = 1;                           ///< Anzahl der Durchläufe, 0 = bis Ctrl+C.
+        std::chrono::seconds reportInterval{ 5 };   ///< Abstand der Zwischenberichte.
+    };
+
+    std::atomic<bool> shouldExit{ false };
+
+    void signalHandler(int)
+    {
+        shouldExit = true;
+    }
+
+    void printUsage()
+    {
+        std::cerr << "Usage: Webtech_Replay [options] FILE\n"
+                     "  --broker HOST:PORT     MQTT broker (default localhost:1883)\n"
+                     "  --speed S              playback speed, 1 = as recorded, 0 = as fast as possible (default 1)\n"
+                     "  --clients C            MQTT connections, topics are kept on one connection (default 1)\n"
+                     "  --qos Q                QoS of the messages, -1 = as recorded (default -1)\n"
+                     "  --loops N              number of passes over the file, 0 = until Ctrl+C (default 1)\n"
+                     "  --report S             report interval in seconds (default 5)\n";
+    }
+
+    /**
+     * Liest die Kommandozeile. Gibt false zurück, wenn eine Option unbekannt oder ungültig ist.
+     */
+    bool parseOptions(int argc, char* argv[], ReplayOptions& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string_view name = argv[i];
+            if (name == "--help" || name == "-h")
+                return false;
+
+            if (!name.starts_with("--"))
+            {
+                options.file = argv[i];
+                continue;
+            }
+
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Error: Missing value for " << name << std::endl;
+                return false;
+            }
+
+            const char* value = argv[++i];
+            try
+            {
+                if (name == "--broker")
+                    options.broker = value;
+                else if (name == "--speed")
+                    options.speed = std::max(0.0, std::stod(value));
+                else if (name == "--clients")
+                    options.clients = std::max<size_t>(1, std::stoul(value));
+                else if (name == "--qos")
+                    options.qos = std::clamp(std::stoi(value), -1, 2);
+                else if (name == "--loops")
+                    options.loops = std::stoul(value);
+                else if (name == "--report")
+                    options.reportInterval = std::chrono::seconds(std::max<unsigned long>(1, std::stoul(value)));
+                else
+                {
+                    std::cerr << "Error: Unknown option " << name << std::endl;
+                    return false;
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "Error: Invalid value '" << value << "' for " << name << std::endl;
+                return false;
+            }
+        }
+
+        return !options.file.empty();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    ReplayOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    CaptureReader reader;
+    if (!reader.open(options.file))
+        return 1;
+
+    std::vector<std::unique_ptr<mqtt::async_client>> clients;
+    try
+    {
+        mqtt::connect_options connOpts;
+        connOpts.set_keep_alive_interval(20);
+        connOpts.set_clean_session(true);
+
+        for (size_t i = 0; i < options.clients; ++i)
+        {
+            clients.push_back(std::make_unique<mqtt::async_client>(options.broker, "webtech-replay-" + std::to_string(::getpid()) + "-" + std::to_string(i)));
+            clients.back()->connect(connOpts)->wait();
+        }
+    }
+    catch (const mqtt::exception& exc)
+    {
+        std::cerr << "Error: Could not connect to " << options.broker << ": " << exc.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Replay: '" << options.file << "' to " << options.broker << " over " << clients.size() << " connection(s), speed ";
+    if (options.speed > 0.0)
+        std::cerr << options.speed << "x" << std::endl;
+    else
+        std::cerr << "unlimited" << std::endl;
+
+    CapturedMessage message;
+    uint64_t published = 0, failures = 0;
+    uint64_t lastPublished = 0;
+    std::chrono::steady_clock::duration maxLag{}, intervalMaxLag{};
+
+    const auto start = std::chrono::steady_clock::now();
+    auto lastReport = start;
+    auto nextReport = start + options.reportInterval;
+
+    for (size_t pass = 0; !shouldExit && (options.loops == 0 || pass < options.loops); ++pass)
+    {
+        if (pass > 0)
+            reader.rewind();
+
+        // Jeder Durchlauf beginnt mit der ersten Nachricht sofort, die weiteren folgen im aufgezeichneten Abstand
+        auto passStart = std::chrono::steady_clock::now();
+        int64_t firstArrivedAt = 0;
+        bool first = true;
+
+        while (!shouldExit && reader.next(message))
+        {
+            if (first)
+            {
+                firstArrivedAt = message.arrivedAt;
+                first = false;
+            }
+
+            if (options.speed > 0.0)
+            {
+                const auto offset = std::chrono::duration<double, std::nano>(static_cast<double>(message.arrivedAt - firstArrivedAt) / options.speed);
+                const auto due = passStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+
+                // In kurzen Schritten schlafen, damit shouldExit zeitnah bemerkt wird
+                auto now = std::chrono::steady_clock::now();
+                while (due > now && !shouldExit)
+                {
+                    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, std::chrono::milliseconds(100)));
+                    now = std::chrono::steady_clock::now();
+                }
+
+                // Verspätung gegenüber dem geplanten Zeitpunkt, zeigt ob Broker oder Verbindung mithalten
+                intervalMaxLag = std::max(intervalMaxLag, now - due);
+            }
+
+            mqtt::async_client& client = *clients[std::hash<std::string_view>{}(message.topic) % clients.size()];
+            try
+            {
+                client.publish(message.topic, message.payload.data(), message.payload.size(), options.qos < 0 ? message.qos : options.qos, false);
+                ++published;
+            }
+            catch (const mqtt::exception&)
+            {
+                ++failures;
+            }
+
+            // Zwischenbericht, Rate über das letzte Intervall
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= nextReport)
+            {
+                double seconds = std::chrono::duration<double>(now - lastReport).count();
+                std::cout << std::fixed << std::setprecision(1)
+                          << "[" << std::chrono::duration<double>(now - start).count() << "s] published " << (published - lastPublished) / seconds << "/s";
+                if (options.speed > 0.0)
+                    std::cout << ", max lag " << std::chrono::duration<double, std::milli>(intervalMaxLag).count() << " ms";
+                std::cout << ", failures " << failures << std::endl;
+
+                maxLag = std::max(maxLag, intervalMaxLag);
+                intervalMaxLag = {};
+                lastPublished = published;
+                lastReport = now;
+                nextReport = now + options.reportInterval;
+            }
+        }
+
+        // Leere Aufzeichnung, weitere Durchläufe hätten nichts zu senden
+        if (first)
+            break;
+    }
+    maxLag = std::max(maxLag, intervalMaxLag);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Trennen erst, nachdem die Bibliothek alle Nachrichten übertragen hat
+    for (auto& client : clients)
+    {
+        try
+        {
+            client->disconnect()->wait();
+        }
+        catch (const mqtt::exception& exc)
+        {
+            std::cerr << "Error: Could not disconnect: " << exc.what() << std::endl;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Total: published " << published << " (" << published / std::max(seconds, 1e-9) << "/s), failures " << failures;
+    if (options.speed > 0.0)
+        std::cout << ", max lag " << std::chrono::duration<double, std::milli>(maxLag).count() << " ms";
+    std::cout << std::endl;
+
+    return 0;
+}
@@ -6,88 +6,333 @@ Copyright (c) 2023-2023 Webtech Projekt
 
 #include "MQTT/ClientsListener.hpp"
 #include "MQTT/ConnectionListener.hpp"
-#include "MySQL/MySQLConnection.hpp"
+#include "Storage/NodeStorage.hpp"
+#include "Storage/MemoryBackend.hpp"
+#include "Storage/SQLiteBackend.hpp"
+#include "MySQL/MySQLBackend.hpp"
+#include "Metrics/MetricsServer.hpp"
+#include "Metrics/IngestLatency.hpp"
+#include "Logging/Logger.hpp"
 
 // Globale Flagge zum Beenden des Hintergrundprozesses
 volatile sig_atomic_t shouldExit = 0;
 
-// Signalbehandlungsfunktion für SIGINT (Ctrl+C)
+// Signalbehandlungsfunktion für SIGINT (Ctrl+C) und SIGTERM
 void signalHandler(int signal)
 {
-    if (signal == SIGINT)
+    if (signal == SIGINT || signal == SIGTERM)
     {
         shouldExit = 1;
     }
 }
 
+/**
+ * Legt das Backend für die Speicherung an, ausgewählt über WEBTECH_STORAGE.
+ *
+ * "mysql" (Standard) verwendet den lokalen MySQL-Server, "sqlite" die Datei aus WEBTECH_SQLITE_PATH
+ * (Standard "webtech.db") und "memory" hält alles nur im Speicher, z.B. für Lasttests.
+ *
+ * @return std::unique_ptr<StorageBackend> Das Backend oder nullptr bei einem unbekannten Namen.
+ */
+std::unique_ptr<StorageBackend> createStorageBackend()
+{
+    const char* value = std::getenv("WEBTECH_STORAGE");
+    std::string_view name = (value && *value) ? value : "mysql";
+
+    if (name == "mysql")
+    {
+        // WEBTECH_MYSQL_TIMESTAMPS=epoch übergibt Zeitstempel als Unix-Zeit statt als Text
+        MySQLTimestampMode timestampMode = MySQLTimestampMode::Text;
+        if (const char* mode = std::getenv("WEBTECH_MYSQL_TIMESTAMPS"); mode && *mode)
+        {
+            if (std::string_view(mode) == "epoch")
+                timestampMode = MySQLTimestampMode::Epoch;
+            else if (std::string_view(mode) != "text")
+                std::cerr << "Error: Invalid value '" << mode << "' for WEBTECH_MYSQL_TIMESTAMPS (text, epoch), using text" << std::endl;
+        }
+
+        // Es wird davon ausgegangen das der MySQL Server auf den selben Maschine auf Default Ports Betrieben wird
+        return std::make_unique<MySQLBackend>(MySQLConnectionInfo("tcp://127.0.0.1:3306; webtech; zbwzbw; node_server"), DefaultNodeShardCount, timestampMode);
+    }
+
+    if (name == "sqlite")
+    {
+        const char* path = std::getenv("WEBTECH_SQLITE_PATH");
+        return std::make_unique<SQLiteBackend>((path && *path) ? path : "webtech.db");
+    }
+
+    if (name == "memory")
+        return std::make_unique<MemoryBackend>();
+
+    std::cerr << "Error: Unknown storage backend '" << name << "' in WEBTECH_STORAGE (mysql, sqlite, memory)" << std::endl;
+    return nullptr;
+}
+
+/**
+ * Liest eine positive Anzahl aus einer Umgebungsvariable.
+ *
+ * @param name Name der Umgebungsvariable.
+ * @param fallback Wert, wenn die Variable fehlt oder ungültig ist.
+ * @return size_t Die Anzahl.
+ */
+size_t countFromEnvironment(const char* name, size_t fallback)
+{
+    const char* value = std::getenv(name);
+    if (!value || !*value)
+        return fallback;
+
+    char* end = nullptr;
+    unsigned long count = std::strtoul(value, &end, 10);
+    if (*end != '\0' || count == 0)
+    {
+        std::cerr << "Error: Invalid value '" << value << "' for " << name << ", using " << fallback << std::endl;
+        return fallback;
+    }
+
+    return static_cast<size_t>(count);
+}
+
+/**
+ * Liest die Offline-Zeiten der Knoten aus den Umgebungsvariablen.
+ *
+ * WEBTECH_OFFLINE_TIMEOUT gibt die Zeit in Sekunden für alle Knoten an (Standard 60),
+ * WEBTECH_OFFLINE_TIMEOUTS abweichende Zeiten einzelner Knoten als "id=sekunden,id=sekunden".
+ * Ungültige Einträge werden gemeldet und übersprungen.
+ *
+ * @return NodeOfflineConfig Die Offline-Zeiten.
+ */
+NodeOfflineConfig offlineConfigFromEnvironment()
+{
+    NodeOfflineConfig config;
+    config.timeout = std::chrono::seconds(countFromEnvironment("WEBTECH_OFFLINE_TIMEOUT", static_cast<size_t>(DefaultNodeOfflineTimeout.count())));
+
+    const char* value = std::getenv("WEBTECH_OFFLINE_TIMEOUTS");
+    if (!value)
+        return config;
+
+    std::string_view entries = value;
+    while (!entries.empty())
+    {
+        size_t comma = entries.find(',');
+        std::string_view entry = entries.substr(0, comma);
+        entries = comma == std::string_view::npos ? std::string_view() : entries.substr(comma + 1);
+
+        if (entry.empty())
+            continue;
+
+        size_t equals = entry.find('=');
+        std::string seconds(equals == std::string_view::npos ? std::string_view() : entry.substr(equals + 1));
+        char* end = nullptr;
+        unsigned long count = std::strtoul(seconds.c_str(), &end, 10);
+        if (equals == 0 || seconds.empty() || *end != '\0' || count == 0)
+        {
+            std::cerr << "Error: Invalid entry '" << entry << "' in WEBTECH_OFFLINE_TIMEOUTS (id=seconds), skipping" << std::endl;
+            continue;
+        }
+
+        config.overrides.insert_or_assign(std::string(entry.substr(0, equals)), std::chrono::seconds(count));
+    }
+
+    return config;
+}
+
 int main()
 {
-    // Signalbehandlung für SIGINT (Ctrl+C) festlegen
+    // Signalbehandlung für SIGINT (Ctrl+C) und SIGTERM (z.B. beim Stoppen des Dienstes) festlegen
     std::signal(SIGINT, signalHandler);
+    std::signal(SIGTERM, signalHandler);
+
+    // Meldungen der Hot-Paths werden im Hintergrund geschrieben, WEBTECH_LOG_LEVEL=debug|info|warning|error
+    if (const char* levelName = std::getenv("WEBTECH_LOG_LEVEL"); levelName && *levelName)
+    {
+        LogLevel level;
+        if (parseLogLevel(levelName, level))
+            sLog.setLevel(level);
+        else
+            std::cerr << "Error: Invalid value '" << levelName << "' for WEBTECH_LOG_LEVEL, using " << logLevelName(sLog.level()) << std::endl;
+    }
+
+    // Je Art von Meldung werden höchstens WEBTECH_LOG_BURST Zeilen in 10s ausgegeben, der Rest nur gezählt
+    sLog.setRateLimit(std::chrono::seconds(10), static_cast<uint32_t>(countFromEnvironment("WEBTECH_LOG_BURST", 10)));
+    sLog.start();
+
+    // Messwerte, die nicht geschrieben werden können, landen im Spool unter WEBTECH_SPOOL_DIR
+    // (Standard "telemetry_spool"), ein leerer Wert schaltet den Spool ab
+    NodeDataWriterConfig writerConfig;
+    const char* spoolDirectory = std::getenv("WEBTECH_SPOOL_DIR");
+    writerConfig.spoolDirectory = spoolDirectory ? spoolDirectory : "telemetry_spool";
+    if (writerConfig.spoolDirectory.empty())
+        std::cerr << "Storage: telemetry spool disabled, readings are lost while the database is unavailable" << std::endl;
+
+    // Anzahl der Schreib-Threads (je eine Verbindung) sowie Größe und maximales Alter eines Batches für node_data
+    writerConfig.workerCount = countFromEnvironment("WEBTECH_WRITER_THREADS", writerConfig.workerCount);
+    writerConfig.batchSize = countFromEnvironment("WEBTECH_WRITER_BATCH_SIZE", writerConfig.batchSize);
+    writerConfig.maxBatchAge = std::chrono::milliseconds(countFromEnvironment("WEBTECH_WRITER_BATCH_AGE_MS", static_cast<size_t>(writerConfig.maxBatchAge.count())));
+
+    std::cerr << "Storage: " << writerConfig.workerCount << " writer(s), batches of up to " << writerConfig.batchSize << " readings or " << writerConfig.maxBatchAge.count() << "ms" << std::endl;
+
+    // Zeit ohne Meldung bis offline, global über WEBTECH_OFFLINE_TIMEOUT und je Knoten über WEBTECH_OFFLINE_TIMEOUTS
+    const NodeOfflineConfig offlineConfig = offlineConfigFromEnvironment();
+    std::cerr << "Storage: nodes go offline after " << offlineConfig.timeout.count() << "s without data (" << offlineConfig.overrides.size() << " override(s))" << std::endl;
+
+    // Datenbank Verbindung aufbauen und Initialiseren, das Backend wird über WEBTECH_STORAGE gewählt.
+    // Das geschieht vor dem Start der Listener, damit deren Worker nur auf geladene Knoten und einen
+    // gestarteten NodeDataWriter treffen
+    sStorage.setup(createStorageBackend());
+    sStorage.setWriterConfig(writerConfig);
+    sStorage.setOfflineConfig(offlineConfig);
+    if (!sStorage.connect())
+    {
+        shouldExit = true;
+        std::cerr << "Error: Storage Connection Failed, Shuting Down Server" << std::endl;
+    }
 
     // Server Address Festlegen
     // Es wird davon ausgegangen das der MQTT Server auf den selben Maschine auf Default Ports Betrieben wird
     std::string serverAddress = "localhost:1883";
 
+    // Anzahl der MQTT-Clients für die Messwerte. Bei mehr als einem Client oder gesetzter Gruppe wird per
+    // Shared Subscription abonniert, der Broker verteilt die Messwerte dann auf alle Clients der Gruppe,
+    // auch über mehrere Serverprozesse hinweg. Die Reihenfolge der Messwerte eines Knotens ist dann nicht mehr
+    // garantiert, node_data übernimmt aber nur Messwerte mit neuerem Zeitstempel
+    const size_t clientCount = countFromEnvironment("WEBTECH_MQTT_CLIENTS", 1);
+    const char* shareGroup = std::getenv("WEBTECH_MQTT_SHARE_GROUP");
+
+    // Messwerte kommen als JSON auf "Nodes/{ID}/Data", im binären Format auf "Nodes/{ID}/Bin"
+    // und zu mehreren auf "Nodes/{ID}/Batch"
+    std::vector<std::string> dataTopics = { "Nodes/+/Data", "Nodes/+/Bin", "Nodes/+/Batch" };
+    if (clientCount > 1 || (shareGroup && *shareGroup))
+    {
+        const char* group = (shareGroup && *shareGroup) ? shareGroup : "webtech";
+        for (std::string& topic : dataTopics)
+            topic = MQTTListener::sharedTopic(group, topic);
+    }
+
+    // Die Worker-Threads werden auf die Clients aufgeteilt, jeder Client verarbeitet seinen Anteil selbst
+    const size_t workerCount = std::max<size_t>(2, std::thread::hardware_concurrency());
+    const size_t workersPerClient = std::max<size_t>(1, workerCount / clientCount);
+
     // Erstelle einen MQTTListener für einkommende Daten sowie Authentifierzierungs anfragen
     ConnectionListener  listener_connection(serverAddress, "client/accepted");
-    ClientsListener     listener_clients(serverAddress, "Nodes/+/Data");
+    std::vector<std::unique_ptr<ClientsListener>> listener_clients;
+    for (size_t i = 0; i < clientCount; ++i)
+    {
+        listener_clients.push_back(std::make_unique<ClientsListener>(serverAddress, dataTopics.front(), workersPerClient));
+        for (size_t t = 1; t < dataTopics.size(); ++t)
+            listener_clients.back()->addTopic(dataTopics[t]);
+    }
+
+    // WEBTECH_MQTT_CAPTURE={Datei} zeichnet alle eintreffenden Nachrichten für Webtech_Replay auf
+    std::shared_ptr<MessageCapture> capture;
+    if (const char* capturePath = std::getenv("WEBTECH_MQTT_CAPTURE"); capturePath && *capturePath)
+    {
+        capture = std::make_shared<MessageCapture>();
+        if (capture->open(capturePath))
+        {
+            listener_connection.setCapture(capture);
+            for (auto& listener : listener_clients)
+                listener->setCapture(capture);
+            std::cerr << "MQTT: capturing all messages to '" << capturePath << "'" << std::endl;
+        }
+    }
 
     // Connect to MQTT Broker
     listener_connection.connect();
-    listener_clients.connect();
+    for (auto& listener : listener_clients)
+        listener->connect();
 
     // Warte bis die Verbindung aufgebaut ist
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
     // Subscribe die benötigten Topics
     listener_connection.subscribe();
-    listener_clients.subscribe();
+    for (auto& listener : listener_clients)
+        listener->subscribe();
 
     // Starten Sie den zyklischen Aufruf des Listeners in einem separaten Thread
     std::thread listenerThread_connection(&MQTTListener::processMessages, &listener_connection);
-    std::thread listenerThread_clients(&MQTTListener::processMessages, &listener_clients);
+    std::vector<std::thread> listenerThreads_clients;
+    for (auto& listener : listener_clients)
+        listenerThreads_clients.emplace_back(&MQTTListener::processMessages, listener.get());
 
-    // MySQL Server Verbindung aufbauen und Initialiseren
-    // Es wird davon ausgegangen das der MySQL Server auf den selben Maschine auf Default Ports Betrieben wird
-    MySQLConnectionInfo _connectionInfo("tcp://127.0.0.1:3306; webtech; zbwzbw; node_server");
-    sMySQL.setup(std::make_unique<MySQLConnectionInfo>(_connectionInfo));
-    if (!sMySQL.connect())
-    {
-        shouldExit = true;
-        std::cerr << "Error: MySQL Connection Failed, Shuting Down Server" << std::endl;
-    }
+    std::cerr << "MQTT: " << clientCount << " client(s) on '" << dataTopics.front() << "' (+" << dataTopics.size() - 1 << " topics), " << workersPerClient << " worker(s) each" << std::endl;
+
+    // Metriken für Prometheus unter http://{host}:9464/metrics, WEBTECH_METRICS_PORT=0 schaltet den Endpunkt ab
+    const char* metricsPortValue = std::getenv("WEBTECH_METRICS_PORT");
+    const bool metricsEnabled = !(metricsPortValue && std::string_view(metricsPortValue) == "0");
+    MetricsServer metricsServer(static_cast<uint16_t>(metricsEnabled ? countFromEnvironment("WEBTECH_METRICS_PORT", 9464) : 0));
+    if (metricsEnabled && !shouldExit)
+        metricsServer.start();
 
     // Hauptloop des Programms dient zu Monitoring zwecken und Polling der Datenank
+    auto nextPoll = std::chrono::steady_clock::now();
+    auto nextLatencySummary = nextPoll + std::chrono::seconds(60);
     while (!shouldExit)
     {
         ////////////////////////
         // Main Thread
-        sMySQL.monitorLastSeen();
+        // Offline-Erkennung jede Sekunde, es werden nur abgelaufene Nodes angefasst
+        sStorage.monitorLastSeen();
+
+        // Datenbank-Aufgaben alle 10s
+        if (std::chrono::steady_clock::now() >= nextPoll)
+        {
+            sStorage.flushLastSeen();
+            sStorage.pollAuditTable();
+            sStorage.maintainNodeDataHistory();
+
+            nextPoll += std::chrono::seconds(10);
+        }
+
+        // Zusammenfassung der Ingest-Latenzen jede Minute
+        if (std::chrono::steady_clock::now() >= nextLatencySummary)
+        {
+            sIngestLatency.logSummary();
+            nextLatencySummary += std::chrono::seconds(60);
+        }
 
         ////////////////////////
-        // Sleep 10s
-        std::this_thread::sleep_for(std::chrono::seconds(10));
+        // Sleep 1s
+        std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
     ///////////////////////////
     // Programm Shutdown Prozedur
     std::cerr << "Shuting Down..." << std::endl;
 
-    // Setze Alle Nodes auf Offline
-    for (auto node : sMySQL.getNodeContainer())
-        sMySQL.updateNodeStatusInDB(node.id, "online", false);
-
-    // Beenden der Listener
+    // Beenden der Listener, danach kommen keine neuen Messwerte mehr an
     std::cerr << "Shutdown Startet for MQTTListener (Connections)" << std::endl;
     listener_connection.disconnect();
 
     std::cerr << "Shutdown Startet for MQTTListener (Clients)" << std::endl;
-    listener_clients.disconnect();
+    for (auto& listener : listener_clients)
+        listener->disconnect();
 
     // Warten Sie auf den Listener-Thread, bis er beendet ist
     listenerThread_connection.join();
-    listenerThread_clients.join();
+    for (auto& thread : listenerThreads_clients)
+        thread.join();
+
+    if (capture)
+    {
+        capture->close();
+        std::cerr << "MQTT: " << capture->count() << " message(s) captured" << std::endl;
+    }
+
+    // Die Metriken greifen auf den NodeDataWriter zu, der in disconnect() freigegeben wird
+    metricsServer.stop();
+
+    // Schreibt die noch wartenden Messwerte und beendet die Schreib-Threads
+    sStorage.disconnect();
+
+    // Schreibt die letzten lastSeen Daten
+    sStorage.flushLastSeen();
+
+    // Setze Alle Nodes mit einer Anweisung auf Offline
+    sStorage.setAllNodesOffline();
+
+    // Schreibt die letzten Meldungen, alle anderen Threads sind beendet
+    sLog.stop();
 
     std::cerr << "Shutdown Completed" << std::endl;
 	return 0;
@@ -8,6 +8,7 @@ Copyright (c) 2023-2023 Webtech Projekt
 
 #include <cstdlib>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <cstring>
 #include <cctype>